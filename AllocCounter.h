@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+/* Heap allocation counter for the check tools
+ * AllocCounter.cpp replaces the global operator new and delete, so any target it is linked into counts every
+ * allocation in the process, on any thread, between start() and stop(). Frees aren't counted
+ */
+class AllocCounter {
+public:
+    // Zero the count and count from here on
+    static void start();
+    static void stop();
+    // Allocations between the last start() and stop(), or so far if still counting
+    static uint64_t count();
+};
@@ -0,0 +1,221 @@
+#include "AppConfig.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <rte_lcore.h>
+#include "FeedHandler.h"
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [EAL options] -- [--port N] [--rx-queues N] [--rx-cores a,b,...]"
+              << " [--workers N] [--worker-cores a,b,...] [--worker-core N] [--shard SYMBOL=WORKER ...]"
+              << " [--feed-ports A,B] [--feed-hold-us N] [--local-addr IP:PORT] [--order-dest IP:PORT]"
+              << " [--gateway-mac xx:xx:xx:xx:xx:xx] [--tx-orders N] [--matching on|off]"
+              << " [--replay FILE.pcap] [--replay-speed recorded|max] [--record FILE.pcap]" << std::endl;
+}
+
+// Unsigned integer in [min, max], false for anything else (including trailing junk)
+static bool parse_number(const char* text, unsigned long min, unsigned long max, unsigned long& out) {
+    char* end = nullptr;
+    out = std::strtoul(text, &end, 10);
+    return end != text && *end == '\0' && out >= min && out <= max;
+}
+
+// Comma separated ids below limit (lcores, ports)
+static bool parse_id_list(const char* text, const char* option, unsigned long limit, std::vector<unsigned>& out) {
+    out.clear();
+    std::stringstream list(text);
+    std::string id;
+    unsigned long number = 0;
+    while (std::getline(list, id, ',')) {
+        if (!parse_number(id.c_str(), 0, limit - 1, number)) {
+            std::cerr << "Bad value '" << id << "' in " << option << std::endl;
+            return false;
+        }
+        out.push_back(static_cast<unsigned>(number));
+    }
+    return true;
+}
+
+// "a.b.c.d:port", host order
+static bool parse_endpoint(const char* text, uint32_t& ip, uint16_t& port) {
+    const char* colon = std::strrchr(text, ':');
+    unsigned long number = 0;
+    if (!colon || !parse_number(colon + 1, 1, 65535, number)) return false;
+    ip = FeedHandler::parse_ipv4(std::string(text, colon).c_str());
+    port = static_cast<uint16_t>(number);
+    return ip != 0;
+}
+
+static bool parse_mac(const char* text, std::array<uint8_t, 6>& mac) {
+    unsigned bytes[6];
+    char extra;
+    if (std::sscanf(text, "%x:%x:%x:%x:%x:%x%c", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5], &extra) != 6) {
+        return false;
+    }
+    for (size_t i = 0; i < 6; ++i) {
+        if (bytes[i] > 0xFF) return false;
+        mac[i] = static_cast<uint8_t>(bytes[i]);
+    }
+    return true;
+}
+
+bool parse_app_config(int argc, char* argv[], AppConfig& config) {
+    int i = 1;
+    for (; i < argc && std::strcmp(argv[i], "--") != 0; ++i) {
+        config.eal_args.emplace_back(argv[i]);
+    }
+    ++i;  // Skip the "--"
+
+    for (; i < argc; ++i) {
+        const char* option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << option << std::endl;
+            print_usage(argv[0]);
+            return false;
+        }
+        const char* value = argv[++i];
+        unsigned long number = 0;
+
+        if (std::strcmp(option, "--port") == 0 && parse_number(value, 0, RTE_MAX_ETHPORTS - 1, number)) {
+            config.port = static_cast<uint16_t>(number);
+        } else if (std::strcmp(option, "--rx-queues") == 0 && parse_number(value, 1, 64, number)) {
+            config.rx_queues = static_cast<uint16_t>(number);
+        } else if (std::strcmp(option, "--workers") == 0 && parse_number(value, 1, 64, number)) {
+            config.workers = static_cast<uint16_t>(number);
+        } else if (std::strcmp(option, "--worker-core") == 0 && parse_number(value, 0, RTE_MAX_LCORE - 1, number)) {
+            // Single worker on a given core, the pre-sharding option
+            config.workers = 1;
+            config.worker_cores = {static_cast<unsigned>(number)};
+        } else if (std::strcmp(option, "--rx-cores") == 0) {
+            if (!parse_id_list(value, option, RTE_MAX_LCORE, config.rx_cores)) return false;
+        } else if (std::strcmp(option, "--worker-cores") == 0) {
+            if (!parse_id_list(value, option, RTE_MAX_LCORE, config.worker_cores)) return false;
+            config.workers = static_cast<uint16_t>(config.worker_cores.size());
+        } else if (std::strcmp(option, "--feed-hold-us") == 0 && parse_number(value, 1, 1000000, number)) {
+            config.feed_max_hold_us = static_cast<uint32_t>(number);
+        } else if (std::strcmp(option, "--feed-ports") == 0) {
+            std::vector<unsigned> ports;
+            if (!parse_id_list(value, option, RTE_MAX_ETHPORTS, ports)) return false;
+            if (ports.empty() || ports.size() > 2) {
+                std::cerr << "--feed-ports takes the A line port and optionally the B line port" << std::endl;
+                return false;
+            }
+            config.feed_ports.assign(ports.begin(), ports.end());
+        } else if (std::strcmp(option, "--local-addr") == 0) {
+            if (!parse_endpoint(value, config.local_ip, config.local_port)) {
+                std::cerr << "Bad --local-addr '" << value << "', expected IP:PORT" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(option, "--order-dest") == 0) {
+            if (!parse_endpoint(value, config.order_dest_ip, config.order_dest_port)) {
+                std::cerr << "Bad --order-dest '" << value << "', expected IP:PORT" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(option, "--gateway-mac") == 0) {
+            if (!parse_mac(value, config.gateway_mac)) {
+                std::cerr << "Bad --gateway-mac '" << value << "'" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(option, "--tx-orders") == 0 && parse_number(value, 0, 100000000, number)) {
+            config.tx_orders = static_cast<uint32_t>(number);
+        } else if (std::strcmp(option, "--matching") == 0 && (std::strcmp(value, "on") == 0 || std::strcmp(value, "off") == 0)) {
+            config.matching = std::strcmp(value, "on") == 0;
+        } else if (std::strcmp(option, "--replay") == 0) {
+            config.replay_path = value;
+        } else if (std::strcmp(option, "--replay-speed") == 0 && (std::strcmp(value, "recorded") == 0 || std::strcmp(value, "max") == 0)) {
+            config.replay_max_speed = std::strcmp(value, "max") == 0;
+        } else if (std::strcmp(option, "--record") == 0) {
+            config.record_path = value;
+        } else if (std::strcmp(option, "--shard") == 0) {
+            const char* equals = std::strchr(value, '=');
+            if (!equals || equals == value || !parse_number(equals + 1, 0, 63, number)) {
+                std::cerr << "Bad --shard '" << value << "', expected SYMBOL=WORKER" << std::endl;
+                return false;
+            }
+            config.shard_overrides.emplace_back(std::string(value, equals), static_cast<uint16_t>(number));
+        } else {
+            std::cerr << "Bad option " << option << " " << value << std::endl;
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+
+    if (!config.rx_cores.empty() && config.rx_cores.size() != config.rx_queues) {
+        std::cerr << "--rx-cores lists " << config.rx_cores.size() << " cores for " << config.rx_queues << " RX queues" << std::endl;
+        return false;
+    }
+    if (!config.worker_cores.empty() && config.worker_cores.size() != config.workers) {
+        std::cerr << "--worker-cores lists " << config.worker_cores.size() << " cores for " << config.workers << " workers" << std::endl;
+        return false;
+    }
+    // A/B arbitration keeps per-channel state, so both lines of every channel have to reach the same core
+    if (!config.feed_ports.empty() && config.rx_queues != 1) {
+        std::cerr << "--feed-ports polls one RX queue per line, drop --rx-queues" << std::endl;
+        return false;
+    }
+    // Order entry goes out on the order stream port, feed ports are receive only
+    if (!config.feed_ports.empty() && config.tx_orders > 0) {
+        std::cerr << "--tx-orders needs the order stream, drop --feed-ports" << std::endl;
+        return false;
+    }
+    // Replay stands in for the one RX core and its queue 0 rings
+    if (!config.replay_path.empty() && config.rx_queues != 1) {
+        std::cerr << "--replay injects into one RX queue, drop --rx-queues" << std::endl;
+        return false;
+    }
+    // Recording happens on the RX cores, which don't run during a replay
+    if (!config.replay_path.empty() && !config.record_path.empty()) {
+        std::cerr << "--record captures what the NIC delivers, it can't be combined with --replay" << std::endl;
+        return false;
+    }
+    for (const auto& [symbol, worker] : config.shard_overrides) {
+        if (worker >= config.workers) {
+            std::cerr << "--shard " << symbol << "=" << worker << " but there are only " << config.workers << " workers" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<uint16_t> active_ports(const AppConfig& config) {
+    if (config.feed_ports.empty()) return {config.port};
+    std::vector<uint16_t> ports = config.feed_ports;
+    if (ports.size() == 2 && ports[0] == ports[1]) ports.pop_back();
+    return ports;
+}
+
+bool assign_lcores(AppConfig& config) {
+    // Cores given explicitly are taken first, the rest are filled from the enabled worker lcores in order
+    std::vector<unsigned> taken = config.rx_cores;
+    taken.insert(taken.end(), config.worker_cores.begin(), config.worker_cores.end());
+    auto fill = [&](std::vector<unsigned>& cores, size_t wanted, const char* role) {
+        if (!cores.empty()) return true;
+        unsigned lcore;
+        RTE_LCORE_FOREACH_WORKER(lcore) {
+            if (cores.size() == wanted) break;
+            if (std::find(taken.begin(), taken.end(), lcore) != taken.end()) continue;
+            cores.push_back(lcore);
+            taken.push_back(lcore);
+        }
+        if (cores.size() != wanted) {
+            std::cerr << "Need " << wanted << " " << role << " lcores, only " << cores.size()
+                      << " free. Give EAL more cores (-l)" << std::endl;
+            return false;
+        }
+        return true;
+    };
+    if (!fill(config.rx_cores, config.rx_queues, "RX") || !fill(config.worker_cores, config.workers, "worker")) {
+        return false;
+    }
+
+    for (unsigned lcore : taken) {
+        if (!rte_lcore_is_enabled(lcore) || lcore == rte_get_main_lcore() || std::count(taken.begin(), taken.end(), lcore) > 1) {
+            std::cerr << "Core " << lcore << " is not a free enabled worker lcore" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Runtime configuration
+ * Command line is the usual DPDK shape: EAL arguments, then "--", then ours
+ *   ./Low_latency_DPDK --vdev=net_pcap0,rx_pcap=feed.pcap -- --rx-queues 2 --rx-cores 1,3 --worker-cores 2,4 --shard AAPL=1
+ * EAL arguments are appended to the built-in ones in dpdk_init, so a vdev or core list can be added without a rebuild
+ */
+struct AppConfig {
+    std::vector<std::string> eal_args;  // Everything before "--", passed through to rte_eal_init
+    uint16_t port = 0;
+    uint16_t rx_queues = 1;             // RSS spreads flows across these, one RX lcore each
+    std::vector<unsigned> rx_cores;     // One lcore per RX queue. Empty picks the first enabled lcores after EAL init
+    uint16_t workers = 1;               // Book-building shards, each owns a disjoint set of instruments
+    std::vector<unsigned> worker_cores; // One lcore per worker. Empty picks the next free lcores after the RX ones
+    std::vector<std::pair<std::string, uint16_t>> shard_overrides;  // Symbol -> worker, instead of the symbol hash
+    std::vector<uint16_t> feed_ports;   // UDP multicast feed: A line port, B line port (can be the same). Empty for the order stream on port
+    uint32_t feed_max_hold_us = 100;    // How long the reorder window waits for the other line before declaring a gap
+    // Order entry, sent from port's TX queue. Addresses in host order
+    uint32_t local_ip = 0x0A000002;     // 10.0.0.2
+    uint16_t local_port = 40000;
+    uint32_t order_dest_ip = 0x0A000001;  // 10.0.0.1
+    uint16_t order_dest_port = 12345;
+    std::array<uint8_t, 6> gateway_mac = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};  // Next hop for orders, no ARP
+    uint32_t tx_orders = 0;             // Random orders to send through the TX path after the simulation
+    bool matching = false;              // Books match crossing orders (local exchange) instead of resting everything
+    // Offline runs: play a pcap into the RX path instead of polling the NIC, or record what the RX cores receive
+    std::string replay_path;
+    bool replay_max_speed = false;      // Back to back instead of at the recorded gaps
+    std::string record_path;
+};
+
+// Parse argv into config, before EAL init. Prints usage and returns false on bad arguments
+bool parse_app_config(int argc, char* argv[], AppConfig& config);
+
+// Ports to bring up: the feed ports in feed mode, otherwise just port
+std::vector<uint16_t> active_ports(const AppConfig& config);
+
+// After EAL init: fill in rx_cores/worker_cores if they weren't given, and check every core is enabled and used once
+bool assign_lcores(AppConfig& config);
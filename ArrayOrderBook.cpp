@@ -0,0 +1,297 @@
+#include "ArrayOrderBook.h"
+#include <algorithm>
+#include <limits>
+
+ArrayOrderBook::ArrayOrderBook(uint32_t reference_price, size_t max_orders, size_t max_sparse_levels)
+        : pool(max_orders),
+          bid_levels(NUM_LEVELS),
+          ask_levels(NUM_LEVELS),
+          base_price(reference_price > NUM_LEVELS / 2 ? reference_price - NUM_LEVELS / 2 : 0),
+          sparse_nodes(std::make_unique<LevelNodeSlab>(max_sparse_levels)),
+          sparse_bids(LevelNodeAllocator<std::pair<const uint32_t, PriceLevel>>(sparse_nodes.get())),
+          sparse_asks(LevelNodeAllocator<std::pair<const uint32_t, PriceLevel>>(sparse_nodes.get())),
+          order_map(max_orders) {}
+
+/* Find the highest set bit at or below idx
+ * Returns -1 if there is none. Masks the first word then walks whole words, so at most BITMAP_WORDS iterations
+ */
+int32_t ArrayOrderBook::highest_set_at_or_below(const std::array<uint64_t, BITMAP_WORDS>& bitmap, int32_t idx) {
+    if (idx < 0) return -1;
+    int32_t word = idx >> 6;
+    uint64_t bits = bitmap[word] & (~0ULL >> (63 - (idx & 63)));
+    while (true) {
+        if (bits) return (word << 6) + 63 - __builtin_clzll(bits);
+        if (--word < 0) return -1;
+        bits = bitmap[word];
+    }
+}
+
+/* Find the lowest set bit at or above idx
+ * Returns -1 if there is none
+ */
+int32_t ArrayOrderBook::lowest_set_at_or_above(const std::array<uint64_t, BITMAP_WORDS>& bitmap, int32_t idx) {
+    if (idx >= static_cast<int32_t>(NUM_LEVELS)) return -1;
+    int32_t word = idx >> 6;
+    uint64_t bits = bitmap[word] & (~0ULL << (idx & 63));
+    while (true) {
+        if (bits) return (word << 6) + __builtin_ctzll(bits);
+        if (++word >= static_cast<int32_t>(BITMAP_WORDS)) return -1;
+        bits = bitmap[word];
+    }
+}
+
+/* Get the level for a price, creating it in the sparse map if it is outside the band
+ * In-band levels also update the bitmap and the best cursor
+ */
+PriceLevel& ArrayOrderBook::level_for(uint32_t price, bool is_buy) {
+    if (!in_band(price)) {
+        return is_buy ? sparse_bids[price] : sparse_asks[price];
+    }
+    int32_t idx = static_cast<int32_t>(price - base_price);
+    if (is_buy) {
+        set_bit(bid_bitmap, idx);
+        if (idx > best_bid_idx) best_bid_idx = idx;
+        return bid_levels[idx];
+    }
+    set_bit(ask_bitmap, idx);
+    if (best_ask_idx < 0 || idx < best_ask_idx) best_ask_idx = idx;
+    return ask_levels[idx];
+}
+
+/* Find the level an existing order rests on
+ * Sparse levels are guaranteed to exist while they hold an order
+ */
+PriceLevel& ArrayOrderBook::existing_level(const OrderNode& order) {
+    if (!in_band(order.price)) {
+        return order.is_buy ? sparse_bids.find(order.price)->second : sparse_asks.find(order.price)->second;
+    }
+    size_t idx = order.price - base_price;
+    return order.is_buy ? bid_levels[idx] : ask_levels[idx];
+}
+
+/* Flags a top-of-book change if price is the best level on its side
+ * Called after an order joins a level and before one leaves or shrinks. One compare against the cursor in band
+ */
+void ArrayOrderBook::note_level(uint32_t price, bool is_buy) {
+    top_changed |= price == (is_buy ? getBestBid() : getBestAsk());
+}
+
+/* Unlink an order from its level and clean up the level if it became empty
+ * When the best level empties, the cursor moves to the next set bit
+ */
+void ArrayOrderBook::erase_from_level(OrderHandle h) {
+    const OrderNode& order = pool[h];
+    uint32_t price = order.price;
+    note_level(price, order.is_buy);
+    if (!in_band(price)) {
+        if (order.is_buy) {
+            auto it = sparse_bids.find(price);
+            it->second.unlink(pool, h);
+            if (it->second.empty()) sparse_bids.erase(it);
+        } else {
+            auto it = sparse_asks.find(price);
+            it->second.unlink(pool, h);
+            if (it->second.empty()) sparse_asks.erase(it);
+        }
+        return;
+    }
+
+    int32_t idx = static_cast<int32_t>(price - base_price);
+    if (order.is_buy) {
+        bid_levels[idx].unlink(pool, h);
+        if (bid_levels[idx].empty()) {
+            clear_bit(bid_bitmap, idx);
+            if (idx == best_bid_idx) best_bid_idx = highest_set_at_or_below(bid_bitmap, idx - 1);
+        }
+    } else {
+        ask_levels[idx].unlink(pool, h);
+        if (ask_levels[idx].empty()) {
+            clear_bit(ask_bitmap, idx);
+            if (idx == best_ask_idx) best_ask_idx = lowest_set_at_or_above(ask_bitmap, idx + 1);
+        }
+    }
+}
+
+/* Add a new order to the order book
+ * In-band prices are a direct index, no tree walk. The order joins the back of the level's FIFO
+ * In matching mode it first trades against whatever it crosses, and only the remainder rests
+ * Returns false if the id is already live or the node pool is exhausted, nothing has traded or changed then
+ */
+bool ArrayOrderBook::addOrder(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy) {
+    // Both rejections come before matching, a rejected order must not trade. The slot goes back if nothing rests
+    if (order_map.find(order_id) != FlatHashIndex::NOT_FOUND) return false;
+    OrderHandle h = pool.allocate();
+    if (h == INVALID_ORDER) return false;
+    if (trades) {
+        quantity = match(order_id, price, quantity, is_buy);
+        if (quantity == 0) {
+            pool.release(h);
+            return true;
+        }
+    }
+    if (!order_map.insert(order_id, h)) {  // Sized like the pool, so only if the two disagree
+        pool.release(h);
+        return false;
+    }
+
+    OrderNode& node = pool[h];
+    node.order_id = order_id;
+    node.quantity = quantity;
+    node.price = price;
+    node.is_buy = is_buy;
+
+    level_for(price, is_buy).push_back(pool, h);
+    note_level(price, is_buy);
+    return true;
+}
+
+/* Remove an order from the order book
+ * O(1) in band, except when the best level empties and we scan the bitmap for the next one
+ */
+void ArrayOrderBook::removeOrder(uint64_t order_id) {
+    OrderHandle h = order_map.erase(order_id);
+    if (h != INVALID_ORDER) {
+        erase_from_level(h);
+        pool.release(h);
+    }
+}
+
+/* Modify the quantity of an existing order
+ * This function assumes the price remains unchanged. The order keeps its place in the queue
+ */
+void ArrayOrderBook::modifyOrder(uint64_t order_id, uint32_t new_quantity) {
+    OrderHandle h = order_map.find(order_id);
+    if (h != INVALID_ORDER) {
+        OrderNode& order = pool[h];
+        note_level(order.price, order.is_buy);
+        PriceLevel& level = existing_level(order);
+        level.total_quantity = level.total_quantity - order.quantity + new_quantity;
+        order.quantity = new_quantity;
+    }
+}
+
+/* Take quantity off an existing order, used for partial cancels and executions
+ * The order keeps its place in the queue and is removed once nothing is left
+ */
+void ArrayOrderBook::reduceOrder(uint64_t order_id, uint32_t quantity) {
+    OrderHandle h = order_map.find(order_id);
+    if (h != INVALID_ORDER) reduce(h, quantity);
+}
+
+void ArrayOrderBook::reduce(OrderHandle h, uint32_t quantity) {
+    OrderNode& order = pool[h];
+    if (quantity >= order.quantity) {
+        order_map.erase(order.order_id);
+        erase_from_level(h);
+        pool.release(h);
+        return;
+    }
+    note_level(order.price, order.is_buy);
+    existing_level(order).total_quantity -= quantity;
+    order.quantity -= quantity;
+}
+
+/* Sweep the opposite side while it crosses price, always against the oldest order at the best level (price-time priority)
+ * The best level comes from the same cursor/sparse precedence as getBestBid/getBestAsk, and a level that empties
+ * moves the cursor on through erase_from_level
+ * Returns the quantity left over, to rest
+ */
+uint32_t ArrayOrderBook::match(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy) {
+    while (quantity > 0) {
+        OrderHandle h;
+        if (is_buy) {
+            uint32_t best = getBestAsk();
+            if (best == std::numeric_limits<uint32_t>::max() || best > price) break;
+            h = in_band(best) ? ask_levels[best - base_price].head : sparse_asks.begin()->second.head;
+        } else {
+            uint32_t best = getBestBid();
+            if (best == 0 || best < price) break;
+            h = in_band(best) ? bid_levels[best - base_price].head : sparse_bids.begin()->second.head;
+        }
+        const OrderNode& resting = pool[h];
+        uint32_t fill = std::min(quantity, resting.quantity);
+        trades->push({order_id, resting.order_id, resting.price, fill, is_buy});
+        quantity -= fill;
+        reduce(h, fill);
+    }
+    return quantity;
+}
+
+/* Replace an order with a new price and quantity, keeping its id and side
+ * Loses time priority like on the exchange, the order goes to the back of its new level
+ */
+void ArrayOrderBook::replaceOrder(uint64_t order_id, uint32_t new_price, uint32_t new_quantity) {
+    OrderHandle h = order_map.find(order_id);
+    if (h == INVALID_ORDER) return;
+    bool is_buy = pool[h].is_buy;
+    removeOrder(order_id);
+    addOrder(order_id, new_price, new_quantity, is_buy);
+}
+
+/* Get the best (highest) bid price
+ * A sparse bid only wins if it sits above the band, otherwise the band cursor is better
+ * Returns 0 if there are no bids
+ */
+uint32_t ArrayOrderBook::getBestBid() const {
+    if (!sparse_bids.empty() && (best_bid_idx < 0 || sparse_bids.begin()->first > base_price + NUM_LEVELS - 1)) {
+        return sparse_bids.begin()->first;
+    }
+    return best_bid_idx < 0 ? 0 : base_price + best_bid_idx;
+}
+
+/* Get the best (lowest) ask price
+ * Returns the maximum possible value if there are no asks
+ */
+uint32_t ArrayOrderBook::getBestAsk() const {
+    if (!sparse_asks.empty() && (best_ask_idx < 0 || sparse_asks.begin()->first < base_price)) {
+        return sparse_asks.begin()->first;
+    }
+    return best_ask_idx < 0 ? std::numeric_limits<uint32_t>::max() : base_price + best_ask_idx;
+}
+
+/* Best price and its resting quantity on both sides
+ * Same precedence between band and sparse levels as getBestBid/getBestAsk
+ */
+TopOfBook ArrayOrderBook::top() const {
+    TopOfBook top;
+    top.bid_price = getBestBid();
+    top.ask_price = getBestAsk();
+    if (top.bid_price != 0) {
+        top.bid_quantity = in_band(top.bid_price) ? bid_levels[top.bid_price - base_price].total_quantity
+                                                  : sparse_bids.begin()->second.total_quantity;
+    }
+    if (top.ask_price != std::numeric_limits<uint32_t>::max()) {
+        top.ask_quantity = in_band(top.ask_price) ? ask_levels[top.ask_price - base_price].total_quantity
+                                                  : sparse_asks.begin()->second.total_quantity;
+    }
+    return top;
+}
+
+/* Best n levels of one side
+ * Sparse levels better than the band come first, then the band's set bits from the best cursor outwards (a clz/ctz
+ * per level, empty ticks are never visited), then the sparse levels beyond the band
+ */
+size_t ArrayOrderBook::getDepth(size_t n, bool is_buy, const DepthSpan& out) const {
+    size_t limit = std::min(n, out.capacity());
+    size_t count = 0;
+    if (is_buy) {
+        auto sparse = sparse_bids.begin();
+        for (; sparse != sparse_bids.end() && count < limit && sparse->first >= base_price + NUM_LEVELS; ++sparse) {
+            out.set(count++, sparse->first, sparse->second);
+        }
+        for (int32_t idx = best_bid_idx; idx >= 0 && count < limit; idx = highest_set_at_or_below(bid_bitmap, idx - 1)) {
+            out.set(count++, base_price + idx, bid_levels[idx]);
+        }
+        for (; sparse != sparse_bids.end() && count < limit; ++sparse) out.set(count++, sparse->first, sparse->second);
+    } else {
+        auto sparse = sparse_asks.begin();
+        for (; sparse != sparse_asks.end() && count < limit && sparse->first < base_price; ++sparse) {
+            out.set(count++, sparse->first, sparse->second);
+        }
+        for (int32_t idx = best_ask_idx; idx >= 0 && count < limit; idx = lowest_set_at_or_above(ask_bitmap, idx + 1)) {
+            out.set(count++, base_price + idx, ask_levels[idx]);
+        }
+        for (; sparse != sparse_asks.end() && count < limit; ++sparse) out.set(count++, sparse->first, sparse->second);
+    }
+    return count;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "OrderPool.h"
+#include "FlatHashIndex.h"
+#include "TradeBuffer.h"
+
+/* Order book engine that keeps price levels in a flat array centered on a reference price
+ * Same public API as OrderBook so MarketDataHandler can pick either one at compile time
+ * Prices inside the band [base_price, base_price + NUM_LEVELS) are a direct index, prices outside fall back to a sparse map
+ */
+class ArrayOrderBook {
+public:
+    // Number of ticks covered by the array. Power of two and a multiple of 64 so the bitmap has no partial words
+    static constexpr size_t NUM_LEVELS = 4096;
+    static constexpr size_t BITMAP_WORDS = NUM_LEVELS / 64;
+    static constexpr size_t DEFAULT_MAX_ORDERS = 1 << 20;
+    static constexpr size_t DEFAULT_MAX_SPARSE_LEVELS = 1 << 12;
+
+private:
+    OrderPool pool;
+
+    // Dense levels, one array per side so a crossed book can't collide on the same slot
+    std::vector<PriceLevel> bid_levels;
+    std::vector<PriceLevel> ask_levels;
+
+    // One bit per level, set while the level is non-empty. Lets us jump to the next level with a clz/ctz instead of walking empty slots
+    std::array<uint64_t, BITMAP_WORDS> bid_bitmap{};
+    std::array<uint64_t, BITMAP_WORDS> ask_bitmap{};
+
+    // Index of the best non-empty level inside the band, -1 if the band side is empty
+    int32_t best_bid_idx = -1;
+    int32_t best_ask_idx = -1;
+
+    uint32_t base_price; // Price of bid_levels[0]/ask_levels[0]
+
+    // Anything outside the band. Should be rare for our symbols so the O(log K) here doesn't matter
+    std::unique_ptr<LevelNodeSlab> sparse_nodes;   // On the heap so the maps' allocators survive a move of the book
+    LevelMap<std::greater<uint32_t>> sparse_bids;
+    LevelMap<std::less<uint32_t>> sparse_asks;
+
+    FlatHashIndex order_map;
+    bool top_changed = false;
+    TradeBuffer* trades = nullptr;  // Set in matching mode, fills go here
+
+    bool in_band(uint32_t price) const { return price - base_price < NUM_LEVELS; } // unsigned wrap handles price < base_price
+    PriceLevel& level_for(uint32_t price, bool is_buy);
+    PriceLevel& existing_level(const OrderNode& order);
+    void erase_from_level(OrderHandle h);
+    void note_level(uint32_t price, bool is_buy);
+    void reduce(OrderHandle h, uint32_t quantity);
+    uint32_t match(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy);
+
+    static void set_bit(std::array<uint64_t, BITMAP_WORDS>& bitmap, size_t idx) { bitmap[idx >> 6] |= 1ULL << (idx & 63); }
+    static void clear_bit(std::array<uint64_t, BITMAP_WORDS>& bitmap, size_t idx) { bitmap[idx >> 6] &= ~(1ULL << (idx & 63)); }
+    static int32_t highest_set_at_or_below(const std::array<uint64_t, BITMAP_WORDS>& bitmap, int32_t idx);
+    static int32_t lowest_set_at_or_above(const std::array<uint64_t, BITMAP_WORDS>& bitmap, int32_t idx);
+
+public:
+    /* reference_price should be roughly where the symbol trades, the band is centered on it
+     * Default matches the $10.00 - $20.00 range simulate_market_activity produces
+     * max_orders sizes the order node pool and max_sparse_levels the slab for levels outside the band, once
+     */
+    explicit ArrayOrderBook(uint32_t reference_price = 1500, size_t max_orders = DEFAULT_MAX_ORDERS,
+                            size_t max_sparse_levels = DEFAULT_MAX_SPARSE_LEVELS);
+
+    /* Matching mode: an order that crosses the spread trades against the opposite side first (see addOrder)
+     * and fills go to trade_buffer, which the caller drains. nullptr rests every order, as a market data book should
+     */
+    void set_matching(TradeBuffer* trade_buffer) { trades = trade_buffer; }
+    TradeBuffer* trade_buffer() const { return trades; }
+
+    bool addOrder(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy);
+    void removeOrder(uint64_t order_id);
+    void modifyOrder(uint64_t order_id, uint32_t new_quantity);
+    void reduceOrder(uint64_t order_id, uint32_t quantity);
+    void replaceOrder(uint64_t order_id, uint32_t new_price, uint32_t new_quantity);
+    uint32_t getBestBid() const;
+    uint32_t getBestAsk() const;
+    TopOfBook top() const;
+    size_t order_count() const { return pool.size(); }  // Resting orders, each holds one pool slot
+
+    /* Copy the best n levels of one side into out, as many as fit. Returns how many levels were written
+     * Level quantities and order counts are kept up to date by every update, so this is a walk over n levels only
+     */
+    size_t getDepth(size_t n, bool is_buy, const DepthSpan& out) const;
+
+    /* True if a best price, or the quantity at one, changed since the last call. Clears the flag
+     * Tracked as a side effect of the updates above, nothing is recomputed to answer
+     */
+    bool take_top_change() {
+        bool changed = top_changed;
+        top_changed = false;
+        return changed;
+    }
+};
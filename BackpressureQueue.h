@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <x86intrin.h>
+#include "SPSCRing.h"
+
+/* What the producer does when the ring is full
+ * - SpinRetry: pause and retry up to SPIN_RETRY_LIMIT times, then drop. Stalls RX but rides out short bursts
+ * - DropAndCount: drop straight away, never stalls RX
+ * - SpillToOverflow: push into a bigger secondary ring, only drop when that is full too
+ */
+enum class OverflowPolicy { SpinRetry, DropAndCount, SpillToOverflow };
+
+inline const char* overflow_policy_name(OverflowPolicy policy) {
+    switch (policy) {
+        case OverflowPolicy::SpinRetry: return "spin-retry";
+        case OverflowPolicy::DropAndCount: return "drop";
+        case OverflowPolicy::SpillToOverflow: return "spill";
+    }
+    return "unknown";
+}
+
+/* Counters for one queue, written by the producer (and high_water by the consumer), read by printStats
+ * Relaxed everywhere, they are gauges not synchronisation
+ */
+struct QueueOverflowStats {
+    std::atomic<uint64_t> spin_retries{0};  // Retry rounds the producer spent waiting for space
+    std::atomic<uint64_t> spilled{0};       // Items that went to the overflow ring
+    std::atomic<uint64_t> dropped{0};       // Items lost, the book has diverged if this is non-zero
+    std::atomic<size_t> high_water{0};      // Most items ever seen queued (primary + overflow) by the consumer
+};
+
+/* SPSC ring with an explicit policy for the full case, so nothing is lost without being counted
+ * Same producer/consumer split as SPSCRing. Ordering is kept under spill: the producer keeps using the overflow
+ * ring while it is non-empty, and the consumer only takes from overflow what was there before primary ran dry
+ */
+template<typename T, size_t Capacity, size_t OverflowCapacity = Capacity * 4>
+class BackpressureQueue {
+public:
+    static constexpr uint32_t SPIN_RETRY_LIMIT = 1024;
+
+private:
+    SPSCRing<T, Capacity> primary;
+    SPSCRing<T, OverflowCapacity> overflow;
+    OverflowPolicy policy = OverflowPolicy::DropAndCount;
+    QueueOverflowStats counters;
+
+public:
+    // Not thread safe against a running producer, set it before the lcores start
+    void set_policy(OverflowPolicy p) { policy = p; }
+    OverflowPolicy get_policy() const { return policy; }
+    const QueueOverflowStats& stats() const { return counters; }
+
+    /* Producer side. Returns how many of the n items were queued, always a prefix of items
+     * The rest were dropped and counted, the caller only has to release anything they own (mbuf references)
+     */
+    size_t push_bulk(const T* items, size_t n) {
+        size_t pushed = 0;
+        switch (policy) {
+            case OverflowPolicy::SpinRetry: {
+                pushed = primary.push_bulk(items, n);
+                for (uint32_t retry = 0; pushed < n && retry < SPIN_RETRY_LIMIT; ++retry) {
+                    _mm_pause();
+                    counters.spin_retries.fetch_add(1, std::memory_order_relaxed);
+                    pushed += primary.push_bulk(items + pushed, n - pushed);
+                }
+                break;
+            }
+            case OverflowPolicy::DropAndCount:
+                pushed = primary.push_bulk(items, n);
+                break;
+            case OverflowPolicy::SpillToOverflow: {
+                // Anything already spilled is older than these, so they have to queue behind it
+                if (overflow.empty()) pushed = primary.push_bulk(items, n);
+                if (pushed < n) {
+                    size_t spilled = overflow.push_bulk(items + pushed, n - pushed);
+                    counters.spilled.fetch_add(spilled, std::memory_order_relaxed);
+                    pushed += spilled;
+                }
+                break;
+            }
+        }
+        if (pushed < n) counters.dropped.fetch_add(n - pushed, std::memory_order_relaxed);
+        return pushed;
+    }
+
+    bool push(const T& item) {
+        return push_bulk(&item, 1) == 1;
+    }
+
+    /* Consumer side. Pops up to n items, primary first
+     * The overflow count is read before primary: anything in overflow at that point was spilled before the producer
+     * could go back to primary, so it is older than whatever primary gets next. Taking only that many keeps FIFO
+     */
+    size_t pop_bulk(T* out, size_t n) {
+        size_t spilled = overflow.size();
+        size_t queued = primary.size() + spilled;
+        if (queued > counters.high_water.load(std::memory_order_relaxed)) {
+            counters.high_water.store(queued, std::memory_order_relaxed);
+        }
+
+        size_t popped = primary.pop_bulk(out, n);
+        if (popped == 0 && spilled > 0) {
+            popped = overflow.pop_bulk(out, std::min(n, spilled));
+        }
+        return popped;
+    }
+
+    bool pop(T& item) {
+        return pop_bulk(&item, 1) == 1;
+    }
+
+    size_t size() const { return primary.size() + overflow.size(); }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+    static constexpr size_t overflow_capacity() { return OverflowCapacity; }
+};
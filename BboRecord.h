@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <x86intrin.h>
+#include "OrderPool.h"
+
+// A consistent copy of one book's best bid/offer, as read from its BboRecord
+struct BboQuote {
+    uint32_t bid_price = 0;             // 0 if no bids
+    uint32_t ask_price = UINT32_MAX;    // UINT32_MAX if no asks
+    uint64_t bid_quantity = 0;
+    uint64_t ask_quantity = 0;
+    uint64_t sequence = 0;              // Publishes so far, 0 = never published. Goes up by one per top-of-book change
+    uint64_t update_tsc = 0;            // When the book update behind this quote finished, TSC cycles
+};
+
+/* Best bid/offer of one book, published by the owning worker for readers on any core
+ * Seqlock with a single writer: the sequence goes odd, the fields are stored, the sequence goes even. The writer
+ * never waits, a reader that raced it sees the sequence move and tries again. Every field is an atomic accessed
+ * relaxed, so a torn read is discarded rather than being a data race
+ * One cache line per record, so a busy book's publishes never invalidate a line readers of another book are polling
+ */
+class alignas(64) BboRecord {
+private:
+    std::atomic<uint64_t> sequence{0};  // Odd while a publish is in progress
+    std::atomic<uint32_t> bid_price{0};
+    std::atomic<uint32_t> ask_price{UINT32_MAX};
+    std::atomic<uint64_t> bid_quantity{0};
+    std::atomic<uint64_t> ask_quantity{0};
+    std::atomic<uint64_t> update_tsc{0};
+
+public:
+    // Owning worker only
+    void publish(const TopOfBook& top, uint64_t tsc) {
+        uint64_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bid_price.store(top.bid_price, std::memory_order_relaxed);
+        ask_price.store(top.ask_price, std::memory_order_relaxed);
+        bid_quantity.store(top.bid_quantity, std::memory_order_relaxed);
+        ask_quantity.store(top.ask_quantity, std::memory_order_relaxed);
+        update_tsc.store(tsc, std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    /* One attempt, wait-free: a handful of loads and no loop
+     * False if a publish was in progress or landed during the copy, out is then unspecified
+     */
+    bool try_read(BboQuote& out) const {
+        uint64_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) return false;
+        out.bid_price = bid_price.load(std::memory_order_relaxed);
+        out.ask_price = ask_price.load(std::memory_order_relaxed);
+        out.bid_quantity = bid_quantity.load(std::memory_order_relaxed);
+        out.ask_quantity = ask_quantity.load(std::memory_order_relaxed);
+        out.update_tsc = update_tsc.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        out.sequence = before / 2;
+        return sequence.load(std::memory_order_relaxed) == before;
+    }
+
+    // Retries until it gets a consistent copy. The writer's window is a few stores, so this rarely loops
+    BboQuote read() const {
+        BboQuote quote;
+        while (!try_read(quote)) {
+            _mm_pause();
+        }
+        return quote;
+    }
+};
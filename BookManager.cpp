@@ -0,0 +1,74 @@
+#include "BookManager.h"
+#include <algorithm>
+#include <iostream>
+
+/* Build the symbol table and one book per instrument
+ * Duplicate symbols are a config error, they are reported and only the first one gets a book
+ */
+BookManager::BookManager(const std::vector<InstrumentConfig>& instruments, size_t max_orders_per_book)
+        : symbol_index(instruments.size()) {
+    books.reserve(instruments.size());
+    symbols.reserve(instruments.size());
+    requested_shard.reserve(instruments.size());
+    for (const InstrumentConfig& instrument : instruments) {
+        uint64_t key = pack_symbol(instrument.symbol);
+        if (symbol_index.find(key) != FlatHashIndex::NOT_FOUND) {
+            std::cerr << "Duplicate symbol in instrument list: " << instrument.symbol << std::endl;
+            continue;
+        }
+        symbol_index.insert(key, static_cast<uint32_t>(books.size()));
+        symbols.push_back(key);
+        requested_shard.push_back(instrument.shard);
+        // A level holds at least one order, so the order capacity bounds the level slab too
+#ifdef USE_ARRAY_ORDER_BOOK
+        books.push_back({BookEngine(instrument.reference_price, max_orders_per_book,
+                                    std::min(max_orders_per_book, ArrayOrderBook::DEFAULT_MAX_SPARSE_LEVELS))});
+#else
+        books.push_back({BookEngine(max_orders_per_book, max_orders_per_book)});
+#endif
+    }
+    bbo = std::make_unique<BboRecord[]>(books.size());
+    assign_shards(1);
+}
+
+void BookManager::assign_shards(uint16_t shard_count) {
+    shard_total = shard_count > 0 ? shard_count : 1;
+    shards.assign(books.size(), 0);
+    for (size_t i = 0; i < books.size(); ++i) {
+        int requested = requested_shard[i];
+        if (requested >= 0 && requested < shard_total) {
+            shards[i] = static_cast<uint16_t>(requested);
+        } else {
+            if (requested >= shard_total) {
+                std::cerr << "Shard " << requested << " for " << unpack_symbol(symbols[i]) << " doesn't exist, hashing instead" << std::endl;
+            }
+            // Fibonacci hash, the high bits mix every byte of the symbol
+            shards[i] = static_cast<uint16_t>(((symbols[i] * 0x9E3779B97F4A7C15ULL) >> 32) % shard_total);
+        }
+    }
+}
+
+void BookManager::enable_matching(size_t trade_buffer_size) {
+    trade_buffers.clear();
+    for (size_t i = 0; i < books.size(); ++i) {
+        trade_buffers.push_back(std::make_unique<TradeBuffer>(trade_buffer_size));
+        books[i].engine.set_matching(trade_buffers.back().get());
+    }
+}
+
+uint64_t BookManager::pack_symbol(const std::string& symbol) {
+    char padded[8];
+    std::memset(padded, ' ', sizeof(padded));
+    std::memcpy(padded, symbol.data(), std::min(symbol.size(), sizeof(padded)));
+    uint64_t key;
+    std::memcpy(&key, padded, sizeof(key));
+    return key;
+}
+
+std::string BookManager::unpack_symbol(uint64_t packed) {
+    char padded[8];
+    std::memcpy(padded, &packed, sizeof(padded));
+    std::string symbol(padded, sizeof(padded));
+    symbol.erase(symbol.find_last_not_of(' ') + 1);
+    return symbol;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "BboRecord.h"
+#include "FlatHashIndex.h"
+#include "OrderBook.h"
+
+/* Book engine is picked at compile time, both expose addOrder/removeOrder/modifyOrder/getBestBid/getBestAsk/top/getDepth
+ * Build with -DUSE_ARRAY_ORDER_BOOK=ON for the array-indexed engine
+ */
+#ifdef USE_ARRAY_ORDER_BOOK
+#include "ArrayOrderBook.h"
+using BookEngine = ArrayOrderBook;
+#else
+using BookEngine = OrderBook;
+#endif
+
+// Static description of one instrument, read at startup
+struct InstrumentConfig {
+    std::string symbol;
+    uint32_t reference_price;   // Where the symbol is expected to trade, centers the ArrayOrderBook band
+    int shard = -1;             // Worker that owns the book, -1 to pick it from the symbol hash
+};
+
+/* Owns one book per instrument, stored contiguously and addressed by a dense instrument index
+ * The 8-byte wire symbol is treated as a uint64_t key, so routing a message is one flat hash probe, no string compares
+ * The instrument set is fixed at construction, nothing is added on the hot path
+ *
+ * Sharding: every book belongs to exactly one worker shard, and only that worker's core ever touches it. Books are
+ * padded to whole cache lines so two shards' books never share one. lookup() and shard_of() only read tables built
+ * at construction, so RX cores can call them to route messages
+ */
+class BookManager {
+private:
+    struct alignas(64) BookSlot {
+        BookEngine engine;
+    };
+
+    std::vector<BookSlot> books;
+    std::vector<uint64_t> symbols;      // Packed symbol per instrument index, for reporting
+    std::vector<int> requested_shard;   // From InstrumentConfig, -1 = hash
+    std::vector<uint16_t> shards;       // Owning shard per instrument index
+    uint16_t shard_total = 1;
+    std::unique_ptr<BboRecord[]> bbo;   // Seqlocked best bid/offer per book, so other cores never touch a book
+    std::vector<std::unique_ptr<TradeBuffer>> trade_buffers;  // One per book in matching mode, empty otherwise
+    FlatHashIndex symbol_index;         // Packed symbol -> instrument index
+
+public:
+    static constexpr uint32_t UNKNOWN_INSTRUMENT = FlatHashIndex::NOT_FOUND;
+    static constexpr size_t DEFAULT_MAX_ORDERS_PER_BOOK = 1 << 14;
+    static constexpr size_t DEFAULT_TRADE_BUFFER_SIZE = 1024;  // Fills one message can produce before overflow is counted
+
+    BookManager(const std::vector<InstrumentConfig>& instruments, size_t max_orders_per_book = DEFAULT_MAX_ORDERS_PER_BOOK);
+
+    /* Pack a symbol into the 8-byte wire form: left aligned, space padded (ITCH convention)
+     * Longer symbols are truncated to 8 characters
+     */
+    static uint64_t pack_symbol(const std::string& symbol);
+    static std::string unpack_symbol(uint64_t packed);
+
+    // Instrument index for a wire symbol, UNKNOWN_INSTRUMENT if it isn't in the symbol list
+    uint32_t lookup(const char* symbol) const {
+        uint64_t key;
+        std::memcpy(&key, symbol, sizeof(key));
+        return symbol_index.find(key);
+    }
+
+    /* Split the instruments over shard_count workers
+     * Instruments with a shard in their config keep it (if it exists), the rest go by a hash of the packed symbol,
+     * so the same symbol list always gives the same owners
+     */
+    void assign_shards(uint16_t shard_count);
+
+    /* Turn every book into a price-time matching engine, a local exchange for strategy testing
+     * Each book gets its own trade buffer, drained by the owning worker. Call before any worker runs
+     */
+    void enable_matching(size_t trade_buffer_size = DEFAULT_TRADE_BUFFER_SIZE);
+    bool matching() const { return !trade_buffers.empty(); }
+    const TradeBuffer& trades(uint32_t instrument) const { return *trade_buffers[instrument]; }
+    uint16_t shard_of(uint32_t instrument) const { return shards[instrument]; }
+    uint16_t shard_count() const { return shard_total; }
+
+    // Owning worker only, with the book's current top and when the update behind it finished
+    void publish_top(uint32_t instrument, const TopOfBook& top, uint64_t update_tsc) {
+        bbo[instrument].publish(top, update_tsc);
+    }
+
+    /* Last published best bid/offer, consistent and safe from any core (strategy, risk, stats)
+     * Same empty values as getBestBid/getBestAsk. The record itself for readers that want try_read
+     */
+    BboQuote top_of_book(uint32_t instrument) const { return bbo[instrument].read(); }
+    const BboRecord& bbo_record(uint32_t instrument) const { return bbo[instrument]; }
+
+    BookEngine& book(uint32_t instrument) { return books[instrument].engine; }
+    const BookEngine& book(uint32_t instrument) const { return books[instrument].engine; }
+    uint64_t symbol(uint32_t instrument) const { return symbols[instrument]; }
+    size_t size() const { return books.size(); }
+};
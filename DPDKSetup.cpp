@@ -1,41 +1,66 @@
 #include <cstdint>
 #include <iostream>
+#include <string>
+#include <vector>
 #include <rte_eal.h>
 #include <rte_ethdev.h>
 #include <rte_mbuf.h>
 #include "DPDKSetup.h"
+#include "FrameRecorder.h"
 
 // Global variables
 struct rte_mempool* mbuf_pool = nullptr;
+struct rte_mempool* tx_mbuf_pool = nullptr;
 volatile bool force_quit = false;
+NicRxTimestamps nic_rx_timestamps[RTE_MAX_ETHPORTS];
 
-int dpdk_init(int argc, char* argv[]) {
+namespace {
+    constexpr uint64_t TX_CHECKSUM_OFFLOADS = RTE_ETH_TX_OFFLOAD_IPV4_CKSUM | RTE_ETH_TX_OFFLOAD_TCP_CKSUM;
+}
+
+int dpdk_init(const char* program, AppConfig& config) {
     int ret;
 
     /* DPDK Environment Abstraction Layer (EAL) arguments
      * These settings configure DPDK's runtime environment
+     * Anything given on the command line before "--" goes after them (e.g. --vdev=net_pcap0,... or -l 0-4)
      */
-    char* dpdk_args[] = {
-            argv[0],
+    std::vector<std::string> dpdk_args = {
+            program,
             "--file-prefix", "unique_prefix3",  // Unique prefix to avoid conflicts. Not really needed but good to have
             "--socket-mem", "1024",             // Allocate 1GB of memory
             "--huge-dir", "/mnt/huge",          // Directory for hugepages
-            NULL
     };
+    dpdk_args.insert(dpdk_args.end(), config.eal_args.begin(), config.eal_args.end());
+    std::vector<char*> eal_argv;
+    for (std::string& arg : dpdk_args) eal_argv.push_back(arg.data());
+    eal_argv.push_back(nullptr);
 
     /* Initialize the Environment Abstraction Layer (EAL)
      * This sets up DPDK's core functionality
      */
-    ret = rte_eal_init(sizeof(dpdk_args) / sizeof(dpdk_args[0]) - 1, dpdk_args);
+    ret = rte_eal_init(static_cast<int>(eal_argv.size() - 1), eal_argv.data());
     if (ret < 0) {
         std::cerr << "Error with EAL initialization" << std::endl;
         return -1;
     }
 
+    // Everything on the hot path timestamps in TSC cycles, the conversion to ns needs the rate
+    TscClock::calibrate();
+
+    if (!assign_lcores(config)) {
+        return -1;
+    }
+
     /* Create a memory pool for packet buffers
      * This pre-allocates memory for packet handling
+     * Every RX queue keeps a full ring of descriptors filled, so the pool grows with the queue and port count
      */
-    mbuf_pool = rte_pktmbuf_pool_create("MBUF_POOL", NUM_MBUFS,
+    std::vector<uint16_t> ports = active_ports(config);
+    unsigned num_mbufs = NUM_MBUFS + ports.size() * config.rx_queues * RX_RING_SIZE;
+    // --record holds up to a ring's worth of frames per queue until the writer thread catches up
+    if (!config.record_path.empty()) num_mbufs += config.rx_queues * FrameRecorder::RING_SIZE;
+    mbuf_pool = rte_pktmbuf_pool_create("MBUF_POOL", num_mbufs,
                                         MBUF_CACHE_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
 
     if (mbuf_pool == nullptr) {
@@ -43,12 +68,23 @@ int dpdk_init(int argc, char* argv[]) {
         return -1;
     }
 
-    // Initialize port 0
-    if (port_init(0, mbuf_pool) != 0) {
-        std::cerr << "Cannot init port 0" << std::endl;
+    /* Separate pool for order entry
+     * RX keeps its pool drained to the ring size, orders must still find a buffer when a market data burst is in flight
+     */
+    tx_mbuf_pool = rte_pktmbuf_pool_create("TX_MBUF_POOL", NUM_TX_MBUFS,
+                                           MBUF_CACHE_SIZE, 0, TX_MBUF_DATA_SIZE, rte_socket_id());
+    if (tx_mbuf_pool == nullptr) {
+        std::cerr << "Cannot create TX mbuf pool" << std::endl;
         return -1;
     }
 
+    for (uint16_t port : ports) {
+        if (port_init(port, mbuf_pool, config.rx_queues) != 0) {
+            std::cerr << "Cannot init port " << port << std::endl;
+            return -1;
+        }
+    }
+
     return 0;
 }
 
@@ -57,11 +93,15 @@ void dpdk_cleanup() {
     rte_eal_cleanup();
 }
 
-int port_init(uint16_t port, struct rte_mempool* mbuf_pool) {
-    std::cout << "Initializing port " << port << "..." << std::endl;
+/* Bring up a port with rx_rings RX queues and one TX queue
+ * With more than one RX queue, RSS hashes the IP/UDP/TCP tuple so a flow always lands on the same queue (and core)
+ * vdevs like net_pcap and net_ring have no RSS, their queues are fed per queue by the vdev arguments instead
+ */
+int port_init(uint16_t port, struct rte_mempool* mbuf_pool, uint16_t rx_rings) {
+    std::cout << "Initializing port " << port << " with " << rx_rings << " RX queue(s)..." << std::endl;
 
     struct rte_eth_conf port_conf = {};
-    const uint16_t rx_rings = 1, tx_rings = 1;
+    const uint16_t tx_rings = 1;
     uint16_t nb_rxd = RX_RING_SIZE;
     uint16_t nb_txd = TX_RING_SIZE;
     int retval;
@@ -75,6 +115,44 @@ int port_init(uint16_t port, struct rte_mempool* mbuf_pool) {
         return -1;
     }
 
+    /* Hardware RX timestamps if the PMD offers them
+     * The dynamic mbuf field has to exist before the port is configured with the offload
+     */
+    struct rte_eth_dev_info dev_info;
+    retval = rte_eth_dev_info_get(port, &dev_info);
+    if (retval != 0) {
+        std::cerr << "Failed to get device info for port " << port << "." << std::endl;
+        return retval;
+    }
+    if (rx_rings > dev_info.max_rx_queues) {
+        std::cerr << "Port " << port << " supports at most " << dev_info.max_rx_queues << " RX queues." << std::endl;
+        return -1;
+    }
+    if (rx_rings > 1) {
+        uint64_t rss_hf = (RTE_ETH_RSS_IP | RTE_ETH_RSS_UDP | RTE_ETH_RSS_TCP) & dev_info.flow_type_rss_offloads;
+        if (rss_hf != 0) {
+            port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+            port_conf.rx_adv_conf.rss_conf.rss_key = nullptr;  // PMD's default key
+            port_conf.rx_adv_conf.rss_conf.rss_hf = rss_hf;
+        } else {
+            std::cout << "Port " << port << " has no RSS, traffic per queue is up to the device" << std::endl;
+        }
+    }
+
+    bool hw_timestamps = (dev_info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_TIMESTAMP) && nic_rx_timestamps[port].register_field();
+    if (hw_timestamps) {
+        port_conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+    } else {
+        std::cout << "Port " << port << " has no hardware RX timestamps, using TSC at rx_burst" << std::endl;
+    }
+
+    // Order entry checksums on the NIC when it can do both, OrderSender asks port_tx_checksum_offload the same question
+    if ((dev_info.tx_offload_capa & TX_CHECKSUM_OFFLOADS) == TX_CHECKSUM_OFFLOADS) {
+        port_conf.txmode.offloads |= TX_CHECKSUM_OFFLOADS;
+    } else {
+        std::cout << "Port " << port << " has no IPv4/TCP checksum offload, checksumming in software" << std::endl;
+    }
+
     /* Configure the Ethernet device
      * This sets up the basic parameters for the port
      */
@@ -131,6 +209,17 @@ int port_init(uint16_t port, struct rte_mempool* mbuf_pool) {
      */
     rte_eth_promiscuous_enable(port);
 
+    // The NIC clock only runs once the port is started
+    if (hw_timestamps) {
+        nic_rx_timestamps[port].sync(port);
+    }
+
     std::cout << "Port " << port << " initialized successfully." << std::endl;
     return 0;
-}
\ No newline at end of file
+}
+
+bool port_tx_checksum_offload(uint16_t port) {
+    struct rte_eth_dev_info dev_info;
+    if (rte_eth_dev_info_get(port, &dev_info) != 0) return false;
+    return (dev_info.tx_offload_capa & TX_CHECKSUM_OFFLOADS) == TX_CHECKSUM_OFFLOADS;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <rte_ethdev.h>
+#include "AppConfig.h"
+#include "TscClock.h"
 
 /* Define constants for DPDK setup
  * These values can be tuned based on your specific hardware and requirements
@@ -10,12 +12,24 @@
 #define NUM_MBUFS 8191
 #define MBUF_CACHE_SIZE 250
 #define BURST_SIZE 32
+#define NUM_TX_MBUFS 8191                               // A full TX ring in flight plus the sender's staged batch
+#define TX_MBUF_DATA_SIZE (RTE_PKTMBUF_HEADROOM + 512)  // Order entry frames are one small order each
 
 // Declare external variables
 extern struct rte_mempool* mbuf_pool;
+extern struct rte_mempool* tx_mbuf_pool;    // Order entry only, see OrderSender
 extern volatile bool force_quit;
+extern NicRxTimestamps nic_rx_timestamps[RTE_MAX_ETHPORTS];   // Indexed by port id, every NIC runs its own clock
 
 // Function declarations
-int dpdk_init(int argc, char* argv[]);
+int dpdk_init(const char* program, AppConfig& config);
 void dpdk_cleanup();
-int port_init(uint16_t port, struct rte_mempool* mbuf_pool);
\ No newline at end of file
+int port_init(uint16_t port, struct rte_mempool* mbuf_pool, uint16_t rx_rings);
+// Whether the port can checksum IPv4 and TCP on transmit. port_init enables both offloads when it can
+bool port_tx_checksum_offload(uint16_t port);
+
+// TSC time an mbuf arrived, mapped from the clock of the port it came in on. fallback_tsc if that port has no stamps
+inline uint64_t mbuf_rx_tsc(const struct rte_mbuf* mbuf, uint64_t fallback_tsc) {
+    if (mbuf->port >= RTE_MAX_ETHPORTS) return fallback_tsc;
+    return nic_rx_timestamps[mbuf->port].rx_tsc(mbuf, fallback_tsc);
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "FeedHandler.h"
+#include <cstdio>
+#include <iostream>
+
+namespace {
+    uint16_t load_be16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+    uint32_t load_be32(const uint8_t* p) {
+        return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | p[3];
+    }
+
+    constexpr size_t ETHER_HEADER_LEN = 14;
+    constexpr size_t VLAN_TAG_LEN = 4;
+    constexpr uint16_t ETHER_TYPE_IPV4 = 0x0800;
+    constexpr uint16_t ETHER_TYPE_VLAN = 0x8100;
+    constexpr size_t IPV4_MIN_HEADER_LEN = 20;
+    constexpr uint8_t IP_PROTO_UDP = 17;
+    constexpr size_t UDP_HEADER_LEN = 8;
+}
+
+/* Builds the group lookup table and the per-channel state
+ * Both lines of every channel go in one table, so a packet's line is found from its destination alone
+ */
+FeedHandler::FeedHandler(const std::vector<FeedChannelConfig>& channel_configs, uint64_t max_hold_cycles)
+        : configs(channel_configs),
+          channels(std::make_unique<Channel[]>(channel_configs.size())),
+          group_index(channel_configs.size() * 2),
+          max_hold_cycles(max_hold_cycles) {
+    for (size_t id = 0; id < configs.size(); ++id) {
+        const FeedChannelConfig& config = configs[id];
+        const uint64_t keys[2] = {group_key(config.group_a, config.port_a), group_key(config.group_b, config.port_b)};
+        for (uint32_t line = 0; line < 2; ++line) {
+            if (group_index.find(keys[line]) != FlatHashIndex::NOT_FOUND) {
+                std::cerr << "Feed channel " << config.name << " reuses a group already in the table, ignored" << std::endl;
+                continue;
+            }
+            group_index.insert(keys[line], static_cast<uint32_t>(id << 1 | line));
+        }
+    }
+}
+
+size_t FeedHandler::locate_udp_payload(const uint8_t* data, size_t len, const uint8_t** payload, uint32_t& group, uint16_t& port) {
+    if (len < ETHER_HEADER_LEN) {
+        bump(malformed_packets);
+        return 0;
+    }
+    size_t offset = ETHER_HEADER_LEN;
+    uint16_t ether_type = load_be16(data + 12);
+    if (ether_type == ETHER_TYPE_VLAN) {
+        if (len < ETHER_HEADER_LEN + VLAN_TAG_LEN) {
+            bump(malformed_packets);
+            return 0;
+        }
+        ether_type = load_be16(data + 16);
+        offset += VLAN_TAG_LEN;
+    }
+    if (ether_type != ETHER_TYPE_IPV4) {
+        bump(other_packets);
+        return 0;
+    }
+
+    const uint8_t* ip = data + offset;
+    if (len - offset < IPV4_MIN_HEADER_LEN || (ip[0] >> 4) != 4) {
+        bump(malformed_packets);
+        return 0;
+    }
+    size_t ip_header_len = static_cast<size_t>(ip[0] & 0x0F) * 4;
+    size_t ip_total_len = load_be16(ip + 2);
+    if (ip_header_len < IPV4_MIN_HEADER_LEN || ip_total_len < ip_header_len || ip_total_len > len - offset) {
+        bump(malformed_packets);
+        return 0;
+    }
+    if (ip[9] != IP_PROTO_UDP) {
+        bump(other_packets);
+        return 0;
+    }
+    if (load_be16(ip + 6) & 0x3FFF) {  // More fragments flag or a fragment offset
+        bump(fragments);
+        return 0;
+    }
+
+    // The whole UDP header must be inside the IP datagram before any of it is read
+    if (ip_total_len - ip_header_len < UDP_HEADER_LEN) {
+        bump(malformed_packets);
+        return 0;
+    }
+    const uint8_t* udp = ip + ip_header_len;
+    size_t udp_len = load_be16(udp + 4);
+    if (udp_len < UDP_HEADER_LEN || udp_len > ip_total_len - ip_header_len) {
+        bump(malformed_packets);
+        return 0;
+    }
+
+    group = load_be32(ip + 16);
+    port = load_be16(udp + 2);
+    *payload = udp + UDP_HEADER_LEN;
+    return udp_len - UDP_HEADER_LEN;
+}
+
+uint32_t FeedHandler::parse_ipv4(const char* text) {
+    unsigned a, b, c, d;
+    char extra;
+    if (std::sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+        return 0;
+    }
+    return (a << 24) | (b << 16) | (c << 8) | d;
+}
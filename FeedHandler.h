@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FlatHashIndex.h"
+#include "SIMDMessageParser.h"
+
+/* UDP multicast market data with A/B line arbitration
+ * Exchanges publish every channel twice, on an A and a B multicast group, over separate network paths.
+ * Each message carries a per-channel sequence number. Whichever copy of a sequence number arrives first is delivered,
+ * the other one is a duplicate. Messages ahead of the next expected sequence number wait in a small reorder window
+ * (one slot per sequence number, indexed seq % REORDER_WINDOW), in case the other line still has the missing ones.
+ * A sequence number neither line delivers is a gap: declared when the window overflows, or when the oldest held
+ * message has waited longer than max_hold. Nothing allocates after construction
+ *
+ * Packets are Ethernet (optionally one 802.1Q tag), IPv4 without fragments, UDP, then back-to-back wire messages
+ * (SIMDMessageParser::WIRE_SIZE each). All state is owned by the one lcore that polls both lines
+ */
+
+enum class FeedLine : uint8_t { A = 0, B = 1 };
+
+// One channel published on two multicast groups. Addresses and ports in host byte order
+struct FeedChannelConfig {
+    std::string name;
+    uint32_t group_a;
+    uint16_t port_a;
+    uint32_t group_b;
+    uint16_t port_b;
+};
+
+// Written by the feed lcore only, safe to read from any core
+struct FeedChannelStats {
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> duplicates{0};      // Second copies, and anything arriving after its gap was declared
+    std::atomic<uint64_t> reordered{0};       // Delivered out of the reorder window rather than straight off the wire
+    std::atomic<uint64_t> gaps{0};            // Runs of missing sequence numbers
+    std::atomic<uint64_t> gap_messages{0};    // Sequence numbers neither line delivered
+    std::atomic<uint64_t> line_wins[2] = {};  // Packets per line that delivered at least one message first
+};
+
+class FeedHandler {
+public:
+    static constexpr uint32_t REORDER_WINDOW = 64;  // One bit per slot in Channel::held_mask
+    static constexpr size_t PARSE_BLOCK = 64;       // Messages decoded per parse_batch call
+
+private:
+    struct Channel {
+        uint32_t next_seq = 0;
+        bool synced = false;            // First message seen, next_seq is meaningful
+        uint64_t held_mask = 0;         // Bit i set: held[i] holds the message with seq % REORDER_WINDOW == i
+        uint64_t held_since = 0;        // TSC when the oldest held message started waiting
+        MarketDataMessage held[REORDER_WINDOW];
+        FeedChannelStats stats;
+    };
+
+    std::vector<FeedChannelConfig> configs;
+    std::unique_ptr<Channel[]> channels;
+    FlatHashIndex group_index;          // (group << 16 | port) -> channel << 1 | line
+    uint64_t max_hold_cycles;
+
+    std::atomic<uint64_t> other_packets{0};     // Not IPv4/UDP, or not to one of our groups
+    std::atomic<uint64_t> malformed_packets{0}; // Truncated headers or a payload that isn't whole messages
+    std::atomic<uint64_t> fragments{0};         // IP fragments, the feed never sends them
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    static uint64_t group_key(uint32_t group, uint16_t port) { return (uint64_t{group} << 16) | port; }
+    // Wrap-safe distance from a to b, negative when b is behind a
+    static int32_t seq_diff(uint32_t a, uint32_t b) { return static_cast<int32_t>(b - a); }
+    static uint32_t wire_seq(const uint8_t* message) {
+        return MarketDataWireSchema::field<&MarketDataMessage::sequence_number>::load(reinterpret_cast<const char*>(message));
+    }
+
+    /* Deliver the held messages in sequence order until the next one is missing
+     * The window is a circular buffer keyed by sequence number, so this is a bit test per message
+     */
+    template<typename Sink>
+    void drain(Channel& ch, Sink& sink) {
+        uint32_t slot = ch.next_seq % REORDER_WINDOW;
+        uint32_t released = 0;
+        while (ch.held_mask & (uint64_t{1} << slot)) {
+            ch.held_mask &= ~(uint64_t{1} << slot);
+            sink.on_message(ch.held[slot]);
+            ++ch.next_seq;
+            ++released;
+            slot = ch.next_seq % REORDER_WINDOW;
+        }
+        if (released > 0) {
+            bump(ch.stats.delivered, released);
+            bump(ch.stats.reordered, released);
+        }
+    }
+
+    /* Give up on every sequence number before target: held ones are delivered, the rest are reported as gaps
+     * Anything held from target on that is now in sequence goes out too, so the window never holds next_seq
+     * Bounded by the window, once nothing is held the rest of the range is one gap
+     */
+    template<typename Sink>
+    void skip_to(uint16_t id, Channel& ch, uint32_t target, Sink& sink) {
+        while (seq_diff(ch.next_seq, target) > 0) {
+            if (ch.held_mask == 0) {
+                report_gap(id, ch, ch.next_seq, target - ch.next_seq, sink);
+                ch.next_seq = target;
+                break;
+            }
+            uint32_t slot = ch.next_seq % REORDER_WINDOW;
+            if (ch.held_mask & (uint64_t{1} << slot)) {
+                drain(ch, sink);
+                continue;
+            }
+            // Missing run up to the next held message (or target, whichever is first)
+            uint64_t rotated = std::rotr(ch.held_mask, static_cast<int>(slot));
+            uint32_t run = static_cast<uint32_t>(std::countr_zero(rotated));
+            if (seq_diff(ch.next_seq, target) < static_cast<int32_t>(run)) run = target - ch.next_seq;
+            report_gap(id, ch, ch.next_seq, run, sink);
+            ch.next_seq += run;
+        }
+        drain(ch, sink);
+    }
+
+    template<typename Sink>
+    void report_gap(uint16_t id, Channel& ch, uint32_t first_seq, uint32_t count, Sink& sink) {
+        bump(ch.stats.gaps);
+        bump(ch.stats.gap_messages, count);
+        sink.on_gap(id, first_seq, count);
+    }
+
+    // Arbitrate one message, true if it was delivered or held (this line won it)
+    template<typename Sink>
+    bool arbitrate(uint16_t id, Channel& ch, const MarketDataMessage& msg, uint64_t rx_tsc, Sink& sink) {
+        if (!ch.synced) {
+            // Joining mid-session: whatever arrives first is the start, earlier messages need a snapshot anyway
+            ch.synced = true;
+            ch.next_seq = msg.sequence_number;
+        }
+        int32_t ahead = seq_diff(ch.next_seq, msg.sequence_number);
+        if (ahead < 0) {
+            bump(ch.stats.duplicates);
+            return false;
+        }
+        if (ahead == 0) {
+            sink.on_message(msg);
+            ++ch.next_seq;
+            bump(ch.stats.delivered);
+            if (ch.held_mask != 0) drain(ch, sink);
+            return true;
+        }
+        if (static_cast<uint32_t>(ahead) >= REORDER_WINDOW) {
+            // Too far ahead to hold, the oldest missing ones are given up on to make room
+            skip_to(id, ch, msg.sequence_number - REORDER_WINDOW + 1, sink);
+            if (ch.next_seq == msg.sequence_number) {
+                sink.on_message(msg);
+                ++ch.next_seq;
+                bump(ch.stats.delivered);
+                if (ch.held_mask != 0) drain(ch, sink);
+                return true;
+            }
+        }
+        uint32_t slot = msg.sequence_number % REORDER_WINDOW;
+        if (ch.held_mask & (uint64_t{1} << slot)) {
+            bump(ch.stats.duplicates);
+            return false;
+        }
+        if (ch.held_mask == 0) ch.held_since = rx_tsc;
+        ch.held[slot] = msg;
+        ch.held_mask |= uint64_t{1} << slot;
+        return true;
+    }
+
+public:
+    // max_hold_cycles: how long a message may wait in the reorder window for the other line, TSC cycles
+    FeedHandler(const std::vector<FeedChannelConfig>& channel_configs, uint64_t max_hold_cycles);
+
+    /* Ethernet/IPv4/UDP header walk, straight off the packet bytes
+     * Returns the UDP payload length and sets payload, group and port (host order). 0 if the packet isn't IPv4/UDP
+     */
+    size_t locate_udp_payload(const uint8_t* data, size_t len, const uint8_t** payload, uint32_t& group, uint16_t& port);
+
+    /* Arbitrate every message in one packet from either line
+     * Sink gets on_message(const MarketDataMessage&) in sequence order per channel, and on_gap(channel, first_seq, count)
+     * A packet whose last message is already behind the channel (the losing line, normally) is dropped without decoding
+     */
+    template<typename Sink>
+    void process_packet(const uint8_t* data, size_t len, uint64_t rx_tsc, Sink& sink) {
+        const uint8_t* payload = nullptr;
+        uint32_t group = 0;
+        uint16_t port = 0;
+        size_t payload_len = locate_udp_payload(data, len, &payload, group, port);
+        if (payload_len == 0) return;
+
+        uint32_t entry = group_index.find(group_key(group, port));
+        if (entry == FlatHashIndex::NOT_FOUND) {
+            bump(other_packets);
+            return;
+        }
+        if (payload_len % SIMDMessageParser::WIRE_SIZE != 0) {
+            bump(malformed_packets);
+            return;
+        }
+        uint16_t id = static_cast<uint16_t>(entry >> 1);
+        size_t line = entry & 1;
+        Channel& ch = channels[id];
+        size_t count = payload_len / SIMDMessageParser::WIRE_SIZE;
+
+        uint32_t last_seq = wire_seq(payload + (count - 1) * SIMDMessageParser::WIRE_SIZE);
+        if (ch.synced && seq_diff(ch.next_seq, last_seq) < 0) {
+            bump(ch.stats.duplicates, count);
+            return;
+        }
+
+        MarketDataMessage msgs[PARSE_BLOCK];
+        bool won = false;
+        for (size_t done = 0; done < count; done += PARSE_BLOCK) {
+            size_t n = count - done < PARSE_BLOCK ? count - done : PARSE_BLOCK;
+            SIMDMessageParser::parse_batch(reinterpret_cast<const char*>(payload) + done * SIMDMessageParser::WIRE_SIZE, n, msgs);
+            for (size_t i = 0; i < n; ++i) {
+                msgs[i].rx_tsc = rx_tsc;
+                won |= arbitrate(id, ch, msgs[i], rx_tsc, sink);
+            }
+        }
+        if (won) bump(ch.stats.line_wins[line]);
+    }
+
+    /* Declare gaps for channels whose oldest held message has waited longer than max_hold
+     * Called by the feed lcore between bursts, so a quiet channel doesn't sit on a gap until the window fills
+     */
+    template<typename Sink>
+    void expire(uint64_t now_tsc, Sink& sink) {
+        for (uint16_t id = 0; id < configs.size(); ++id) {
+            Channel& ch = channels[id];
+            if (ch.held_mask == 0 || now_tsc - ch.held_since < max_hold_cycles) continue;
+            uint64_t rotated = std::rotr(ch.held_mask, static_cast<int>(ch.next_seq % REORDER_WINDOW));
+            skip_to(id, ch, ch.next_seq + static_cast<uint32_t>(std::countr_zero(rotated)), sink);
+            ch.held_since = now_tsc;
+        }
+    }
+
+    size_t channel_count() const { return configs.size(); }
+    const FeedChannelConfig& channel_config(size_t id) const { return configs[id]; }
+    const FeedChannelStats& channel_stats(size_t id) const { return channels[id].stats; }
+    uint64_t other_packet_count() const { return other_packets.load(std::memory_order_relaxed); }
+    uint64_t malformed_packet_count() const { return malformed_packets.load(std::memory_order_relaxed); }
+    uint64_t fragment_count() const { return fragments.load(std::memory_order_relaxed); }
+
+    // "a.b.c.d" to host order, 0 for anything else. For channel tables and the command line
+    static uint32_t parse_ipv4(const char* text);
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <x86intrin.h>
+
+/* Open addressing uint64_t -> uint32_t table for order ids
+ * Capacity is fixed at construction, nothing allocates or rehashes afterwards
+ *
+ * Layout is SwissTable style: one control byte per slot holding 7 bits of the hash (or EMPTY),
+ * and lookups compare a whole group of control bytes against the hash tag with one SIMD compare
+ * Slots are linear probed one by one (not group by group), which is what makes backward-shift deletion possible,
+ * so there are no tombstones and lookups never slow down after lots of cancels
+ */
+class FlatHashIndex {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+private:
+#ifdef __AVX2__
+    static constexpr size_t GROUP_WIDTH = 32;
+#else
+    static constexpr size_t GROUP_WIDTH = 16;
+#endif
+    using GroupMask = uint32_t;
+    static constexpr int8_t EMPTY = static_cast<int8_t>(0x80); // Tags are 0..127 so they never collide with this
+
+    // ctrl has GROUP_WIDTH extra bytes mirroring the first GROUP_WIDTH, so a group load at the end never has to wrap
+    std::vector<int8_t> ctrl;
+    std::vector<uint64_t> keys;     // Keys and values split so probing only touches the keys
+    std::vector<uint32_t> values;
+    size_t mask;
+    size_t max_entries;
+    size_t count = 0;
+
+    // fmix64 from MurmurHash3. Order ids are often sequential, so the raw id would cluster badly
+    static uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+    size_t home(uint64_t h) const { return h & mask; }
+    static int8_t tag(uint64_t h) { return static_cast<int8_t>(h >> 57); } // Top 7 bits, independent of the home slot bits
+
+    // One bit per slot in the group starting at pos whose control byte equals value
+    GroupMask match(size_t pos, int8_t value) const {
+#ifdef __AVX2__
+        __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl.data() + pos));
+        return static_cast<GroupMask>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(value))));
+#else
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl.data() + pos));
+        return static_cast<GroupMask>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value))));
+#endif
+    }
+
+    void set_ctrl(size_t slot, int8_t value) {
+        ctrl[slot] = value;
+        if (slot < GROUP_WIDTH) ctrl[mask + 1 + slot] = value;
+    }
+
+    /* Find the slot holding key, or NOT_FOUND
+     * A key always sits in the unbroken run of full slots starting at its home, so the first EMPTY ends the search
+     */
+    size_t find_slot(uint64_t key) const {
+        uint64_t h = hash(key);
+        int8_t t = tag(h);
+        size_t pos = home(h);
+        while (true) {
+            GroupMask hits = match(pos, t);
+            GroupMask empties = match(pos, EMPTY);
+            if (empties) hits &= (empties & (~empties + 1)) - 1; // Only candidates before the first empty slot count
+            while (hits) {
+                size_t slot = (pos + __builtin_ctz(hits)) & mask;
+                if (keys[slot] == key) return slot;
+                hits &= hits - 1;
+            }
+            if (empties) return NOT_FOUND;
+            pos = (pos + GROUP_WIDTH) & mask;
+        }
+    }
+
+public:
+    /* max_entries is the most keys the table will ever hold
+     * Capacity is the next power of two at or above twice that, so the load factor stays under 50% and probe runs stay short
+     */
+    explicit FlatHashIndex(size_t max_entries) : max_entries(max_entries) {
+        size_t capacity = GROUP_WIDTH * 2;
+        while (capacity < max_entries * 2) capacity <<= 1;
+        mask = capacity - 1;
+        ctrl.assign(capacity + GROUP_WIDTH, EMPTY);
+        keys.resize(capacity);
+        values.resize(capacity);
+    }
+
+    // Value stored for key, NOT_FOUND if absent
+    uint32_t find(uint64_t key) const {
+        size_t slot = find_slot(key);
+        return slot == NOT_FOUND ? NOT_FOUND : values[slot];
+    }
+
+    /* Insert a key that is not already present
+     * Returns false if the table already holds max_entries keys
+     */
+    bool insert(uint64_t key, uint32_t value) {
+        if (count >= max_entries) return false;
+        uint64_t h = hash(key);
+        size_t pos = home(h);
+        GroupMask empties;
+        while (!(empties = match(pos, EMPTY))) pos = (pos + GROUP_WIDTH) & mask;
+        size_t slot = (pos + __builtin_ctz(empties)) & mask;
+        set_ctrl(slot, tag(h));
+        keys[slot] = key;
+        values[slot] = value;
+        ++count;
+        return true;
+    }
+
+    /* Remove key and return its value, NOT_FOUND if it wasn't there
+     * Backward-shift deletion: later entries of the probe run slide into the hole when that brings them
+     * no further from their home, so the run stays unbroken without leaving a tombstone behind
+     */
+    uint32_t erase(uint64_t key) {
+        size_t hole = find_slot(key);
+        if (hole == NOT_FOUND) return NOT_FOUND;
+        uint32_t value = values[hole];
+
+        size_t slot = (hole + 1) & mask;
+        while (ctrl[slot] != EMPTY) {
+            size_t slot_home = home(hash(keys[slot]));
+            if (((slot - slot_home) & mask) >= ((slot - hole) & mask)) { // hole lies within [home, slot)
+                keys[hole] = keys[slot];
+                values[hole] = values[slot];
+                set_ctrl(hole, ctrl[slot]);
+                hole = slot;
+            }
+            slot = (slot + 1) & mask;
+        }
+        set_ctrl(hole, EMPTY);
+        --count;
+        return value;
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return mask + 1; }
+};
@@ -0,0 +1,101 @@
+#include "FrameRecorder.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <time.h>
+#include <rte_mbuf.h>
+#include "DPDKSetup.h"
+#include "TscClock.h"
+
+namespace {
+    constexpr size_t DRAIN_BATCH = 64;
+    constexpr auto IDLE_SLEEP = std::chrono::microseconds(100);
+}
+
+bool FrameRecorder::open(const char* path, uint16_t rx_queues) {
+    if (!writer.open(path)) return false;
+    queues.clear();
+    for (uint16_t q = 0; q < rx_queues; ++q) queues.push_back(std::make_unique<QueueState>());
+    return true;
+}
+
+void FrameRecorder::start() {
+    if (running.load(std::memory_order_relaxed) || queues.empty()) return;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    tsc_base = TscClock::now();
+    ns_base = static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+    running.store(true, std::memory_order_release);
+    thread = std::thread(&FrameRecorder::run, this);
+}
+
+void FrameRecorder::stop() {
+    running.store(false, std::memory_order_release);
+    if (thread.joinable()) thread.join();
+    writer.close();
+}
+
+uint64_t FrameRecorder::dropped_count() const {
+    uint64_t total = 0;
+    for (const auto& queue : queues) total += queue->dropped.load(std::memory_order_relaxed);
+    return total;
+}
+
+// NIC stamps can be a little older than the start sample, so the offset is signed
+uint64_t FrameRecorder::to_wall_ns(uint64_t tsc) const {
+    if (tsc >= tsc_base) return ns_base + TscClock::to_ns(tsc - tsc_base);
+    return ns_base - TscClock::to_ns(tsc_base - tsc);
+}
+
+/* One reference per frame, taken before the handler can free the burst
+ * rte_pktmbuf_refcnt_update covers every segment, so a chained mbuf outlives the handler's free too
+ */
+void FrameRecorder::capture(uint16_t queue, struct rte_mbuf** bufs, uint16_t nb_rx, uint64_t burst_tsc) {
+    QueueState& state = *queues[queue];
+    RecordedFrame staged[DRAIN_BATCH];
+    for (uint16_t done = 0; done < nb_rx;) {
+        uint16_t n = static_cast<uint16_t>(std::min<size_t>(nb_rx - done, DRAIN_BATCH));
+        for (uint16_t i = 0; i < n; ++i) {
+            struct rte_mbuf* mbuf = bufs[done + i];
+            rte_pktmbuf_refcnt_update(mbuf, 1);
+            staged[i] = {mbuf, mbuf_rx_tsc(mbuf, burst_tsc)};
+        }
+        size_t pushed = state.ring.push_bulk(staged, n);
+        for (size_t i = pushed; i < n; ++i) {
+            rte_pktmbuf_free(staged[i].mbuf);
+        }
+        if (pushed < n) {
+            state.dropped.store(state.dropped.load(std::memory_order_relaxed) + (n - pushed), std::memory_order_relaxed);
+        }
+        done += n;
+    }
+}
+
+/* Writer thread: drain every ring, write, drop the reference
+ * Only the first segment's bytes are written, the record still carries the full frame length
+ * Sleeps briefly when there is nothing to write, and on stop keeps going until the rings are empty
+ */
+void FrameRecorder::run() {
+    RecordedFrame frames[DRAIN_BATCH];
+    while (true) {
+        bool stopping = !running.load(std::memory_order_acquire);
+        size_t total = 0;
+        uint64_t ok = 0;
+        for (auto& queue : queues) {
+            size_t n = queue->ring.pop_bulk(frames, DRAIN_BATCH);
+            for (size_t i = 0; i < n; ++i) {
+                struct rte_mbuf* mbuf = frames[i].mbuf;
+                ok += writer.write(rte_pktmbuf_mtod(mbuf, const uint8_t*), rte_pktmbuf_data_len(mbuf), rte_pktmbuf_pkt_len(mbuf),
+                                   to_wall_ns(frames[i].rx_tsc));
+                rte_pktmbuf_free(mbuf);
+            }
+            total += n;
+        }
+        written.fetch_add(ok, std::memory_order_relaxed);
+        write_errors.fetch_add(total - ok, std::memory_order_relaxed);
+        if (total == 0) {
+            if (stopping) break;
+            std::this_thread::sleep_for(IDLE_SLEEP);
+        }
+    }
+}
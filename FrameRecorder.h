@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "PcapFile.h"
+#include "SPSCRing.h"
+
+struct rte_mbuf;
+
+// A frame waiting to be written: the recorder's own reference on the mbuf, and when it arrived (TSC cycles)
+struct RecordedFrame {
+    struct rte_mbuf* mbuf;
+    uint64_t rx_tsc;
+};
+
+/* Records the raw frames the RX cores receive to a nanosecond pcap, which --replay plays back
+ * The RX core only takes a reference on each mbuf and pushes it onto its queue's SPSC ring: no copy, no syscall,
+ * no file I/O. A thread of the recorder's own drains the rings, writes the frames and drops the references
+ * A full ring means the writer fell behind, the frame is left out of the capture (counted) and is still processed
+ * normally. Each ring also bounds how many mbufs a queue can have waiting, dpdk_init sizes the pool for it
+ */
+class FrameRecorder {
+public:
+    static constexpr size_t RING_SIZE = 2048;   // Per RX queue
+
+private:
+    struct alignas(64) QueueState {
+        SPSCRing<RecordedFrame, RING_SIZE> ring;
+        std::atomic<uint64_t> dropped{0};       // Written by the RX core only
+    };
+
+    std::vector<std::unique_ptr<QueueState>> queues;
+    PcapWriter writer;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> write_errors{0};
+    uint64_t tsc_base = 0;      // TSC and wall clock sampled together at start(), to stamp frames in ns since the epoch
+    uint64_t ns_base = 0;
+
+    void run();
+    uint64_t to_wall_ns(uint64_t tsc) const;
+
+public:
+    FrameRecorder() = default;
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+    ~FrameRecorder() { stop(); }
+
+    // Create the capture file, one ring per RX queue. False (and why on stderr) if the file can't be written
+    bool open(const char* path, uint16_t rx_queues);
+
+    // Start the writer thread. Before the RX cores are launched
+    void start();
+
+    // Write out whatever is still queued and close the file. After the RX cores have stopped, while the mbuf pool still exists
+    void stop();
+
+    // RX core for queue only, before the burst is handed on (the handler may free the mbufs). Never blocks
+    void capture(uint16_t queue, struct rte_mbuf** bufs, uint16_t nb_rx, uint64_t burst_tsc);
+
+    uint64_t recorded_count() const { return written.load(std::memory_order_relaxed); }
+    uint64_t error_count() const { return write_errors.load(std::memory_order_relaxed); }
+    uint64_t dropped_count() const;
+};
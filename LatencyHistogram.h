@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/* Fixed-memory latency histogram, log-linear like HdrHistogram
+ * - Values below 2^SUB_BUCKET_BITS get a bucket each (exact)
+ * - Above that every power of two is cut into 2^(SUB_BUCKET_BITS-1) equal buckets, so the error is under 1/64 (~1.6%)
+ * - record() is an index computation and one counter bump, no allocation and no sorting ever
+ * Single writer: counters are bumped with a relaxed load+store, not a locked RMW. Readers may run on any thread
+ * and see a slightly stale but never torn view. Use LatencyRecorder below when several threads record
+ * Cache-line aligned, so histograms side by side (LatencyRecorder's slots) never share a line
+ */
+class alignas(64) LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 7;
+    static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;   // Exact buckets at the bottom
+    static constexpr size_t HALF_BUCKETS = SUB_BUCKETS / 2;                // Buckets per power of two above that
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * HALF_BUCKETS;
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts{};
+    std::atomic<uint64_t> total_count{0};
+    std::atomic<uint64_t> max_value{0};
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+public:
+    static constexpr size_t bucket_for(uint64_t value) {
+        if (value < SUB_BUCKETS) return value;
+        unsigned msb = 63 - std::countl_zero(value);
+        unsigned shift = msb - (SUB_BUCKET_BITS - 1);
+        return SUB_BUCKETS + (msb - SUB_BUCKET_BITS) * HALF_BUCKETS + ((value >> shift) - HALF_BUCKETS);
+    }
+
+    // Largest value that lands in bucket, what percentiles report (same convention as HdrHistogram)
+    static constexpr uint64_t bucket_upper_value(size_t bucket) {
+        if (bucket < SUB_BUCKETS) return bucket;
+        size_t above = bucket - SUB_BUCKETS;
+        unsigned msb = SUB_BUCKET_BITS + static_cast<unsigned>(above / HALF_BUCKETS);
+        unsigned shift = msb - (SUB_BUCKET_BITS - 1);
+        uint64_t low = (HALF_BUCKETS + above % HALF_BUCKETS) << shift;
+        return low + ((uint64_t{1} << shift) - 1);
+    }
+
+    void record(uint64_t value) {
+        bump(counts[bucket_for(value)], 1);
+        bump(total_count, 1);
+        if (value > max_value.load(std::memory_order_relaxed)) {
+            max_value.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    // Add another histogram's counts into this one. Only the owner of this histogram may call it
+    void merge(const LatencyHistogram& other) {
+        for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+            uint64_t c = other.counts[b].load(std::memory_order_relaxed);
+            if (c != 0) bump(counts[b], c);
+        }
+        bump(total_count, other.total_count.load(std::memory_order_relaxed));
+        uint64_t other_max = other.max_value.load(std::memory_order_relaxed);
+        if (other_max > max_value.load(std::memory_order_relaxed)) {
+            max_value.store(other_max, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t count() const { return total_count.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_value.load(std::memory_order_relaxed); }
+    uint64_t bucket(size_t b) const { return counts[b].load(std::memory_order_relaxed); }
+
+    /* Percentile of a plain array of BUCKET_COUNT counts laid out like this histogram, 0 if it is empty
+     * For readers that only have the buckets, e.g. mdp-stat reading them out of shared memory
+     */
+    static uint64_t percentile_of(const uint64_t* bucket_counts, double pct) {
+        uint64_t total = 0;
+        for (size_t b = 0; b < BUCKET_COUNT; ++b) total += bucket_counts[b];
+        if (total == 0) return 0;
+        uint64_t rank = std::clamp<uint64_t>(static_cast<uint64_t>(pct / 100.0 * static_cast<double>(total) + 0.5), 1, total);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+            seen += bucket_counts[b];
+            if (seen >= rank) return bucket_upper_value(b);
+        }
+        return bucket_upper_value(BUCKET_COUNT - 1);
+    }
+
+    /* Value at percentile (0-100), 0 if nothing was recorded
+     * Walks the buckets, which is fine off the hot path. Never reports above the recorded max
+     */
+    uint64_t percentile(double pct) const {
+        uint64_t total = 0;
+        for (const auto& c : counts) total += c.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(pct / 100.0 * static_cast<double>(total) + 0.5);
+        rank = std::clamp<uint64_t>(rank, 1, total);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+            seen += counts[b].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(bucket_upper_value(b), max());
+        }
+        return max();
+    }
+};
+
+/* One LatencyHistogram per recording thread, merged when read
+ * Threads claim a slot the first time they record anywhere in the process and keep it, so the hot path never shares
+ * a counter line with another core. Size it for every thread that records (RX, worker and main thread). A thread past
+ * that gets no histogram, its samples are only counted in unrecorded
+ * Slots are allocated once up front, each on its own cache lines, record() never allocates
+ */
+class LatencyRecorder {
+public:
+    static constexpr size_t DEFAULT_MAX_THREADS = 16;
+
+private:
+    size_t thread_count;
+    std::unique_ptr<LatencyHistogram[]> slots;
+    std::atomic<uint64_t> unrecorded{0};
+
+    static size_t thread_slot() {
+        static std::atomic<size_t> next_slot{0};
+        thread_local size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed);
+        return slot;
+    }
+
+public:
+    explicit LatencyRecorder(size_t max_threads = DEFAULT_MAX_THREADS)
+            : thread_count(max_threads), slots(std::make_unique<LatencyHistogram[]>(max_threads)) {}
+
+    void record(uint64_t value) {
+        size_t slot = thread_slot();
+        if (slot < thread_count) slots[slot].record(value);
+        else unrecorded.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Samples from threads that came after every slot was taken, non-zero means the recorder was sized too small
+    uint64_t unrecorded_count() const { return unrecorded.load(std::memory_order_relaxed); }
+
+    // Sum of every thread's bucket counts into out, BUCKET_COUNT entries. For publishing raw buckets
+    void bucket_counts(uint64_t* out) const {
+        for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; ++b) {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < thread_count; ++i) sum += slots[i].bucket(b);
+            out[b] = sum;
+        }
+    }
+
+    // Merge every thread's histogram into out, which should be a fresh histogram owned by the caller
+    void snapshot(LatencyHistogram& out) const {
+        for (size_t i = 0; i < thread_count; ++i) {
+            out.merge(slots[i]);
+        }
+    }
+};
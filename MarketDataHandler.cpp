@@ -6,70 +6,163 @@
 #include "TCPIPStack.h"
 #include "OrderProtocol.h"
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <numeric>
+#include <string>
 
 extern volatile bool force_quit;
 
 /* Constructor with member initializations
  * Sets up initial state and random number generators for testing
  */
-MarketDataHandler::MarketDataHandler()
-        : start_time(std::chrono::high_resolution_clock::now()),
+MarketDataHandler::MarketDataHandler(const std::vector<InstrumentConfig>& instruments, uint16_t rx_queues, uint16_t worker_count)
+        : books(instruments),
+          start_time(std::chrono::high_resolution_clock::now()),
+          // One slot per recording thread: each RX lcore (or the feed/replay lcore), each worker and the main thread
+          wire_latency(recording_threads(rx_queues, worker_count)),
+          book_update_latency(recording_threads(rx_queues, worker_count)),
+          wire_to_book_latency(recording_threads(rx_queues, worker_count)),
           rng(std::random_device{}()),
           price_dist(1000, 2000),  // Price range $10.00 to $20.00
           quantity_dist(1, 1000),  // Quantity range 1 to 1000
-          buy_sell_dist(0.5)  // 50% chance of buy or sell
+          buy_sell_dist(0.5),  // 50% chance of buy or sell
+          symbol_dist(0, books.size() > 0 ? books.size() - 1 : 0)  // Uniform over the instrument list
 {
-    latencies.reserve(10000);  // Reserve space for 10,000 latency measurements
+    if (worker_count == 0) worker_count = 1;
+    books.assign_shards(worker_count);
+    for (uint16_t w = 0; w < worker_count; ++w) {
+        workers.push_back(std::make_unique<WorkerShard>(w));
+    }
+    // NIC queues first, the main thread's context last (see local_context)
+    for (uint16_t q = 0; q <= rx_queues; ++q) {
+        rx_contexts.push_back(std::make_unique<RxQueueContext>(q, worker_count));
+    }
+}
+
+uint64_t MarketDataHandler::sum_workers(std::atomic<uint64_t> WorkerShard::* counter) const {
+    uint64_t total = 0;
+    for (auto& worker : workers) {
+        total += ((*worker).*counter).load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t MarketDataHandler::sum_rx(std::atomic<uint64_t> RxQueueContext::* counter) const {
+    uint64_t total = 0;
+    for (auto& rx : rx_contexts) {
+        total += ((*rx).*counter).load(std::memory_order_relaxed);
+    }
+    return total;
 }
 
 /* Handle incoming market data messages
- * Calculates latency and adds message to the processing queue
+ * Calculates latency from the message's RX timestamp and adds message to the queue of the worker owning its book
+ * A full queue is handled by its overflow policy, drops are counted there
  */
-void MarketDataHandler::handleMessage(const MarketDataMessage& msg) {
-    auto now = std::chrono::high_resolution_clock::now();
-    auto msg_time = std::chrono::time_point<std::chrono::high_resolution_clock, std::chrono::nanoseconds>(std::chrono::nanoseconds(msg.timestamp));
-    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - msg_time).count();
-    total_latency.fetch_add(latency, std::memory_order_relaxed);
-    message_count.fetch_add(1, std::memory_order_relaxed);
-    message_queue.push(msg);
+void MarketDataHandler::handleMessage(RxQueueContext& rx, const MarketDataMessage& msg) {
+    uint64_t now = TscClock::now();
+    uint64_t latency = now > msg.rx_tsc ? now - msg.rx_tsc : 0;  // A NIC stamp can land a hair after our rdtsc
+    RxQueueContext::bump(rx.total_latency, latency);
+    RxQueueContext::bump(rx.message_count);
+    wire_latency.record(latency);
+    rx.shards[shard_for(msg.symbol)]->push({nullptr, nullptr, msg});
 }
 
-/* Process messages in the queue
- * Updates the order book and executes trading strategy
+/* Process the messages queued for one worker shard
+ * Each RX queue's ring to this shard in turn, copied messages applied as they are and zero-copy views decoded straight
+ * out of their mbuf. Views and copies share the ring, so the order the producer queued them in is the order applied
+ * One burst per ring per pass, so a busy queue can't starve the others
+ * Only this shard's books are touched, so workers never contend on a book or its cache lines
+ * Returns how many messages were applied, 0 means every ring was empty
  */
-void MarketDataHandler::processMessages() {
-    MarketDataMessage msg;
-    while (!force_quit && message_queue.pop(msg)) {
-        auto start = std::chrono::high_resolution_clock::now();
+size_t MarketDataHandler::processMessages(uint16_t shard) {
+    WorkerShard& worker = *workers[shard];
+    ShardMessage msgs[BURST_SIZE];
+    size_t total = 0;
+    for (auto& rx : rx_contexts) {
+        size_t n = rx->shards[shard]->pop_bulk(msgs, BURST_SIZE);
+        if (n == 0) continue;
+        total += n;
+        uint64_t now = TscClock::now();
+        for (size_t i = 0; i < n; ++i) {
+            const ShardMessage& entry = msgs[i];
+            if (!entry.mbuf) {
+                applyMessage(worker, entry.message);
+                continue;
+            }
+            uint64_t rx_tsc = entry.message.rx_tsc;
+            uint64_t latency = now > rx_tsc ? now - rx_tsc : 0;
+            worker.total_latency.fetch_add(latency, std::memory_order_relaxed);
+            worker.message_count.fetch_add(1, std::memory_order_relaxed);
+            wire_latency.record(latency);
+
+            Order order = OrderProtocol::deserialize_order(entry.data, sizeof(Order));
+            applyMessage(worker, toMarketData(order, rx_tsc));
+            rte_pktmbuf_free(entry.mbuf); // Drop this view's reference, the last one returns the mbuf to the pool
+        }
+    }
+    return total;
+}
 
-        order_book.addOrder(msg.order_id, msg.price, msg.quantity, msg.symbol[0] == 'B');
+/* Routes a message to its instrument's book and applies it through the message type jump table
+ * The RX side already picked the shard, so the book found here always belongs to the calling worker
+ * Only when the update moved the top of the book is it published and the shard's strategy called, right here on
+ * the worker, the book has flagged that itself while applying the message
+ */
+void MarketDataHandler::applyMessage(WorkerShard& worker, const MarketDataMessage& msg) {
+    uint64_t start = TscClock::now();
 
-        auto end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
-        latencies.push_back(duration.count());
+    uint32_t instrument = books.lookup(msg.symbol);
+    if (instrument == BookManager::UNKNOWN_INSTRUMENT) {
+        worker.unknown_symbol_messages.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const MessageDispatchEntry& dispatch = MESSAGE_DISPATCH[static_cast<uint8_t>(msg.message_type)];
+    BookEngine& book = books.book(instrument);
+    dispatch.handler(book, msg);
+    worker.message_kind_counts[static_cast<size_t>(dispatch.kind)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t end = TscClock::now();
+    book_update_latency.record(end - start);
+    wire_to_book_latency.record(end > msg.rx_tsc ? end - msg.rx_tsc : 0);
+
+    // Matching mode: the fills this message produced, handed to the strategy and the buffer emptied for the next one
+    if (TradeBuffer* fills = book.trade_buffer(); fills && !fills->empty()) {
+        uint64_t quantity = 0;
+        for (const Trade& trade : fills->view()) quantity += trade.quantity;
+        worker.trades.fetch_add(fills->size(), std::memory_order_relaxed);
+        worker.traded_quantity.fetch_add(quantity, std::memory_order_relaxed);
+        worker.strategy.trades_executed(instrument, fills->view());
+        fills->clear();
+    }
 
-        /* memory_order_relaxed enables atomic operations with no synchronization or ordering guarantees,
-         * We don't need any ordering guarantees here so it speeds perf/makes everything easier to debug
-         */
-        processed_messages.fetch_add(1, std::memory_order_relaxed);
+    if (book.take_top_change()) {
+        TopOfBook top = book.top();
+        books.publish_top(instrument, top, end);
+        worker.top_of_book_changes.fetch_add(1, std::memory_order_relaxed);
+        worker.strategy.top_of_book_changed({instrument, books.symbol(instrument), top, msg.rx_tsc, end});
     }
+
+    /* memory_order_relaxed enables atomic operations with no synchronization or ordering guarantees,
+     * We don't need any ordering guarantees here so it speeds perf/makes everything easier to debug
+     */
+    worker.processed_messages.fetch_add(1, std::memory_order_relaxed);
 }
 
-/* Executes example trading strategy based on current market state
- * This is very simple and should be replaced with actual strategy
+/* Free the mbuf references of any views still queued for one shard, copied messages still queued are dropped
+ * Called by each worker on shutdown (it is the only consumer of its rings) so no mbufs are leaked back to the pool
  */
-void MarketDataHandler::executeTradingStrategy() {
-    uint32_t best_bid = order_book.getBestBid();
-    uint32_t best_ask = order_book.getBestAsk();
-    if (best_bid > 0 && best_ask < std::numeric_limits<uint32_t>::max()) {
-        if (best_ask - best_bid <= 2) {  // Tight spread, potential arbitrage
-            // Simulate placing orders
-            uint64_t new_order_id = last_order_id.fetch_add(2) + 1;
-            Order buy_order{new_order_id, best_bid, 100, true};
-            Order sell_order{new_order_id + 1, best_ask, 100, false};
-            submit_order(buy_order);
-            submit_order(sell_order);
+void MarketDataHandler::releaseViews(uint16_t shard) {
+    ShardMessage msgs[BURST_SIZE];
+    size_t n;
+    for (auto& rx : rx_contexts) {
+        while ((n = rx->shards[shard]->pop_bulk(msgs, BURST_SIZE)) > 0) {
+            for (size_t i = 0; i < n; ++i) {
+                if (msgs[i].mbuf) rte_pktmbuf_free(msgs[i].mbuf);
+            }
         }
     }
 }
@@ -81,78 +174,465 @@ void MarketDataHandler::printStats() {
     auto now = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
 
-    std::cout << "Processed messages: " << processed_messages.load(std::memory_order_relaxed) << std::endl;
+    uint64_t processed = sum_workers(&WorkerShard::processed_messages);
+    std::cout << "Processed messages: " << processed << std::endl;
     if (duration > 0) {
-        std::cout << "Messages per second: " << processed_messages.load(std::memory_order_relaxed) / duration << std::endl;
+        std::cout << "Messages per second: " << processed / duration << std::endl;
     } else {
         std::cout << "Messages per second: N/A (duration too short)" << std::endl;
     }
+    // Per worker counts show how evenly the symbols hash across the shards
+    if (workers.size() > 1) {
+        for (auto& worker : workers) {
+            std::cout << "  Worker " << worker->shard_id << ": "
+                      << worker->processed_messages.load(std::memory_order_relaxed) << " messages" << std::endl;
+        }
+    }
 
-    uint64_t message_count_val = message_count.load(std::memory_order_relaxed);
+    uint64_t message_count_val = sum_rx(&RxQueueContext::message_count) + sum_workers(&WorkerShard::message_count);
     if (message_count_val > 0) {
-        std::cout << "Average latency (ns): " << total_latency.load(std::memory_order_relaxed) / message_count_val << std::endl;
+        uint64_t latency_total = sum_rx(&RxQueueContext::total_latency) + sum_workers(&WorkerShard::total_latency);
+        std::cout << "Average latency (ns): " << TscClock::to_ns(latency_total / message_count_val) << std::endl;
     } else {
         std::cout << "Average latency (ns): N/A (no messages processed)" << std::endl;
     }
 
-    if (!latencies.empty()) {
-        auto max_latency = *std::max_element(latencies.begin(), latencies.end());
-        std::cout << "Max latency (ns): " << max_latency << std::endl;
+    printLatencyStats("Wire-to-queue latency", wire_latency);
+    printLatencyStats("Book update latency", book_update_latency);
+    printLatencyStats("Wire-to-book latency", wire_to_book_latency);
+
+    // Strategy callbacks, one histogram per worker merged here
+    auto strategy_latency = std::make_unique<LatencyHistogram>();
+    uint64_t signals = 0;
+    for (auto& worker : workers) {
+        strategy_latency->merge(worker->strategy.latency());
+        signals += worker->strategy.signals();
+    }
+    printHistogram("Book-to-strategy latency", *strategy_latency);
+    std::cout << "Top-of-book changes: " << sum_workers(&WorkerShard::top_of_book_changes)
+              << ", strategy signals: " << signals << std::endl;
+    if (books.matching()) {
+        uint64_t overflowed = 0;
+        for (size_t i = 0; i < books.size(); ++i) overflowed += books.trades(static_cast<uint32_t>(i)).overflow_count();
+        std::cout << "Matching: " << sum_workers(&WorkerShard::trades) << " trades, "
+                  << sum_workers(&WorkerShard::traded_quantity) << " shares, " << overflowed << " fills past the trade buffer" << std::endl;
+    }
+
+    // Per message type throughput, shows the add/cancel/execute mix we are actually seeing
+    for (size_t kind = 0; kind < static_cast<size_t>(MessageKind::Count); ++kind) {
+        uint64_t count = 0;
+        for (auto& worker : workers) count += worker->message_kind_counts[kind].load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        std::cout << "  " << MESSAGE_KIND_NAMES[kind] << " messages: " << count;
+        if (duration > 0) std::cout << " (" << count / duration << "/s)";
+        std::cout << std::endl;
+    }
+
+    if (feed) {
+        for (size_t id = 0; id < feed->channel_count(); ++id) {
+            const FeedChannelStats& channel = feed->channel_stats(id);
+            std::cout << "Feed channel " << feed->channel_config(id).name
+                      << ": delivered " << channel.delivered.load(std::memory_order_relaxed)
+                      << ", duplicates " << channel.duplicates.load(std::memory_order_relaxed)
+                      << ", reordered " << channel.reordered.load(std::memory_order_relaxed)
+                      << ", gaps " << channel.gaps.load(std::memory_order_relaxed)
+                      << " (" << channel.gap_messages.load(std::memory_order_relaxed) << " messages)"
+                      << ", first on A/B " << channel.line_wins[0].load(std::memory_order_relaxed)
+                      << "/" << channel.line_wins[1].load(std::memory_order_relaxed) << " packets" << std::endl;
+        }
+        std::cout << "Feed packets ignored: " << feed->other_packet_count() << " other, "
+                  << feed->malformed_packet_count() << " malformed, " << feed->fragment_count() << " fragments" << std::endl;
+    }
+
+    if (order_sender) {
+        printHistogram("Tick-to-trade latency", order_sender->tick_to_trade_latency());
+        std::cout << "Order TX: " << order_sender->sent_count() << " sent in " << order_sender->burst_count() << " bursts, "
+                  << order_sender->dropped_count() << " dropped, " << order_sender->failed_count() << " failed, checksums "
+                  << (order_sender->checksum_mode() == ChecksumMode::Offload ? "offloaded" : "in software") << std::endl;
+    }
+
+    std::cout << "Zero-copy messages: " << zero_copy_message_count() << ", copied messages: " << copied_message_count() << std::endl;
+
+    // Per RX queue packet rates show whether RSS is actually spreading the feed
+    for (auto& rx : rx_contexts) {
+        bool local = rx.get() == &local_context();
+        std::string name = local ? std::string("Local") : "RX queue " + std::to_string(rx->queue_id);
+        if (!local) {
+            uint64_t packets = rx->rx_packets.load(std::memory_order_relaxed);
+            std::cout << name << ": " << packets << " packets";
+            if (duration > 0) std::cout << " (" << packets / duration << "/s)";
+            std::cout << " in " << rx->rx_bursts.load(std::memory_order_relaxed) << " bursts" << std::endl;
+        }
+        // Reassembly only has work to do when the network reorders, retransmits or splits orders across segments
+        const TCPReassemblyStats& tcp = rx->tcp_stack.stats();
+        uint64_t out_of_order = tcp.out_of_order_segments.load(std::memory_order_relaxed);
+        uint64_t duplicates = tcp.duplicate_segments.load(std::memory_order_relaxed);
+        uint64_t dropped = tcp.dropped_segments.load(std::memory_order_relaxed);
+        uint64_t oversized = tcp.oversized_messages.load(std::memory_order_relaxed);
+        if (out_of_order + duplicates + dropped + oversized > 0) {
+            std::cout << name << " TCP: " << out_of_order << " out of order, " << duplicates << " duplicate, "
+                      << dropped << " dropped segments, " << oversized << " oversized messages" << std::endl;
+        }
+        uint64_t non_tcp = tcp.non_tcp_packets.load(std::memory_order_relaxed);
+        uint64_t malformed = tcp.malformed_packets.load(std::memory_order_relaxed);
+        if (non_tcp + malformed > 0) {
+            std::cout << name << " ignored: " << non_tcp << " non-TCP, " << malformed << " malformed packets" << std::endl;
+        }
+        for (size_t w = 0; w < rx->shards.size(); ++w) {
+            std::string ring = workers.size() > 1 ? name + " -> worker " + std::to_string(w) : name;
+            printQueueStats((ring + " queue").c_str(), *rx->shards[w]);
+        }
+    }
+
+    uint64_t unknown = sum_workers(&WorkerShard::unknown_symbol_messages);
+    if (unknown > 0) {
+        std::cout << "Messages for unknown symbols: " << unknown << std::endl;
+    }
+
+    // Only instruments that have something on the book, we may carry thousands
+    // Read from the published tops, the books themselves belong to the workers
+    for (uint32_t i = 0; i < books.size(); ++i) {
+        BboQuote quote = books.top_of_book(i);
+        if (quote.bid_price == 0 && quote.ask_price == std::numeric_limits<uint32_t>::max()) continue;
+        std::cout << BookManager::unpack_symbol(books.symbol(i)) << " Best Bid: " << quote.bid_price << " x " << quote.bid_quantity
+                  << " Best Ask: " << quote.ask_price << " x " << quote.ask_quantity
+                  << " (" << quote.sequence << " updates)" << std::endl;
+    }
+}
+
+/* Percentiles of one latency recorder, all threads merged
+ * Recorded in TSC cycles, converted here. The merge target is ~30KB so it goes on the heap, this is only called from printStats
+ */
+void MarketDataHandler::printLatencyStats(const char* name, const LatencyRecorder& recorder) {
+    auto merged = std::make_unique<LatencyHistogram>();
+    recorder.snapshot(*merged);
+    printHistogram(name, *merged);
+    if (recorder.unrecorded_count() > 0) {
+        std::cout << "  " << recorder.unrecorded_count() << " samples from threads past the recorder's slots" << std::endl;
+    }
+}
+
+void MarketDataHandler::printHistogram(const char* name, const LatencyHistogram& histogram) {
+    if (histogram.count() == 0) {
+        std::cout << name << " (ns): N/A (no samples)" << std::endl;
+        return;
+    }
+    std::cout << name << " (ns): p50 " << TscClock::to_ns(histogram.percentile(50.0))
+              << " p90 " << TscClock::to_ns(histogram.percentile(90.0))
+              << " p99 " << TscClock::to_ns(histogram.percentile(99.0))
+              << " p99.9 " << TscClock::to_ns(histogram.percentile(99.9))
+              << " p99.99 " << TscClock::to_ns(histogram.percentile(99.99))
+              << " max " << TscClock::to_ns(histogram.max())
+              << " (" << histogram.count() << " samples)" << std::endl;
+}
+
+/* Occupancy and overflow counters for one RX->worker queue
+ * High water is against the primary ring, anything above 100% went to the overflow ring
+ */
+template<typename Queue>
+void MarketDataHandler::printQueueStats(const char* name, const Queue& queue) {
+    const QueueOverflowStats& stats = queue.stats();
+    size_t high_water = stats.high_water.load(std::memory_order_relaxed);
+    std::cout << name << " (" << overflow_policy_name(queue.get_policy()) << "): high water " << high_water
+              << "/" << queue.capacity() << " (" << high_water * 100 / queue.capacity() << "%)";
+    switch (queue.get_policy()) {
+        case OverflowPolicy::SpinRetry:
+            std::cout << ", spin retries " << stats.spin_retries.load(std::memory_order_relaxed);
+            break;
+        case OverflowPolicy::SpillToOverflow:
+            std::cout << ", spilled " << stats.spilled.load(std::memory_order_relaxed);
+            break;
+        case OverflowPolicy::DropAndCount:
+            break;
+    }
+    std::cout << ", dropped " << stats.dropped.load(std::memory_order_relaxed) << std::endl;
+}
+
+template<typename Queue>
+void MarketDataHandler::fillQueueStats(StatsQueue& out, const char* name, const Queue& queue) {
+    const QueueOverflowStats& stats = queue.stats();
+    std::snprintf(out.name, sizeof(out.name), "%s", name);
+    out.depth = queue.size();
+    out.capacity = queue.capacity();
+    out.high_water = stats.high_water.load(std::memory_order_relaxed);
+    out.dropped = stats.dropped.load(std::memory_order_relaxed);
+    out.spilled = stats.spilled.load(std::memory_order_relaxed);
+    out.spin_retries = stats.spin_retries.load(std::memory_order_relaxed);
+}
+
+/* Publish live stats to shared memory for mdp-stat, at most every STATS_PUBLISH_INTERVAL_MS
+ * Worker shard 0 only (the seqlock has a single writer). Other shards' counters are summed, their BBO read from the published tops. Plain stores into a pre-faulted mapping, no syscalls or locks.
+ * Summing the latency buckets is the expensive part, a few tens of us per publish
+ */
+void MarketDataHandler::publishStats(uint64_t now_tsc) {
+    if (!stats_publisher || now_tsc < next_stats_publish_tsc) return;
+    next_stats_publish_tsc = now_tsc + TscClock::to_cycles(STATS_PUBLISH_INTERVAL_MS * 1000000);
+
+    StatsData& data = stats_publisher->begin();
+    data.publish_tsc = now_tsc;
+    data.tsc_hz = TscClock::hz();
+    data.processed_messages = sum_workers(&WorkerShard::processed_messages);
+    data.zero_copy_messages = zero_copy_message_count();
+    data.copied_messages = copied_message_count();
+    data.unknown_symbol_messages = sum_workers(&WorkerShard::unknown_symbol_messages);
+
+    static_assert(static_cast<size_t>(MessageKind::Count) <= STATS_MAX_MESSAGE_KINDS, "Grow STATS_MAX_MESSAGE_KINDS");
+    data.message_kind_count = static_cast<uint32_t>(MessageKind::Count);
+    for (size_t kind = 0; kind < static_cast<size_t>(MessageKind::Count); ++kind) {
+        std::strncpy(data.message_kind_names[kind], MESSAGE_KIND_NAMES[kind], STATS_NAME_LEN - 1);
+        uint64_t count = 0;
+        for (auto& worker : workers) count += worker->message_kind_counts[kind].load(std::memory_order_relaxed);
+        data.message_kind_counts[kind] = count;
+    }
+
+    /* One ring per RX context and worker, named rxN.wM, the main thread's local.wM
+     * Rings past STATS_MAX_QUEUES are left out, printStats still shows them all
+     */
+    uint32_t queues = 0;
+    uint32_t rx_queues = 0;
+    for (auto& rx : rx_contexts) {
+        bool local = rx.get() == &local_context();
+        for (size_t w = 0; w < rx->shards.size() && queues < STATS_MAX_QUEUES; ++w) {
+            char name[STATS_NAME_LEN];
+            if (local) std::snprintf(name, sizeof(name), "local.w%zu", w);
+            else std::snprintf(name, sizeof(name), "rx%u.w%zu", rx->queue_id, w);
+            fillQueueStats(data.queues[queues++], name, *rx->shards[w]);
+        }
+        if (!local && rx_queues < STATS_MAX_RX_QUEUES) {
+            data.rx_queue_packets[rx_queues++] = rx->rx_packets.load(std::memory_order_relaxed);
+        }
+    }
+    data.queue_count = queues;
+    data.rx_queue_count = rx_queues;
+
+    const std::pair<const char*, const LatencyRecorder*> series[] = {
+            {"wire_to_queue", &wire_latency},
+            {"book_update", &book_update_latency},
+            {"wire_to_book", &wire_to_book_latency},
+    };
+    data.latency_series_count = std::size(series);
+    for (size_t i = 0; i < std::size(series); ++i) {
+        std::strncpy(data.latency_names[i], series[i].first, STATS_NAME_LEN - 1);
+        series[i].second->bucket_counts(data.latency_buckets[i]);
+    }
 
-        std::sort(latencies.begin(), latencies.end());
-        size_t percentile_99_index = latencies.size() * 0.99;
-        std::cout << "99th percentile latency (ns): " << latencies[percentile_99_index] << std::endl;
+    uint32_t count = std::min<uint32_t>(books.size(), STATS_MAX_INSTRUMENTS);
+    data.instrument_count = count;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t symbol = books.symbol(i);
+        std::memcpy(data.instruments[i].symbol, &symbol, sizeof(data.instruments[i].symbol));
+        BboQuote quote = books.top_of_book(i);
+        data.instruments[i].best_bid = quote.bid_price;
+        data.instruments[i].best_ask = quote.ask_price;
     }
 
-    std::cout << "Best Bid: " << order_book.getBestBid() << std::endl;
-    std::cout << "Best Ask: " << order_book.getBestAsk() << std::endl;
+    stats_publisher->commit();
+}
+
+/* Process a network packet injected from the main thread (simulation, our own submitted orders)
+ * Goes through the main thread's own context so it never shares a ring with an RX lcore
+ */
+void MarketDataHandler::process_network_packet(const uint8_t* data, size_t len, uint64_t rx_tsc) {
+    processPacket(local_context(), data, len, rx_tsc);
 }
 
 /* Process a network packet
  * Extracts orders from TCP packets and adds them to the order book
+ * rx_tsc is when the packet arrived, every order in it carries that stamp
  */
-void MarketDataHandler::process_network_packet(const uint8_t* data, size_t len) {
-    tcp_stack.process_packet(data, len);
-    // Check for complete orders and process them
-    while (!force_quit) {
-        std::vector<uint8_t> order_data = tcp_stack.get_next_message();
-        if (order_data.empty()) break;
+void MarketDataHandler::processPacket(RxQueueContext& rx, const uint8_t* data, size_t len, uint64_t rx_tsc) {
+    rx.tcp_stack.process_packet(data, len);
+    drainMessages(rx, rx_tsc);
+}
+
+/* Queue every order the TCP stack has reassembled so far
+ * Orders are the only message on this stream, so the copy buffer is one Order. Anything longer is skipped by the stack
+ */
+void MarketDataHandler::drainMessages(RxQueueContext& rx, uint64_t rx_tsc) {
+    uint8_t message[sizeof(Order)];
+    size_t len;
+    while (!force_quit && (len = rx.tcp_stack.get_next_message(message, sizeof(message))) > 0) {
+        if (len < sizeof(Order)) continue;
+        Order order = OrderProtocol::deserialize_order(message, len);
+        RxQueueContext::bump(rx.copied_messages);
+        handleMessage(rx, toMarketData(order, rx_tsc));
+    }
+}
+
+/* Zero-copy receive of one burst
+ * The orders are left in their mbufs and handed to the owning worker as views, one mbuf reference per view
+ * Only segments that continue their stream on a message boundary can be used in place. Out of order segments and
+ * orders split across segments are reassembled by the TCP stack and queued as copies
+ * Views for the whole burst are staged per shard and pushed with push_bulk, so each worker sees one index update per batch
+ * Copies go to the same rings as they come out of reassembly, so staged views are flushed first and a flow's messages
+ * reach the worker in stream order
+ * No vector, no queue node, no copy of the payload on this core. Only the symbol is read, to pick the shard
+ */
+void MarketDataHandler::receive_burst(uint16_t queue, struct rte_mbuf** bufs, uint16_t nb_rx, uint64_t burst_tsc) {
+    RxQueueContext& rx = *rx_contexts[queue];
+    RxQueueContext::bump(rx.rx_packets, nb_rx);
+    RxQueueContext::bump(rx.rx_bursts);
+
+    if (!zero_copy_rx) {
+        for (uint16_t i = 0; i < nb_rx; i++) {
+            processPacket(rx, rte_pktmbuf_mtod(bufs[i], const uint8_t*), rte_pktmbuf_data_len(bufs[i]),
+                                   mbuf_rx_tsc(bufs[i], burst_tsc));
+            rte_pktmbuf_free(bufs[i]);
+        }
+        return;
+    }
 
-        Order order = OrderProtocol::deserialize_order(order_data.data(), order_data.size());
-        MarketDataMessage msg;
-        msg.order_id = order.order_id;
-        msg.price = order.price;
-        msg.quantity = order.quantity;
-        msg.symbol[0] = order.is_buy ? 'B' : 'S';
-        msg.timestamp = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    /* Views are staged in shard order so each shard's batch can go with one push_bulk
+     * Per shard capacity shrinks as workers grow, a full shard is flushed early
+     */
+    constexpr size_t STAGING_SIZE = 256;
+    const size_t shard_count = rx.shards.size();
+    const size_t per_shard = std::max<size_t>(STAGING_SIZE / shard_count, 1);
+    ShardMessage staged[STAGING_SIZE];
+    size_t staged_count[STAGING_SIZE] = {};
+
+    // Push one shard's staged views, any the queue drops give their mbuf reference back
+    auto flush = [&](size_t shard) {
+        ShardMessage* batch = staged + shard * per_shard;
+        size_t pushed = rx.shards[shard]->push_bulk(batch, staged_count[shard]);
+        for (size_t i = pushed; i < staged_count[shard]; ++i) {
+            rte_pktmbuf_free(batch[i].mbuf);
+        }
+        RxQueueContext::bump(rx.zero_copy_messages, pushed);
+        staged_count[shard] = 0;
+    };
+
+    for (uint16_t i = 0; i < nb_rx; i++) {
+        struct rte_mbuf* mbuf = bufs[i];
+        const uint8_t* payload = nullptr;
+        size_t payload_len = rx.tcp_stack.locate_payload(rte_pktmbuf_mtod(mbuf, const uint8_t*), rte_pktmbuf_data_len(mbuf), &payload);
+        uint64_t rx_tsc = mbuf_rx_tsc(mbuf, burst_tsc);
+
+        // payload holds whole length-prefixed frames, count the orders first so the references go in one atomic op
+        size_t count = 0;
+        for (size_t offset = 0; offset < payload_len; offset += FRAME_HEADER_LEN + frame_payload_length(payload + offset)) {
+            if (frame_payload_length(payload + offset) == sizeof(Order)) ++count;
+        }
+        if (count > 0) {
+            rte_mbuf_refcnt_update(mbuf, static_cast<int16_t>(count)); // One reference per view
+            for (size_t offset = 0; offset < payload_len; offset += FRAME_HEADER_LEN + frame_payload_length(payload + offset)) {
+                if (frame_payload_length(payload + offset) != sizeof(Order)) continue;
+                const uint8_t* order = payload + offset + FRAME_HEADER_LEN;
+                size_t shard = shard_for(reinterpret_cast<const char*>(order + offsetof(Order, symbol)));
+                if (staged_count[shard] == per_shard) flush(shard);
+                ShardMessage& view = staged[shard * per_shard + staged_count[shard]++];
+                view.mbuf = mbuf;
+                view.data = order;
+                view.message.rx_tsc = rx_tsc;
+            }
+        }
+        rte_pktmbuf_free(mbuf); // RX core's own reference
+        if (rx.tcp_stack.has_ready_message()) {
+            for (size_t shard = 0; shard < shard_count; ++shard) {
+                if (staged_count[shard] > 0) flush(shard);
+            }
+            drainMessages(rx, rx_tsc);
+        }
+    }
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        if (staged_count[shard] > 0) flush(shard);
+    }
+}
+
+/* Switch the first RX context over to the UDP multicast feed
+ * Called before the lcores are launched
+ */
+void MarketDataHandler::enable_feed(const std::vector<FeedChannelConfig>& channels, uint64_t max_hold_ns) {
+    feed = std::make_unique<FeedHandler>(channels, TscClock::to_cycles(max_hold_ns));
+}
 
-        handleMessage(msg);
+/* Feed receive of one burst, from either line
+ * Headers are walked in place, only the messages that win arbitration are decoded and queued
+ */
+void MarketDataHandler::receive_feed_burst(struct rte_mbuf** bufs, uint16_t nb_rx, uint64_t burst_tsc) {
+    RxQueueContext& rx = *rx_contexts[0];
+    RxQueueContext::bump(rx.rx_packets, nb_rx);
+    RxQueueContext::bump(rx.rx_bursts);
+
+    FeedSink sink{*this, rx};
+    for (uint16_t i = 0; i < nb_rx; i++) {
+        feed->process_packet(rte_pktmbuf_mtod(bufs[i], const uint8_t*), rte_pktmbuf_data_len(bufs[i]),
+                             mbuf_rx_tsc(bufs[i], burst_tsc), sink);
+        rte_pktmbuf_free(bufs[i]);
     }
 }
 
+void MarketDataHandler::expire_feed(uint64_t now_tsc) {
+    FeedSink sink{*this, *rx_contexts[0]};
+    feed->expire(now_tsc, sink);
+}
+
+// Build the market data message for an order received over the order stream
+// The order stream carries no exchange time, so timestamp stays zero and only rx_tsc is set
+MarketDataMessage MarketDataHandler::toMarketData(const Order& order, uint64_t rx_tsc) {
+    MarketDataMessage msg{};
+    msg.order_id = order.order_id;
+    msg.price = order.price;
+    msg.quantity = order.quantity;
+    msg.message_type = 'A';
+    std::memcpy(msg.symbol, order.symbol, sizeof(msg.symbol));
+    msg.side = order.is_buy ? 'B' : 'S';
+    msg.rx_tsc = rx_tsc;
+    return msg;
+}
+
 // Simulate semi-realistic network delay (number is random i'm not sure what its like in actual prod but i'd imagine its not this large)
 void MarketDataHandler::simulate_network_delay() {
     rte_delay_us(50);  // 50 μs network delay
 }
 
+/* Order entry on a TX queue owned by the main thread (the only caller of submit_order)
+ * Called before the lcores are launched
+ */
+void MarketDataHandler::enable_order_tx(struct rte_mempool* pool, uint16_t port, uint16_t queue, const LinkConfig& link,
+                                        uint32_t dest_ip, uint16_t dest_port) {
+    order_sender = std::make_unique<OrderSender>(pool, port, queue, link, dest_ip, dest_port);
+}
+
+void MarketDataHandler::flush_orders() {
+    if (order_sender) order_sender->flush();
+}
+
 /* Submit an order to the network
- * Creates a TCP packet for the order and processes it
+ * With order entry enabled the order is framed into an mbuf and staged for the next tx_burst (flush_orders sends it now)
+ * Without it, the packet is looped back through our own receive path after a simulated network delay
  */
-void MarketDataHandler::submit_order(const Order& order) {
+void MarketDataHandler::submit_order(const Order& order, uint64_t signal_tsc) {
+    if (order_sender) {
+        order_sender->send(order, signal_tsc);
+        return;
+    }
+
     uint32_t dest_ip = 0x0A000001;  // Example: 10.0.0.1
     uint16_t dest_port = 12345;     // Example port
 
-    std::vector<uint8_t> order_data = OrderProtocol::serialize_order(order);
-    std::vector<uint8_t> packet = tcp_stack.create_packet(dest_ip, dest_port, order_data.data(), order_data.size());
+    uint8_t packet[TCPIPStack::PAYLOAD_OFFSET + OrderProtocol::WIRE_SIZE];
+    size_t len = loopbackFrame(order, dest_ip, dest_port, packet);
 
     simulate_network_delay();
 
-    process_network_packet(packet.data(), packet.size());
+    process_network_packet(packet, len, TscClock::now());
 
     std::cout << "Order submitted: ID " << order.order_id << ", Price " << order.price
               << ", Quantity " << order.quantity << ", Is Buy " << order.is_buy << std::endl;
 }
 
+/* Frame an order the way a remote sender would, for the loopback paths
+ * Serialized in place behind the headers, nothing allocated. Checksums in software, like a frame off the wire
+ */
+size_t MarketDataHandler::loopbackFrame(const Order& order, uint32_t dest_ip, uint16_t dest_port, std::span<uint8_t> packet) {
+    TCPIPStack& stack = local_context().tcp_stack;
+    TCPIPStack::FrameTemplate tmpl;
+    if (packet.size() < TCPIPStack::PAYLOAD_OFFSET || !stack.build_template(dest_ip, dest_port, tmpl)) return 0;
+    size_t len = OrderProtocol::serialize_order(order, packet.subspan(TCPIPStack::PAYLOAD_OFFSET));
+    return len > 0 ? stack.seal_frame(tmpl, packet.data(), len, ChecksumMode::Software) : 0;
+}
+
 /* Generate a random order
  * Used for simulating market activity
  */
@@ -162,6 +642,8 @@ Order MarketDataHandler::generate_random_order() {
     order.price = price_dist(rng);
     order.quantity = quantity_dist(rng);
     order.is_buy = buy_sell_dist(rng);
+    uint64_t symbol = books.symbol(symbol_dist(rng));
+    std::memcpy(order.symbol, &symbol, sizeof(order.symbol));
     return order;
 }
 
@@ -176,10 +658,10 @@ void MarketDataHandler::simulate_market_activity(int num_orders) {
     for (int i = 0; i < num_orders; ++i) {
         Order order = generate_random_order();
 
-        std::vector<uint8_t> order_data = OrderProtocol::serialize_order(order);
-        std::vector<uint8_t> packet = tcp_stack.create_packet(0x0A000001, 12345, order_data.data(), order_data.size());
+        uint8_t packet[TCPIPStack::PAYLOAD_OFFSET + OrderProtocol::WIRE_SIZE];
+        size_t len = loopbackFrame(order, 0x0A000001, 12345, packet);
 
-        process_network_packet(packet.data(), packet.size());
+        process_network_packet(packet, len, TscClock::now());
 
         //delay to avoid overwhelming system
         //std::this_thread::sleep_for(std::chrono::microseconds(100));
@@ -194,37 +676,93 @@ void MarketDataHandler::simulate_market_activity(int num_orders) {
 }
 
 /* RX core function
- * Receives packets and handles market data messages
+ * Polls one RX queue and hands its packets to that queue's rings. One instance per queue, each on its own lcore
  */
 int lcore_rx(void *arg) {
-    MarketDataHandler* handler = static_cast<MarketDataHandler*>(arg);
+    RxLcoreArgs* args = static_cast<RxLcoreArgs*>(arg);
+    MarketDataHandler* handler = args->handler;
+    const uint16_t port = args->port;
+    const uint16_t queue = args->queue;
     struct rte_mbuf *bufs[BURST_SIZE];
 
     while (!force_quit) {
-        const uint16_t nb_rx = rte_eth_rx_burst(0, 0, bufs, BURST_SIZE);
+        const uint16_t nb_rx = rte_eth_rx_burst(port, queue, bufs, BURST_SIZE);
+        if (nb_rx == 0) continue;
+
+        // One software timestamp per burst, used for any mbuf the NIC didn't stamp
+        uint64_t burst_tsc = TscClock::now();
+        // Recording only queues a reference per frame, the file is written by the recorder's thread
+        if (args->recorder) args->recorder->capture(queue, bufs, nb_rx, burst_tsc);
+        // Process as network packets (for order submission). Takes ownership of the mbufs
+        handler->receive_burst(queue, bufs, nb_rx, burst_tsc);
+    }
 
-        for (uint16_t i = 0; i < nb_rx; i++) {
-            char* data = rte_pktmbuf_mtod(bufs[i], char*);
-            uint16_t data_len = rte_pktmbuf_data_len(bufs[i]);
+    return 0;
+}
 
-            // Process as network packet (for order submission)
-            handler->process_network_packet(reinterpret_cast<uint8_t*>(data), data_len);
+/* Feed core function
+ * Polls both lines of the multicast feed on one lcore, so arbitration state never leaves it
+ * A and B are polled alternately, a line that is behind costs one empty rx_burst per pass
+ */
+int lcore_feed(void *arg) {
+    FeedLcoreArgs* args = static_cast<FeedLcoreArgs*>(arg);
+    MarketDataHandler* handler = args->handler;
+    struct rte_mbuf *bufs[BURST_SIZE];
 
-            rte_pktmbuf_free(bufs[i]);
+    while (!force_quit) {
+        for (uint16_t line = 0; line < args->port_count; ++line) {
+            const uint16_t nb_rx = rte_eth_rx_burst(args->ports[line], 0, bufs, BURST_SIZE);
+            if (nb_rx == 0) continue;
+            uint64_t burst_tsc = TscClock::now();
+            if (args->recorder) args->recorder->capture(0, bufs, nb_rx, burst_tsc);
+            handler->receive_feed_burst(bufs, nb_rx, burst_tsc);
         }
+        handler->expire_feed(TscClock::now());
     }
 
     return 0;
 }
 
+/* Replay core function, runs instead of lcore_rx/lcore_feed with --replay
+ * Feeds the preloaded capture into the same entry points the NIC bursts go to, stamped when they are injected
+ * In feed mode the reorder window keeps being expired after the last frame, so held messages still come out
+ */
+int lcore_replay(void *arg) {
+    ReplayLcoreArgs* args = static_cast<ReplayLcoreArgs*>(arg);
+    MarketDataHandler* handler = args->handler;
+    PcapReplay* replay = args->replay;
+    struct rte_mbuf *bufs[BURST_SIZE];
+
+    replay->start(TscClock::now());
+    while (!force_quit && !replay->exhausted()) {
+        uint64_t now = TscClock::now();
+        const uint16_t n = replay->next_burst(bufs, BURST_SIZE, now);
+        if (n > 0) {
+            if (args->feed) handler->receive_feed_burst(bufs, n, now);
+            else handler->receive_burst(0, bufs, n, now);
+        }
+        if (args->feed) handler->expire_feed(now);
+    }
+    replay->finish(TscClock::now());
+
+    while (args->feed && !force_quit) {
+        handler->expire_feed(TscClock::now());
+    }
+    return 0;
+}
+
 /* Worker core function
- * Processes market data messages and executes trading strategy
+ * Processes the market data messages for one shard's books. One instance per shard, each on its own lcore
+ * Shard 0 also publishes the live stats
  */
 int lcore_worker(void *arg) {
-    MarketDataHandler* handler = static_cast<MarketDataHandler*>(arg);
+    WorkerLcoreArgs* args = static_cast<WorkerLcoreArgs*>(arg);
+    MarketDataHandler* handler = args->handler;
+    const uint16_t shard = args->shard;
 
     while (!force_quit) {
-        handler->processMessages();
+        handler->processMessages(shard);
+        if (shard == 0) handler->publishStats(TscClock::now());
 
         /* Optional delay to reduce CPU load and power consumption
          * Adjust this value based on performance testing
@@ -233,5 +771,6 @@ int lcore_worker(void *arg) {
         //rte_delay_us(100);
     }
 
+    handler->releaseViews(shard);
     return 0;
 }
@@ -1,46 +1,220 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <memory>
 #include <random>
 #include <thread>
-#include "OrderBook.h"
-#include "LockFreeRingBuffer.h"
+#include <vector>
+#include "BackpressureQueue.h"
+#include "BookManager.h"
+#include "FeedHandler.h"
+#include "FrameRecorder.h"
+#include "LatencyHistogram.h"
+#include "MessageDispatch.h"
 #include "SIMDMessageParser.h"
+#include "StatsBlock.h"
 #include "TCPIPStack.h"
+#include "TradingStrategy.h"
+#include "TscClock.h"
 #include "OrderProtocol.h"
+#include "OrderSender.h"
+#include "PcapReplay.h"
+
+struct rte_mbuf;
+struct rte_mempool;
+
+/* One message on its way to a worker shard: an order still sitting in the mbuf it arrived in (zero-copy receive),
+ * or a message copied out of the TCP stack's reassembly ring
+ * Both kinds go through the same ring, so the worker applies a flow's messages in the order they came off the wire
+ * A view holds one reference on the mbuf, the worker drops it with rte_pktmbuf_free once the message is applied
+ */
+struct ShardMessage {
+    struct rte_mbuf* mbuf;      // View: the mbuf holding the order. nullptr for a copied message
+    const uint8_t* data;        // View: points at a serialized Order inside the mbuf data room
+    MarketDataMessage message;  // Copy: the message itself. View: only rx_tsc is set
+};
+static_assert(sizeof(ShardMessage) == 64, "One ring slot per cache line");
+
+// Ring from one producer (an RX queue or the main thread) to one worker shard
+using ShardQueue = BackpressureQueue<ShardMessage, 1024>;
+
+/* Everything one RX queue's lcore owns
+ * Shared-nothing: RSS keeps a flow on one queue, so each queue gets its own TCP stack and its own ring to every
+ * worker shard, and every ring keeps exactly one producer and one consumer. Counters are written by the RX lcore only
+ */
+struct RxQueueContext {
+    uint16_t queue_id;
+    TCPIPStack tcp_stack;
+    std::vector<std::unique_ptr<ShardQueue>> shards;  // Indexed by worker shard
+    alignas(64) std::atomic<uint64_t> rx_packets{0};
+    std::atomic<uint64_t> rx_bursts{0};
+    std::atomic<uint64_t> zero_copy_messages{0};
+    std::atomic<uint64_t> copied_messages{0};
+    std::atomic<uint64_t> total_latency{0};  // TSC cycles, copy path
+    std::atomic<uint64_t> message_count{0};
+
+    RxQueueContext(uint16_t id, uint16_t workers) : queue_id(id) {
+        for (uint16_t w = 0; w < workers; ++w) shards.push_back(std::make_unique<ShardQueue>());
+    }
+
+    // Single writer, so a plain load and store instead of a locked read-modify-write
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+// Strategy run on every top-of-book change, picked at compile time like BookEngine. Any TradingStrategy<Derived>
+using Strategy = SpreadStrategy;
+
+/* Per worker state, the worker owns the books BookManager assigns to its shard
+ * Counters are written by that worker only and summed when read, so workers never share a line
+ */
+struct WorkerShard {
+    uint16_t shard_id;
+    alignas(64) std::atomic<uint64_t> processed_messages{0};
+    std::atomic<uint64_t> unknown_symbol_messages{0};
+    std::atomic<uint64_t> top_of_book_changes{0};
+    std::atomic<uint64_t> trades{0};            // Matching mode only
+    std::atomic<uint64_t> traded_quantity{0};
+    std::atomic<uint64_t> total_latency{0};  // TSC cycles, zero-copy path
+    std::atomic<uint64_t> message_count{0};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(MessageKind::Count)> message_kind_counts{};
+    Strategy strategy;  // This shard's instance, sees only the books the shard owns
+
+    explicit WorkerShard(uint16_t id) : shard_id(id) {}
+};
+
+// What lcore_rx needs to know about the queue it polls. recorder is set with --record
+struct RxLcoreArgs {
+    class MarketDataHandler* handler;
+    uint16_t port;
+    uint16_t queue;
+    FrameRecorder* recorder;
+};
+
+// The ports lcore_feed polls, A line then B line. One port if both lines arrive on it. Records as queue 0
+struct FeedLcoreArgs {
+    class MarketDataHandler* handler;
+    uint16_t ports[2];
+    uint16_t port_count;
+    FrameRecorder* recorder;
+};
+
+// Which shard an lcore_worker instance runs. Shard 0 also publishes the live stats
+struct WorkerLcoreArgs {
+    class MarketDataHandler* handler;
+    uint16_t shard;
+};
 
 class MarketDataHandler {
+public:
+    static constexpr uint64_t STATS_PUBLISH_INTERVAL_MS = 250;
+
 private:
-    LockFreeRingBuffer<MarketDataMessage, 1024> message_queue;
-    OrderBook order_book;
-    std::atomic<uint64_t> processed_messages{0};
+    /* One context per NIC RX queue, plus a last one for packets injected from the main thread
+     * (simulate_market_activity, submit_order), so the main thread is a producer of its own rings too
+     */
+    std::vector<std::unique_ptr<RxQueueContext>> rx_contexts;
+    std::vector<std::unique_ptr<WorkerShard>> workers;
+    bool zero_copy_rx = true;
+    BookManager books;
     std::chrono::high_resolution_clock::time_point start_time;
-    std::atomic<uint64_t> total_latency{0};
-    std::atomic<uint64_t> message_count{0};
-    std::vector<uint64_t> latencies;
-    TCPIPStack tcp_stack;
+    // All in TSC cycles, converted to ns when printed
+    LatencyRecorder wire_latency;         // RX timestamp to queue (copy path) or dequeue (zero-copy path)
+    LatencyRecorder book_update_latency;  // Lookup + dispatch + book update per message
+    LatencyRecorder wire_to_book_latency; // RX timestamp to book updated
     std::atomic<uint64_t> last_order_id{0};
 
 
+    /* UDP multicast feed, when enabled. Owned by the feed lcore, which produces into the first RX context
+     * (in feed mode there is one, and no lcore_rx runs)
+     */
+    std::unique_ptr<FeedHandler> feed;
+    // Arbitrated messages go to the worker rings like any other copied message
+    struct FeedSink {
+        MarketDataHandler& handler;
+        RxQueueContext& rx;
+        void on_message(const MarketDataMessage& msg) { handler.handleMessage(rx, msg); }
+        // Counted per channel by FeedHandler. Recovery (snapshot or retransmission request) would start here
+        void on_gap(uint16_t, uint32_t, uint32_t) {}
+    };
+
+    // Order entry TX path, when enabled. Used from the main thread only
+    std::unique_ptr<OrderSender> order_sender;
+
+    StatsPublisher* stats_publisher = nullptr;
+    uint64_t next_stats_publish_tsc = 0;
+
     std::mt19937 rng;
     std::uniform_int_distribution<> price_dist;
     std::uniform_int_distribution<> quantity_dist;
     std::bernoulli_distribution buy_sell_dist;
+    std::uniform_int_distribution<uint32_t> symbol_dist;
 
-    void executeTradingStrategy();
     void simulate_network_delay();
+    void applyMessage(WorkerShard& worker, const MarketDataMessage& msg);
+    void processPacket(RxQueueContext& rx, const uint8_t* data, size_t len, uint64_t rx_tsc);
+    void drainMessages(RxQueueContext& rx, uint64_t rx_tsc);
+    RxQueueContext& local_context() { return *rx_contexts.back(); }
+    // Shard owning a wire symbol's book. Unknown symbols go to shard 0, which counts them
+    uint16_t shard_for(const char* symbol) const {
+        uint32_t instrument = books.lookup(symbol);
+        return instrument == BookManager::UNKNOWN_INSTRUMENT ? 0 : books.shard_of(instrument);
+    }
+    // Sum of one counter over every worker shard
+    uint64_t sum_workers(std::atomic<uint64_t> WorkerShard::* counter) const;
+    // Sum of one counter over every RX context, the main thread's included
+    uint64_t sum_rx(std::atomic<uint64_t> RxQueueContext::* counter) const;
+    static size_t recording_threads(uint16_t rx_queues, uint16_t worker_count) {
+        return size_t{std::max<uint16_t>(rx_queues, 1)} + std::max<uint16_t>(worker_count, 1) + 1;
+    }
+    static MarketDataMessage toMarketData(const Order& order, uint64_t rx_tsc);
+    static void printLatencyStats(const char* name, const LatencyRecorder& recorder);
+    static void printHistogram(const char* name, const LatencyHistogram& histogram);
+    size_t loopbackFrame(const Order& order, uint32_t dest_ip, uint16_t dest_port, std::span<uint8_t> packet);
+    template<typename Queue>
+    static void printQueueStats(const char* name, const Queue& queue);
+    template<typename Queue>
+    static void fillQueueStats(StatsQueue& out, const char* name, const Queue& queue);
 
 public:
-    MarketDataHandler();
-    void handleMessage(const MarketDataMessage& msg);
-    void processMessages();
+    MarketDataHandler(const std::vector<InstrumentConfig>& instruments, uint16_t rx_queues, uint16_t worker_count = 1);
+    void handleMessage(RxQueueContext& rx, const MarketDataMessage& msg);
+    size_t processMessages(uint16_t shard);
     void printStats();
-    void process_network_packet(const uint8_t* data, size_t len);
-    void submit_order(const Order& order);
+    void process_network_packet(const uint8_t* data, size_t len, uint64_t rx_tsc);
+    void receive_burst(uint16_t queue, struct rte_mbuf** bufs, uint16_t nb_rx, uint64_t burst_tsc);
+    uint16_t rx_queue_count() const { return static_cast<uint16_t>(rx_contexts.size() - 1); }
+    uint16_t worker_count() const { return static_cast<uint16_t>(workers.size()); }
+    uint64_t processed_messages() const { return sum_workers(&WorkerShard::processed_messages); }
+    const BookManager& book_manager() const { return books; }
+    uint64_t zero_copy_message_count() const { return sum_rx(&RxQueueContext::zero_copy_messages); }
+    uint64_t copied_message_count() const { return sum_rx(&RxQueueContext::copied_messages); }
+    void releaseViews(uint16_t shard);
+    void set_zero_copy_rx(bool enabled) { zero_copy_rx = enabled; }
+    void set_stats_publisher(StatsPublisher* publisher) { stats_publisher = publisher; }
+    void publishStats(uint64_t now_tsc);
+    void set_overflow_policy(OverflowPolicy policy) {
+        for (auto& rx : rx_contexts) {
+            for (auto& queue : rx->shards) queue->set_policy(policy);
+        }
+    }
+    void enable_matching() { books.enable_matching(); }
+    void enable_feed(const std::vector<FeedChannelConfig>& channels, uint64_t max_hold_ns);
+    void receive_feed_burst(struct rte_mbuf** bufs, uint16_t nb_rx, uint64_t burst_tsc);
+    void expire_feed(uint64_t now_tsc);
+    void enable_order_tx(struct rte_mempool* pool, uint16_t port, uint16_t queue, const LinkConfig& link,
+                         uint32_t dest_ip, uint16_t dest_port);
+    // signal_tsc: when the strategy decided to send, the start of the tick-to-trade measurement
+    void submit_order(const Order& order, uint64_t signal_tsc);
+    void flush_orders();
     Order generate_random_order();
     void simulate_market_activity(int num_orders);
 };
 
 int lcore_rx(void *arg);
-int lcore_worker(void *arg);
\ No newline at end of file
+int lcore_feed(void *arg);
+int lcore_replay(void *arg);
+int lcore_worker(void *arg);
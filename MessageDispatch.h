@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "BookManager.h"
+#include "SIMDMessageParser.h"
+
+/* ITCH-style message types carried in MarketDataMessage::message_type
+ * Every message carries the symbol, so each one can be routed to its book before dispatch
+ *   'A' Add       - new resting order (order_id, price, quantity, side)
+ *   'X' Cancel    - partial cancel, quantity is the number of shares cancelled
+ *   'E' Execute   - partial or full execution, quantity is the number of shares executed
+ *   'U' Replace   - order_id gets a new price and quantity, loses time priority
+ *   'D' Delete    - full cancel
+ */
+enum class MessageKind : uint8_t {
+    Add,
+    Cancel,
+    Execute,
+    Replace,
+    Delete,
+    Unknown,
+    Count
+};
+
+constexpr const char* MESSAGE_KIND_NAMES[static_cast<size_t>(MessageKind::Count)] = {
+        "Add", "Cancel", "Execute", "Replace", "Delete", "Unknown"
+};
+
+using MessageHandlerFn = void (*)(BookEngine&, const MarketDataMessage&);
+
+// One entry per possible message_type byte
+struct MessageDispatchEntry {
+    MessageHandlerFn handler;
+    MessageKind kind;
+};
+
+// Per-type handlers. Kept tiny so the compiler can see straight through them
+namespace message_handlers {
+    inline void on_add(BookEngine& book, const MarketDataMessage& msg) {
+        book.addOrder(msg.order_id, msg.price, msg.quantity, msg.side == 'B');
+    }
+    inline void on_reduce(BookEngine& book, const MarketDataMessage& msg) {
+        book.reduceOrder(msg.order_id, msg.quantity);
+    }
+    inline void on_replace(BookEngine& book, const MarketDataMessage& msg) {
+        book.replaceOrder(msg.order_id, msg.price, msg.quantity);
+    }
+    inline void on_delete(BookEngine& book, const MarketDataMessage& msg) {
+        book.removeOrder(msg.order_id);
+    }
+    inline void on_unknown(BookEngine&, const MarketDataMessage&) {}
+}
+
+/* Jump table indexed by the raw message_type byte, built at compile time
+ * Dispatch is one load and one indirect call, no compare cascade, and unknown types land on a no-op
+ */
+constexpr std::array<MessageDispatchEntry, 256> make_dispatch_table() {
+    std::array<MessageDispatchEntry, 256> table{};
+    for (auto& entry : table) entry = {message_handlers::on_unknown, MessageKind::Unknown};
+    table[static_cast<uint8_t>('A')] = {message_handlers::on_add, MessageKind::Add};
+    table[static_cast<uint8_t>('X')] = {message_handlers::on_reduce, MessageKind::Cancel};
+    table[static_cast<uint8_t>('E')] = {message_handlers::on_reduce, MessageKind::Execute};
+    table[static_cast<uint8_t>('U')] = {message_handlers::on_replace, MessageKind::Replace};
+    table[static_cast<uint8_t>('D')] = {message_handlers::on_delete, MessageKind::Delete};
+    return table;
+}
+
+inline constexpr std::array<MessageDispatchEntry, 256> MESSAGE_DISPATCH = make_dispatch_table();
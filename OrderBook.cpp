@@ -1,54 +1,160 @@
 #include "OrderBook.h"
+#include <algorithm>
 #include <limits>
 
+OrderBook::OrderBook(size_t max_orders, size_t max_levels)
+        : pool(max_orders),
+          level_nodes(std::make_unique<LevelNodeSlab>(max_levels > 0 ? max_levels : max_orders)),
+          bids(LevelNodeAllocator<std::pair<const uint32_t, PriceLevel>>(level_nodes.get())),
+          asks(LevelNodeAllocator<std::pair<const uint32_t, PriceLevel>>(level_nodes.get())),
+          order_map(max_orders) {}
+
 /* Add a new order to the order book
- * Updates either the bid or ask side based on the order type
- * Realistic average O(1). Worst 0(N) due to very rare hash collisions
+ * Appends to the back of the FIFO at its price level, so time priority is preserved
+ * In matching mode it first trades against whatever it crosses, and only the remainder rests
+ * Returns false if the id is already live or the node pool is exhausted, nothing has traded or changed then
+ * Realistic average O(1) for the node, O(log K) for the level lookup
  */
-void OrderBook::addOrder(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy) {
-    Order order = {order_id, quantity, price, is_buy};
+bool OrderBook::addOrder(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy) {
+    // Both rejections come before matching, a rejected order must not trade. The slot goes back if nothing rests
+    if (order_map.find(order_id) != FlatHashIndex::NOT_FOUND) return false;
+    OrderHandle h = pool.allocate();
+    if (h == INVALID_ORDER) return false;
+    if (trades) {
+        quantity = match(order_id, price, quantity, is_buy);
+        if (quantity == 0) {
+            pool.release(h);
+            return true;
+        }
+    }
+    if (!order_map.insert(order_id, h)) {  // Sized like the pool, so only if the two disagree
+        pool.release(h);
+        return false;
+    }
+
+    OrderNode& node = pool[h];
+    node.order_id = order_id;
+    node.quantity = quantity;
+    node.price = price;
+    node.is_buy = is_buy;
+
     if (is_buy) {
-        bids[price][order_id] = order;
-        order_map[order_id] = &bids[price][order_id];
+        bids[price].push_back(pool, h);
     } else {
-        asks[price][order_id] = order;
-        order_map[order_id] = &asks[price][order_id];
+        asks[price].push_back(pool, h);
     }
+    note_level(price, is_buy);
+    return true;
 }
 
-/* Remove an order from the order book at specified price level
+/* Find the level an existing order rests on
+ * The level is guaranteed to exist while it holds an order
+ */
+PriceLevel& OrderBook::existing_level(const OrderNode& order) {
+    return order.is_buy ? bids.find(order.price)->second : asks.find(order.price)->second;
+}
+
+/* Unlink an order from its price level
  * Cleans up empty price levels if necessary
- * Realistic average O(1). Worst 0(N) due to very rare hash collisions
  */
-void OrderBook::removeOrder(uint64_t order_id) {
-    auto it = order_map.find(order_id);
-    if (it != order_map.end()) {
-        Order* order = it->second; //retrieve order
-        if (order->is_buy) {
-            bids[order->price].erase(order_id);
-            if (bids[order->price].empty()) {
-                bids.erase(order->price);
-            }
-        } else {
-            asks[order->price].erase(order_id);
-            if (asks[order->price].empty()) {
-                asks.erase(order->price);
-            }
+void OrderBook::erase_from_level(OrderHandle h) {
+    const OrderNode& order = pool[h];
+    note_level(order.price, order.is_buy);
+    if (order.is_buy) {
+        auto level = bids.find(order.price);
+        level->second.unlink(pool, h);
+        if (level->second.empty()) {
+            bids.erase(level);
         }
-        order_map.erase(it);
+    } else {
+        auto level = asks.find(order.price);
+        level->second.unlink(pool, h);
+        if (level->second.empty()) {
+            asks.erase(level);
+        }
+    }
+}
+
+/* Remove an order from the order book at specified price level
+ * O(1) unlink from the level, the node goes back to the pool
+ */
+void OrderBook::removeOrder(uint64_t order_id) {
+    OrderHandle h = order_map.erase(order_id); //retrieve and unindex order in one probe
+    if (h != INVALID_ORDER) {
+        erase_from_level(h);
+        pool.release(h);
     }
 }
 
 /* Modify the quantity of an existing order
- * This function assumes the price remains unchanged
+ * This function assumes the price remains unchanged. The order keeps its place in the queue
  */
 void OrderBook::modifyOrder(uint64_t order_id, uint32_t new_quantity) {
-    auto it = order_map.find(order_id);
-    if (it != order_map.end()) {
-        it->second->quantity = new_quantity;
+    OrderHandle h = order_map.find(order_id);
+    if (h != INVALID_ORDER) {
+        OrderNode& order = pool[h];
+        note_level(order.price, order.is_buy);
+        PriceLevel& level = existing_level(order);
+        level.total_quantity = level.total_quantity - order.quantity + new_quantity;
+        order.quantity = new_quantity;
     }
 }
 
+/* Take quantity off an existing order, used for partial cancels and executions
+ * The order keeps its place in the queue and is removed once nothing is left
+ */
+void OrderBook::reduceOrder(uint64_t order_id, uint32_t quantity) {
+    OrderHandle h = order_map.find(order_id);
+    if (h != INVALID_ORDER) reduce(h, quantity);
+}
+
+void OrderBook::reduce(OrderHandle h, uint32_t quantity) {
+    OrderNode& order = pool[h];
+    if (quantity >= order.quantity) {
+        order_map.erase(order.order_id);
+        erase_from_level(h);
+        pool.release(h);
+        return;
+    }
+    note_level(order.price, order.is_buy);
+    existing_level(order).total_quantity -= quantity;
+    order.quantity -= quantity;
+}
+
+/* Sweep the opposite side while it crosses price, always against the oldest order at the best level (price-time priority)
+ * Each fill is logged at the resting price and taken off the resting order like an execution
+ * Returns the quantity left over, to rest
+ */
+uint32_t OrderBook::match(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy) {
+    while (quantity > 0) {
+        OrderHandle h;
+        if (is_buy) {
+            if (asks.empty() || asks.begin()->first > price) break;
+            h = asks.begin()->second.head;
+        } else {
+            if (bids.empty() || bids.begin()->first < price) break;
+            h = bids.begin()->second.head;
+        }
+        const OrderNode& resting = pool[h];
+        uint32_t fill = std::min(quantity, resting.quantity);
+        trades->push({order_id, resting.order_id, resting.price, fill, is_buy});
+        quantity -= fill;
+        reduce(h, fill);
+    }
+    return quantity;
+}
+
+/* Replace an order with a new price and quantity, keeping its id and side
+ * Loses time priority like on the exchange, the order goes to the back of its new level
+ */
+void OrderBook::replaceOrder(uint64_t order_id, uint32_t new_price, uint32_t new_quantity) {
+    OrderHandle h = order_map.find(order_id);
+    if (h == INVALID_ORDER) return;
+    bool is_buy = pool[h].is_buy;
+    removeOrder(order_id);
+    addOrder(order_id, new_price, new_quantity, is_buy);
+}
+
 /* Get the best (highest) bid price
  * Returns 0 if there are no bids
  */
@@ -61,4 +167,34 @@ uint32_t OrderBook::getBestBid() const {
  */
 uint32_t OrderBook::getBestAsk() const {
     return asks.empty() ? std::numeric_limits<uint32_t>::max() : asks.begin()->first;
-}
\ No newline at end of file
+}
+
+/* Best price and its resting quantity on both sides
+ * Reads the first level of each map, no walk
+ */
+TopOfBook OrderBook::top() const {
+    TopOfBook top;
+    if (!bids.empty()) {
+        top.bid_price = bids.begin()->first;
+        top.bid_quantity = bids.begin()->second.total_quantity;
+    }
+    if (!asks.empty()) {
+        top.ask_price = asks.begin()->first;
+        top.ask_quantity = asks.begin()->second.total_quantity;
+    }
+    return top;
+}
+
+/* Best n levels of one side, in map order (best first)
+ * Each map node holds its PriceLevel, so a level costs one node visit
+ */
+size_t OrderBook::getDepth(size_t n, bool is_buy, const DepthSpan& out) const {
+    size_t limit = std::min(n, out.capacity());
+    size_t count = 0;
+    if (is_buy) {
+        for (auto it = bids.begin(); it != bids.end() && count < limit; ++it) out.set(count++, it->first, it->second);
+    } else {
+        for (auto it = asks.begin(); it != asks.end() && count < limit; ++it) out.set(count++, it->first, it->second);
+    }
+    return count;
+}
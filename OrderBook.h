@@ -1,33 +1,79 @@
 #pragma once
 
-#include <map>
-#include <unordered_map>
+#include <memory>
+#include <cstddef>
 #include <cstdint>
+#include "OrderPool.h"
+#include "FlatHashIndex.h"
+#include "TradeBuffer.h"
 
 
 class OrderBook {
 private:
-    struct Order {
-
-        /* uint64_t is used for order_id to ensure a vast range for unique identifiers
-         * uint32_t is used for price and quantity to balance range, memory efficiency, and performance (better cache utilization)
-         */
-        uint64_t order_id;
-        uint32_t quantity;
-        uint32_t price;
-        bool is_buy;
-    };
+    /* Orders live in a preallocated pool, each price level is a FIFO of pool handles
+     * uint64_t is used for order_id to ensure a vast range for unique identifiers
+     * uint32_t is used for price and quantity to balance range, memory efficiency, and performance (better cache utilization)
+     */
+    OrderPool pool;
+    // Tree nodes for both sides' levels. On the heap so the maps' allocators stay valid when the book is moved
+    std::unique_ptr<LevelNodeSlab> level_nodes;
 
     // Bids are sorted in descending order, asks in ascending order. Time O(log K). Map is balancy binary search tree. K = price level
-    std::map<uint32_t, std::unordered_map<uint64_t, Order>, std::greater<uint32_t>> bids;
-    std::map<uint32_t, std::unordered_map<uint64_t, Order>, std::less<uint32_t>> asks;
-    // Map for quick lookup. Will look into combining with stable vectors in the near future
-    std::unordered_map<uint64_t, Order*> order_map;
+    LevelMap<std::greater<uint32_t>> bids;
+    LevelMap<std::less<uint32_t>> asks;
+    // Order id to pool handle. Handles never move, unlike pointers into a container. Flat table, no per-insert allocation or rehash
+    FlatHashIndex order_map;
+    bool top_changed = false;
+    TradeBuffer* trades = nullptr;  // Set in matching mode, fills go here
+
+    PriceLevel& existing_level(const OrderNode& order);
+    void erase_from_level(OrderHandle h);
+    void reduce(OrderHandle h, uint32_t quantity);
+    uint32_t match(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy);
+
+    /* Flags a top-of-book change if price is the best level on its side
+     * Called after an order joins a level and before one leaves or shrinks, so the side is never empty here
+     */
+    void note_level(uint32_t price, bool is_buy) {
+        top_changed |= is_buy ? bids.begin()->first == price : asks.begin()->first == price;
+    }
 
 public:
-    void addOrder(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy);
+    static constexpr size_t DEFAULT_MAX_ORDERS = 1 << 20;
+
+    /* max_orders sizes the order node pool and max_levels the level slab (both sides together), once
+     * Every level holds at least one order, so 0 (the default) sizes the slab to max_orders, which always suffices
+     * Adds, cancels and modifies never allocate after this while the book stays within them
+     */
+    explicit OrderBook(size_t max_orders = DEFAULT_MAX_ORDERS, size_t max_levels = 0);
+
+    /* Matching mode: an order that crosses the spread trades against the opposite side first (see addOrder)
+     * and fills go to trade_buffer, which the caller drains. nullptr rests every order, as a market data book should
+     */
+    void set_matching(TradeBuffer* trade_buffer) { trades = trade_buffer; }
+    TradeBuffer* trade_buffer() const { return trades; }
+
+    bool addOrder(uint64_t order_id, uint32_t price, uint32_t quantity, bool is_buy);
     void removeOrder(uint64_t order_id);
     void modifyOrder(uint64_t order_id, uint32_t new_quantity);
+    void reduceOrder(uint64_t order_id, uint32_t quantity);
+    void replaceOrder(uint64_t order_id, uint32_t new_price, uint32_t new_quantity);
     uint32_t getBestBid() const;
     uint32_t getBestAsk() const;
-};
\ No newline at end of file
+    TopOfBook top() const;
+    size_t order_count() const { return pool.size(); }  // Resting orders, each holds one pool slot
+
+    /* Copy the best n levels of one side into out, as many as fit. Returns how many levels were written
+     * Level quantities and order counts are kept up to date by every update, so this is a walk over n levels only
+     */
+    size_t getDepth(size_t n, bool is_buy, const DepthSpan& out) const;
+
+    /* True if a best price, or the quantity at one, changed since the last call. Clears the flag
+     * Tracked as a side effect of the updates above, nothing is recomputed to answer
+     */
+    bool take_top_change() {
+        bool changed = top_changed;
+        top_changed = false;
+        return changed;
+    }
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/* Handles are indices into the pool, not pointers
+ * They stay valid for the life of the order no matter what happens to the containers around them
+ */
+using OrderHandle = uint32_t;
+constexpr OrderHandle INVALID_ORDER = UINT32_MAX;
+
+// Resting order, doubles as the link node of the FIFO queue at its price level. 32 bytes so two fit in a cache line
+struct OrderNode {
+    uint64_t order_id;
+    uint32_t quantity;
+    uint32_t price;
+    OrderHandle prev;   // Older order at the same level
+    OrderHandle next;   // Newer order at the same level. Also the free list link while the node is unused
+    bool is_buy;
+};
+
+/* Best price and the quantity resting there, per side, as the book engines report it
+ * An empty side reads like getBestBid/getBestAsk (0 for bids, UINT32_MAX for asks) with no quantity
+ */
+struct TopOfBook {
+    uint32_t bid_price = 0;
+    uint32_t ask_price = UINT32_MAX;
+    uint64_t bid_quantity = 0;
+    uint64_t ask_quantity = 0;
+};
+
+/* Fixed-size slab of order nodes with an intrusive free list
+ * Everything is allocated in the constructor, allocate/release never touch malloc
+ */
+class OrderPool {
+private:
+    std::vector<OrderNode> nodes;
+    OrderHandle free_head;
+    size_t in_use = 0;
+
+public:
+    explicit OrderPool(size_t capacity) : nodes(capacity), free_head(capacity ? 0 : INVALID_ORDER) {
+        for (size_t i = 0; i < capacity; ++i) {
+            nodes[i].next = (i + 1 < capacity) ? static_cast<OrderHandle>(i + 1) : INVALID_ORDER;
+        }
+    }
+
+    /* Pop a node off the free list
+     * Returns INVALID_ORDER when the pool is exhausted, the caller decides what to do (we never grow on the hot path)
+     */
+    OrderHandle allocate() {
+        OrderHandle h = free_head;
+        if (h != INVALID_ORDER) {
+            free_head = nodes[h].next;
+            ++in_use;
+        }
+        return h;
+    }
+
+    // Push a node back onto the free list. LIFO so the next allocate gets a cache-hot node
+    void release(OrderHandle h) {
+        nodes[h].next = free_head;
+        free_head = h;
+        --in_use;
+    }
+
+    OrderNode& operator[](OrderHandle h) { return nodes[h]; }
+    const OrderNode& operator[](OrderHandle h) const { return nodes[h]; }
+    size_t capacity() const { return nodes.size(); }
+    size_t size() const { return in_use; }
+};
+
+/* Price level as an intrusive doubly linked FIFO of pool nodes
+ * Oldest order at head, so iteration order is time priority
+ * Keeps the aggregate quantity and order count up to date on every change
+ */
+struct PriceLevel {
+    OrderHandle head = INVALID_ORDER;
+    OrderHandle tail = INVALID_ORDER;
+    uint64_t total_quantity = 0;
+    uint32_t order_count = 0;
+
+    bool empty() const { return head == INVALID_ORDER; }
+
+    // Append to the back of the queue (lowest time priority)
+    void push_back(OrderPool& pool, OrderHandle h) {
+        OrderNode& node = pool[h];
+        node.prev = tail;
+        node.next = INVALID_ORDER;
+        if (tail != INVALID_ORDER) pool[tail].next = h;
+        else head = h;
+        tail = h;
+        total_quantity += node.quantity;
+        ++order_count;
+    }
+
+    // Unlink from anywhere in the queue. O(1), no search
+    void unlink(OrderPool& pool, OrderHandle h) {
+        OrderNode& node = pool[h];
+        if (node.prev != INVALID_ORDER) pool[node.prev].next = node.next;
+        else head = node.next;
+        if (node.next != INVALID_ORDER) pool[node.next].prev = node.prev;
+        else tail = node.prev;
+        total_quantity -= node.quantity;
+        --order_count;
+    }
+};
+
+/* Fixed-capacity slab for the tree nodes of the price level maps
+ * std::map allocates one node per price level. Carving them out of one block reserved at construction and putting
+ * them back on a free list means opening and emptying levels never touches malloc either. Past capacity the extra
+ * nodes come from operator new rather than failing the add, size the slab for the most levels a book is expected to hold
+ * The block is left uninitialised and nodes are carved in order the first time they are needed, so a book only commits
+ * the pages its deepest moment has used, not its capacity
+ */
+class LevelNodeSlab {
+public:
+    // Red-black tree node header (colour and three links in libstdc++ and libc++) plus the level, rounded for alignment
+    static constexpr size_t NODE_SIZE = (4 * sizeof(void*) + sizeof(std::pair<const uint32_t, PriceLevel>) + alignof(std::max_align_t) - 1)
+                                        / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+private:
+    std::unique_ptr<std::byte[]> storage;
+    size_t capacity;
+    size_t carved = 0;          // Nodes handed out from storage so far, the ones past it have never been touched
+    void* free_head = nullptr;  // Released nodes, reused before a new one is carved
+
+    bool owns(const void* p) const {
+        auto at = static_cast<const std::byte*>(p);
+        return at >= storage.get() && at < storage.get() + capacity * NODE_SIZE;
+    }
+
+public:
+    explicit LevelNodeSlab(size_t capacity)
+            : storage(std::make_unique_for_overwrite<std::byte[]>(capacity * NODE_SIZE)), capacity(capacity) {}
+
+    void* allocate(size_t size) {
+        if (size > NODE_SIZE) return ::operator new(size);
+        if (free_head != nullptr) {
+            void* node = free_head;
+            free_head = *static_cast<void**>(node);
+            return node;
+        }
+        if (carved < capacity) return storage.get() + carved++ * NODE_SIZE;
+        return ::operator new(size);
+    }
+
+    void release(void* node) {
+        if (!owns(node)) {
+            ::operator delete(node);
+            return;
+        }
+        *static_cast<void**>(node) = free_head;
+        free_head = node;
+    }
+};
+
+// Allocator handing std::map its nodes from a LevelNodeSlab. The slab has to outlive every map using it
+template<typename T>
+class LevelNodeAllocator {
+public:
+    using value_type = T;
+    LevelNodeSlab* slab;
+
+    explicit LevelNodeAllocator(LevelNodeSlab* s) : slab(s) {}
+    template<typename U>
+    LevelNodeAllocator(const LevelNodeAllocator<U>& other) : slab(other.slab) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(slab->allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t) { slab->release(p); }
+
+    template<typename U>
+    bool operator==(const LevelNodeAllocator<U>& other) const { return slab == other.slab; }
+};
+
+// Price to level, ordered best first by Compare, with slab allocated nodes
+template<typename Compare>
+using LevelMap = std::map<uint32_t, PriceLevel, Compare, LevelNodeAllocator<std::pair<const uint32_t, PriceLevel>>>;
+
+/* One side of an L2 depth snapshot in caller memory, struct of arrays so a consumer scanning prices or quantities
+ * reads them contiguously. Level i is prices[i], quantities[i], order_counts[i], best level first
+ */
+struct DepthSpan {
+    std::span<uint32_t> prices;
+    std::span<uint64_t> quantities;
+    std::span<uint32_t> order_counts;
+
+    size_t capacity() const { return std::min({prices.size(), quantities.size(), order_counts.size()}); }
+
+    // Copies the level's running aggregates, nothing is summed here
+    void set(size_t i, uint32_t price, const PriceLevel& level) const {
+        prices[i] = price;
+        quantities[i] = level.total_quantity;
+        order_counts[i] = level.order_count;
+    }
+};
@@ -1,15 +1,6 @@
 #include "OrderProtocol.h"
 #include <cstring>
 
-/* Serialize an Order object into a byte vector
- * This allows the order to be transmitted over the network
- */
-std::vector<uint8_t> OrderProtocol::serialize_order(const Order& order) {
-    std::vector<uint8_t> data(sizeof(Order));
-    memcpy(data.data(), &order, sizeof(Order));
-    return data;
-}
-
 /* Deserialize a byte array into an Order object
  * This allows received data to be converted back into an Order
  */
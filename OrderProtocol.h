@@ -1,17 +1,30 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <vector>
+#include <cstring>
+#include <span>
 
 struct Order {
     uint64_t order_id;
     uint32_t price;
     uint32_t quantity;
     bool is_buy;
+    char symbol[8];     // Same 8-byte space padded form as MarketDataMessage::symbol
 };
 
 class OrderProtocol {
 public:
-    static std::vector<uint8_t> serialize_order(const Order& order);
+    static constexpr size_t WIRE_SIZE = sizeof(Order);
+
+    /* Serialize an Order into out, in place: no allocation, one fixed-size copy
+     * Returns WIRE_SIZE, or 0 if out is too small. Inline so the copy compiles to a couple of stores at the call site
+     */
+    static size_t serialize_order(const Order& order, std::span<uint8_t> out) {
+        if (out.size() < WIRE_SIZE) return 0;
+        std::memcpy(out.data(), &order, WIRE_SIZE);
+        return WIRE_SIZE;
+    }
+
     static Order deserialize_order(const uint8_t* data, size_t len);
-};
\ No newline at end of file
+};
@@ -0,0 +1,79 @@
+#include "OrderSender.h"
+#include <rte_ethdev.h>
+#include <rte_mbuf.h>
+#include "DPDKSetup.h"
+#include "TscClock.h"
+
+OrderSender::OrderSender(struct rte_mempool* pool, uint16_t port, uint16_t queue, const LinkConfig& link,
+                         uint32_t dest_ip, uint16_t dest_port)
+        : stack(1), pool(pool), port(port), queue(queue), dest_ip(dest_ip), dest_port(dest_port),
+          checksums(port_tx_checksum_offload(port) ? ChecksumMode::Offload : ChecksumMode::Software) {
+    stack.set_link(link);
+    stack.build_template(dest_ip, dest_port, frame_template);
+}
+
+// Whatever is still staged goes out, so orders submitted just before shutdown aren't lost
+OrderSender::~OrderSender() {
+    flush();
+}
+
+/* Serialize the order in place in the mbuf's data room, then seal the frame around it from the template
+ * With offload the mbuf tells the NIC where the headers are, the stack has already seeded the TCP checksum
+ */
+bool OrderSender::send(const Order& order, uint64_t signal_tsc) {
+    struct rte_mbuf* mbuf = rte_pktmbuf_alloc(pool);
+    if (mbuf == nullptr) {
+        bump(failed_orders);
+        return false;
+    }
+
+    uint8_t* frame = rte_pktmbuf_mtod(mbuf, uint8_t*);
+    size_t room = rte_pktmbuf_tailroom(mbuf);
+    size_t len = 0;
+    if (frame_template.connection != TCPIPStack::NO_CONNECTION && room > TCPIPStack::PAYLOAD_OFFSET) {
+        size_t order_len = OrderProtocol::serialize_order(order, {frame + TCPIPStack::PAYLOAD_OFFSET, room - TCPIPStack::PAYLOAD_OFFSET});
+        if (order_len > 0) len = stack.seal_frame(frame_template, frame, order_len, checksums);
+    }
+    if (len == 0) {
+        rte_pktmbuf_free(mbuf);
+        bump(failed_orders);
+        return false;
+    }
+    mbuf->data_len = static_cast<uint16_t>(len);
+    mbuf->pkt_len = static_cast<uint32_t>(len);
+    if (checksums == ChecksumMode::Offload) {
+        mbuf->l2_len = TCPIPStack::ETHER_HEADER_LEN;
+        mbuf->l3_len = TCPIPStack::IPV4_HEADER_LEN;
+        mbuf->l4_len = TCPIPStack::TCP_HEADER_LEN;
+        mbuf->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM | RTE_MBUF_F_TX_TCP_CKSUM;
+    }
+
+    staged_signal_tsc[staged_count] = signal_tsc;
+    staged[staged_count++] = mbuf;
+    if (staged_count == TX_BATCH) flush();
+    return true;
+}
+
+/* A full TX ring usually drains within a few descriptors' time, so retry a little before giving up
+ * The TCP sequence numbers are already spent, a frame dropped here is a hole the peer has to wait out
+ * Every frame a tx_burst takes gets its tick-to-trade sample when that call returns
+ */
+void OrderSender::flush() {
+    if (staged_count == 0) return;
+    uint16_t sent = 0;
+    for (unsigned attempt = 0; attempt < TX_RETRIES && sent < staged_count; ++attempt) {
+        uint16_t taken = rte_eth_tx_burst(port, queue, staged + sent, staged_count - sent);
+        uint64_t now = TscClock::now();
+        for (uint16_t i = sent; i < sent + taken; ++i) {
+            tick_to_trade.record(now > staged_signal_tsc[i] ? now - staged_signal_tsc[i] : 0);
+        }
+        sent += taken;
+        bump(tx_bursts);
+    }
+    for (uint16_t i = sent; i < staged_count; ++i) {
+        rte_pktmbuf_free(staged[i]);
+    }
+    bump(sent_packets, sent);
+    bump(dropped_packets, staged_count - sent);
+    staged_count = 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "LatencyHistogram.h"
+#include "OrderProtocol.h"
+#include "TCPIPStack.h"
+
+struct rte_mbuf;
+struct rte_mempool;
+
+/* Order entry transmit path
+ * Each order is serialized straight into an mbuf from a pool of its own (a burst of market data can't starve order
+ * entry of buffers), behind headers copied from a template built once at startup, so nothing is allocated and only
+ * the per-frame header fields are stored per order. Frames are staged and handed to the NIC with one rte_eth_tx_burst
+ * per batch. IPv4 and TCP checksums are left to the NIC when the port offers both offloads, otherwise they are
+ * computed while the frame is still in cache
+ * The sender has its own one-connection TCP stack, so its sequence numbers are exactly what went on the wire
+ * One core owns a sender and its TX queue. Counters are written by that core only
+ */
+class OrderSender {
+public:
+    static constexpr uint16_t TX_BATCH = 32;
+    static constexpr unsigned TX_RETRIES = 8;   // tx_burst calls per flush before unsent frames are dropped
+
+private:
+    TCPIPStack stack;
+    TCPIPStack::FrameTemplate frame_template;
+    struct rte_mempool* pool;
+    uint16_t port;
+    uint16_t queue;
+    uint32_t dest_ip;
+    uint16_t dest_port;
+    ChecksumMode checksums;
+    struct rte_mbuf* staged[TX_BATCH];
+    uint64_t staged_signal_tsc[TX_BATCH];
+    uint16_t staged_count = 0;
+    LatencyHistogram tick_to_trade;             // Strategy signal to the return of the tx_burst that took the frame, TSC cycles
+
+    std::atomic<uint64_t> sent_packets{0};
+    std::atomic<uint64_t> tx_bursts{0};
+    std::atomic<uint64_t> dropped_packets{0};   // TX ring still full after TX_RETRIES, the peer sees a hole in the stream
+    std::atomic<uint64_t> failed_orders{0};     // No mbuf, or no connection slot, nothing was sent
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+public:
+    // Checksum offload is used if the port supports it (port_init enables it then)
+    OrderSender(struct rte_mempool* pool, uint16_t port, uint16_t queue, const LinkConfig& link, uint32_t dest_ip, uint16_t dest_port);
+    ~OrderSender();
+
+    /* Frame one order into an mbuf and stage it, the batch goes out when it is full or on flush()
+     * signal_tsc is when the strategy decided to send it, for tick_to_trade. False if no frame could be built,
+     * counted in failed_orders
+     */
+    bool send(const Order& order, uint64_t signal_tsc);
+
+    // Hand the staged frames to the NIC
+    void flush();
+
+    ChecksumMode checksum_mode() const { return checksums; }
+    uint64_t sent_count() const { return sent_packets.load(std::memory_order_relaxed); }
+    uint64_t burst_count() const { return tx_bursts.load(std::memory_order_relaxed); }
+    uint64_t dropped_count() const { return dropped_packets.load(std::memory_order_relaxed); }
+    uint64_t failed_count() const { return failed_orders.load(std::memory_order_relaxed); }
+    const LatencyHistogram& tick_to_trade_latency() const { return tick_to_trade; }
+};
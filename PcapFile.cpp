@@ -0,0 +1,103 @@
+#include "PcapFile.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr size_t WRITE_BUFFER_SIZE = 1 << 20;
+}
+
+PcapReader::~PcapReader() {
+    if (base) munmap(const_cast<uint8_t*>(base), size);
+}
+
+uint32_t PcapReader::field(const uint8_t* at) const {
+    uint32_t value;
+    std::memcpy(&value, at, sizeof(value));
+    return swapped ? __builtin_bswap32(value) : value;
+}
+
+bool PcapReader::open(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < FILE_HEADER_LEN) {
+        std::cerr << path << ": too short for a pcap header" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping keeps the file
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Cannot map " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    base = static_cast<const uint8_t*>(mapped);
+    size = static_cast<size_t>(st.st_size);
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    uint32_t magic;
+    std::memcpy(&magic, base, sizeof(magic));
+    swapped = magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS);
+    uint32_t native = swapped ? __builtin_bswap32(magic) : magic;
+    if (native != PCAP_MAGIC_US && native != PCAP_MAGIC_NS) {
+        std::cerr << path << ": not a pcap file" << std::endl;
+        return false;
+    }
+    nanos = native == PCAP_MAGIC_NS;
+    if (field(base + 20) != PCAP_LINKTYPE_ETHERNET) {
+        std::cerr << path << ": not an Ethernet capture" << std::endl;
+        return false;
+    }
+    rewind();
+    return true;
+}
+
+bool PcapReader::next(CapturedFrame& frame) {
+    if (offset + RECORD_HEADER_LEN > size) return false;
+    const uint8_t* record = base + offset;
+    uint32_t captured = field(record + 8);
+    if (captured > size - offset - RECORD_HEADER_LEN) return false;
+    uint64_t sub = field(record + 4);
+    frame.data = record + RECORD_HEADER_LEN;
+    frame.len = captured;
+    frame.wire_len = field(record + 12);
+    frame.ts_ns = uint64_t{field(record)} * 1000000000ULL + (nanos ? sub : sub * 1000);
+    offset += RECORD_HEADER_LEN + captured;
+    return true;
+}
+
+bool PcapWriter::open(const char* path) {
+    close();
+    file = std::fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Cannot create " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, WRITE_BUFFER_SIZE);  // Big writes, the recorder's thread is the only one waiting on them
+    const uint32_t header[6] = {PCAP_MAGIC_NS, 0x00040002, 0, 0, PCAP_SNAPLEN, PCAP_LINKTYPE_ETHERNET};  // Version 2.4
+    if (std::fwrite(header, sizeof(header), 1, file) != 1) {
+        std::cerr << "Cannot write " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool PcapWriter::write(const uint8_t* data, uint32_t len, uint32_t wire_len, uint64_t ts_ns) {
+    uint32_t captured = len < PCAP_SNAPLEN ? len : PCAP_SNAPLEN;
+    const uint32_t record[4] = {static_cast<uint32_t>(ts_ns / 1000000000ULL), static_cast<uint32_t>(ts_ns % 1000000000ULL), captured, wire_len};
+    return std::fwrite(record, sizeof(record), 1, file) == 1 && std::fwrite(data, captured, 1, file) == 1;
+}
+
+void PcapWriter::close() {
+    if (file) std::fclose(file);
+    file = nullptr;
+}
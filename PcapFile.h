@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/* Classic libpcap captures, the format net_pcap, tcpdump and Wireshark all read and write
+ * Both timestamp precisions (microsecond and nanosecond magic) and either byte order are read, Ethernet link type only
+ * No DPDK in here, so offline tools can link it without EAL
+ */
+
+constexpr uint32_t PCAP_MAGIC_US = 0xa1b2c3d4;
+constexpr uint32_t PCAP_MAGIC_NS = 0xa1b23c4d;
+constexpr uint32_t PCAP_LINKTYPE_ETHERNET = 1;
+constexpr uint32_t PCAP_SNAPLEN = 65535;
+
+// One frame of a capture, pointing into the reader's mapping
+struct CapturedFrame {
+    const uint8_t* data;
+    uint32_t len;           // Bytes captured
+    uint32_t wire_len;      // Bytes on the wire, more than len if the capture truncated the frame
+    uint64_t ts_ns;         // Capture timestamp, ns since the epoch
+};
+
+/* Read-only mmap of a pcap file
+ * Frames are handed out in file order straight from the mapping, nothing is copied or allocated per frame
+ */
+class PcapReader {
+private:
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+    bool swapped = false;   // Written on a machine of the other byte order
+    bool nanos = false;     // Nanosecond magic, otherwise microseconds
+
+    uint32_t field(const uint8_t* at) const;
+
+public:
+    static constexpr size_t FILE_HEADER_LEN = 24;
+    static constexpr size_t RECORD_HEADER_LEN = 16;
+
+    PcapReader() = default;
+    PcapReader(const PcapReader&) = delete;
+    PcapReader& operator=(const PcapReader&) = delete;
+    ~PcapReader();
+
+    // Map the file and check its header. Prints why and returns false if it isn't an Ethernet pcap
+    bool open(const char* path);
+
+    /* Next frame in the file, false at the end
+     * A record cut off by the end of the file also ends it, truncated() tells the two apart
+     */
+    bool next(CapturedFrame& frame);
+    bool truncated() const { return offset < size; }
+    void rewind() { offset = FILE_HEADER_LEN; }
+};
+
+/* Nanosecond pcap writer on buffered stdio
+ * Blocking file I/O, so never call it from a polling core. FrameRecorder runs it on a thread of its own
+ */
+class PcapWriter {
+private:
+    FILE* file = nullptr;
+
+public:
+    PcapWriter() = default;
+    PcapWriter(const PcapWriter&) = delete;
+    PcapWriter& operator=(const PcapWriter&) = delete;
+    ~PcapWriter() { close(); }
+
+    // Create the file and write the header. Prints why and returns false on failure
+    bool open(const char* path);
+    // len bytes of a frame that was wire_len long (more if only the first segment was kept)
+    bool write(const uint8_t* data, uint32_t len, uint32_t wire_len, uint64_t ts_ns);
+    void close();
+};
@@ -0,0 +1,84 @@
+#include "PcapReplay.h"
+#include <cstring>
+#include <iostream>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include "PcapFile.h"
+#include "TscClock.h"
+
+/* Two passes over the mapping: count the frames to size the pool, then copy each one into its mbuf
+ * Timestamps are turned into TSC offsets here, clamped so a capture that steps backwards just replays those frames at once
+ */
+bool PcapReplay::load(const char* path, Pacing mode) {
+    release();
+    pacing = mode;
+    skipped = 0;
+    PcapReader reader;
+    if (!reader.open(path)) return false;
+
+    CapturedFrame frame;
+    size_t count = 0;
+    while (reader.next(frame)) ++count;
+    if (reader.truncated()) std::cerr << path << ": last record is cut off, replaying the " << count << " whole frames" << std::endl;
+    if (count == 0) {
+        std::cerr << path << ": no frames to replay" << std::endl;
+        return false;
+    }
+
+    // No per-lcore cache: every mbuf is taken once up front, and a cache would need the pool to be 1.5x its size
+    pool = rte_pktmbuf_pool_create("REPLAY_POOL", static_cast<unsigned>(count), 0, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+    if (pool == nullptr) {
+        std::cerr << "Cannot create a pool for " << count << " frames, the capture is too big to preload" << std::endl;
+        return false;
+    }
+
+    frames.reserve(count);
+    offsets.reserve(count);
+    reader.rewind();
+    uint64_t first_ns = 0;
+    uint64_t last_ns = 0;
+    while (reader.next(frame)) {
+        if (frame.len > RTE_MBUF_DEFAULT_BUF_SIZE - RTE_PKTMBUF_HEADROOM) {
+            ++skipped;
+            continue;
+        }
+        struct rte_mbuf* mbuf = rte_pktmbuf_alloc(pool);
+        if (mbuf == nullptr) break;  // Sized to the frame count, can't happen
+        std::memcpy(rte_pktmbuf_append(mbuf, static_cast<uint16_t>(frame.len)), frame.data, frame.len);
+        if (frames.empty()) first_ns = last_ns = frame.ts_ns;
+        if (frame.ts_ns > last_ns) last_ns = frame.ts_ns;
+        offsets.push_back(TscClock::to_cycles(last_ns - first_ns));
+        frames.push_back(mbuf);
+    }
+    capture_ns = last_ns - first_ns;
+    if (skipped > 0) std::cerr << path << ": " << skipped << " frames don't fit in one mbuf, left out" << std::endl;
+    std::cout << "Loaded " << frames.size() << " frames from " << path << " (" << capture_ns / 1000000 << " ms of traffic)" << std::endl;
+    return !frames.empty();
+}
+
+uint16_t PcapReplay::next_burst(struct rte_mbuf** bufs, uint16_t max, uint64_t now_tsc) {
+    uint16_t n = 0;
+    while (n < max && next_frame < frames.size()
+           && (pacing == Pacing::MaxSpeed || start_tsc + offsets[next_frame] <= now_tsc)) {
+        bufs[n++] = frames[next_frame++];
+    }
+    return n;
+}
+
+void PcapReplay::finish(uint64_t now_tsc) {
+    end_tsc.store(now_tsc, std::memory_order_relaxed);
+    finished.store(true, std::memory_order_release);
+}
+
+void PcapReplay::release() {
+    if (pool == nullptr) return;
+    for (size_t i = next_frame; i < frames.size(); ++i) {
+        rte_pktmbuf_free(frames[i]);
+    }
+    frames.clear();
+    offsets.clear();
+    next_frame = 0;
+    rte_mempool_free(pool);
+    pool = nullptr;
+}
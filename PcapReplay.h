@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+struct rte_mbuf;
+struct rte_mempool;
+
+/* Plays a capture back into the RX path, in place of the NIC (--replay)
+ * load() maps the pcap and copies every frame into an mbuf of a pool sized to the capture, before anything runs,
+ * so replay itself never touches the file or allocates. The replay lcore then hands the mbufs to the handler's
+ * burst entry points exactly as lcore_rx/lcore_feed would, either at the recorded inter-frame gaps or back to back
+ * Frames are injected once, the handler takes ownership of each burst like it does of rte_eth_rx_burst's
+ */
+class PcapReplay {
+public:
+    enum class Pacing {
+        Recorded,   // Keep the capture's timing, a burst is whatever is due
+        MaxSpeed,   // Full bursts back to back, for throughput
+    };
+
+private:
+    struct rte_mempool* pool = nullptr;
+    std::vector<struct rte_mbuf*> frames;
+    std::vector<uint64_t> offsets;      // TSC cycles after the first frame, never decreasing
+    Pacing pacing = Pacing::Recorded;
+    uint64_t capture_ns = 0;            // First to last frame in the capture
+    size_t skipped = 0;                 // Frames too big for one mbuf
+    size_t next_frame = 0;
+    uint64_t start_tsc = 0;
+    std::atomic<uint64_t> end_tsc{0};   // Set by the replay lcore once every frame is in
+    std::atomic<bool> finished{false};
+
+public:
+    PcapReplay() = default;
+    PcapReplay(const PcapReplay&) = delete;
+    PcapReplay& operator=(const PcapReplay&) = delete;
+    ~PcapReplay() { release(); }
+
+    // Preload the capture, after EAL init. False (and why on stderr) if it can't be read or doesn't fit in memory
+    bool load(const char* path, Pacing mode);
+    bool loaded() const { return pool != nullptr; }
+
+    // Replay lcore only
+    void start(uint64_t now_tsc) { start_tsc = now_tsc; }
+    // Frames due at now_tsc, up to max. The caller owns them after this
+    uint16_t next_burst(struct rte_mbuf** bufs, uint16_t max, uint64_t now_tsc);
+    bool exhausted() const { return next_frame == frames.size(); }
+    void finish(uint64_t now_tsc);
+
+    // Any thread
+    bool done() const { return finished.load(std::memory_order_acquire); }
+    size_t frame_count() const { return frames.size(); }
+    size_t skipped_count() const { return skipped; }
+    uint64_t capture_duration_ns() const { return capture_ns; }
+    uint64_t replay_cycles() const { return end_tsc.load(std::memory_order_relaxed) - start_tsc; }  // Once done()
+    Pacing mode() const { return pacing; }
+
+    // Free what was never injected and the pool. After the lcores have stopped and released their views
+    void release();
+};
+
+// What lcore_replay needs: where to inject, and whether the frames are feed (A/B multicast) or order stream traffic
+struct ReplayLcoreArgs {
+    class MarketDataHandler* handler;
+    PcapReplay* replay;
+    bool feed;
+};
@@ -1,8 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <cstring>
-#include <x86intrin.h>
+#include "WireSchema.h"
+#include "WireSchemaSimd.h"
 
 // Structure to hold market data message details
 // Using tons of comments because I looked at it the morning after I wrote it and couldn't understand what the hell I was thinking
@@ -10,66 +11,55 @@ struct MarketDataMessage {
     uint64_t timestamp;      // Timestamp of the message - 8 bytes
     uint32_t sequence_number;// Sequence number of the message - 4 bytes
     char message_type;       // Type of the message (single character) - 1 byte
-    char symbol[8];          // Symbol associated with the order (8 characters) - 8 bytes
+    char symbol[8];          // Symbol associated with the order (8 characters, space padded) - 8 bytes
+    char side;               // 'B' for buy, 'S' for sell - 1 byte. Last byte on the wire, but sits in padding here
     uint64_t order_id;       // Unique order identifier - 8 bytes
     uint32_t price;          // Price of the order - 4 bytes
     uint32_t quantity;       // Quantity of the order - 4 bytes
+    uint64_t rx_tsc;         // When we received it, TSC cycles. Local only, not on the wire (decoders leave it zero) - 8 bytes
 };
 
+/* Wire format: packed, little endian, 38 bytes per message
+ * This is NOT the struct layout above: the compiler pads the struct and side moves up into the padding, rx_tsc is ours
+ * The field list is the only place wire offsets are written down, the decoders are all generated from it
+ */
+using MarketDataWireSchema = WireSchema<MarketDataMessage, 38,
+        WIRE_FIELD(MarketDataMessage, timestamp,       0,  Endian::Little),
+        WIRE_FIELD(MarketDataMessage, sequence_number, 8,  Endian::Little),
+        WIRE_FIELD(MarketDataMessage, message_type,    12, Endian::Little),
+        WIRE_FIELD(MarketDataMessage, symbol,          13, Endian::Little),
+        WIRE_FIELD(MarketDataMessage, order_id,        21, Endian::Little),
+        WIRE_FIELD(MarketDataMessage, price,           29, Endian::Little),
+        WIRE_FIELD(MarketDataMessage, quantity,        33, Endian::Little),
+        WIRE_FIELD(MarketDataMessage, side,            37, Endian::Little)>;
+
 // Parser class for converting raw data into a MarketDataMessage
 class SIMDMessageParser {
+private:
+    using BatchDecoder = WireSchemaSimd<MarketDataWireSchema>;
+
 public:
+    static constexpr size_t WIRE_SIZE = MarketDataWireSchema::wire_size;
+
     // Static method to parse raw data into a MarketDataMessage
     static MarketDataMessage parse(const char* data) {
-        MarketDataMessage msg; // Declare a message object to hold the parsed data
-
-        // Extract timestamp from the first 8 bytes
-        msg.timestamp = *reinterpret_cast<const uint64_t*>(data);
-        // Extract sequence number from the next 4 bytes
-        msg.sequence_number = *reinterpret_cast<const uint32_t*>(data + 8);
-        // Extract message type from the next byte
-        msg.message_type = data[12];
-        // Copy the next 8 bytes into the symbol array
-        std::memcpy(msg.symbol, data + 13, 8);
-        // Extract order ID from the next 8 bytes
-        msg.order_id = *reinterpret_cast<const uint64_t*>(data + 21);
-        // Extract price from the next 4 bytes
-        msg.price = *reinterpret_cast<const uint32_t*>(data + 29);
-        // Extract quantity from the next 4 bytes
-        msg.quantity = *reinterpret_cast<const uint32_t*>(data + 33);
-
-        // Return the populated message object
-        return msg;
-
-        /*
-        Alternative implementation using AVX2 instructions for faster processing (commented out)
-
-        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
-
-        // Extract timestamp (64 bits) from the first 8 bytes
-        msg.timestamp = _mm256_extract_epi64(chunk, 0);
-        // Extract sequence number (32 bits) from bytes 8-11
-        msg.sequence_number = _mm256_extract_epi32(chunk, 2);
-        // Extract message type (8 bits) from byte 12
-        msg.message_type = static_cast<char>(_mm256_extract_epi8(chunk, 12));
+        return MarketDataWireSchema::decode(data);
+    }
 
-        // Load 128 bits (16 bytes) of data for the symbol starting at byte 13
-        __m128i symbol_chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 13));
-        // Store the symbol data (8 bytes) into the symbol array
-        _mm_storeu_si128(reinterpret_cast<__m128i*>(msg.symbol), symbol_chunk);
+    // Write a message in wire format, WIRE_SIZE bytes. Used by feed replay and tests of the feed path
+    static void serialize(const MarketDataMessage& msg, char* data) {
+        MarketDataWireSchema::encode(msg, data);
+    }
 
-        // Extract order ID (64 bits) from bytes 21-28
-        msg.order_id = _mm256_extract_epi64(chunk, 3);
-        // Extract price (32 bits) from bytes 29-32
-        msg.price = _mm256_extract_epi32(chunk, 6);
-        // Extract quantity (32 bits) from bytes 33-36
-        msg.quantity = _mm256_extract_epi32(chunk, 7);
+    /* Parse n back-to-back wire messages from buf into out
+     * Whole blocks go through the widest shuffle kernel the CPU supports, picked once from CPUID
+     */
+    static void parse_batch(const char* buf, size_t n, MarketDataMessage* out) {
+        BatchDecoder::decode_batch(buf, n, out);
+    }
 
-        // Return the populated message object
-        return msg;
-        */
+    // Name of the kernel parse_batch uses on this CPU, for the startup log
+    static const char* active_kernel() {
+        return BatchDecoder::active_kernel();
     }
 };
-
-
-
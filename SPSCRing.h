@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/* Single-producer single-consumer ring built for bursts
+ * - Capacity is a power of two and head/tail are free-running counters, so wrapping is a mask and all slots are usable
+ * - head (consumer) and tail (producer) each sit on their own cache line, so the two cores don't false-share
+ * - Each side keeps a cached copy of the other side's index and only re-reads the real one when the cache says
+ *   it's full/empty, so in steady state neither side touches the other's line
+ * - push_bulk/pop_bulk move up to a whole DPDK burst with one index publish
+ */
+template<typename T, size_t Capacity>
+class SPSCRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+    static constexpr size_t CACHE_LINE = 64;
+
+    // Consumer's line: its own index plus its view of the producer's
+    alignas(CACHE_LINE) std::atomic<size_t> head{0};
+    size_t cached_tail = 0;
+
+    // Producer's line
+    alignas(CACHE_LINE) std::atomic<size_t> tail{0};
+    size_t cached_head = 0;
+
+    alignas(CACHE_LINE) std::array<T, Capacity> buffer;
+
+public:
+    /* Push up to n items, returns how many went in (0 if the ring is full)
+     * Items are published together with a single release store
+     */
+    size_t push_bulk(const T* items, size_t n) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t free = Capacity - (t - cached_head);
+        if (free < n) {
+            cached_head = head.load(std::memory_order_acquire);
+            free = Capacity - (t - cached_head);
+            if (free < n) n = free;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            buffer[(t + i) & MASK] = items[i];
+        }
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    /* Pop up to n items into out, returns how many came out (0 if the ring is empty)
+     */
+    size_t pop_bulk(T* out, size_t n) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t available = cached_tail - h;
+        if (available < n) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            available = cached_tail - h;
+            if (available < n) n = available;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = buffer[(h + i) & MASK];
+        }
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    /* Attempt to push an item into the buffer
+     * Returns true if successful, false if the buffer is full
+     */
+    bool push(const T& item) {
+        return push_bulk(&item, 1) == 1;
+    }
+
+    /* Attempt to pop an item from the buffer
+     * Returns true if successful, false if the buffer is empty
+     */
+    bool pop(T& item) {
+        return pop_bulk(&item, 1) == 1;
+    }
+
+    /* Number of items in the ring
+     * Only exact when called from the producer or consumer, from anywhere else it's a snapshot for monitoring
+     */
+    size_t size() const {
+        size_t h = head.load(std::memory_order_acquire); // head first, so a concurrent pop can't make it overtake tail
+        return tail.load(std::memory_order_acquire) - h;
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+};
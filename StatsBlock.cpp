@@ -0,0 +1,94 @@
+#include "StatsBlock.h"
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+StatsPublisher::~StatsPublisher() {
+    if (block) munmap(block, sizeof(StatsBlock));
+}
+
+/* Create (or take over) the segment and zero it
+ * The segment is left behind on exit so the last numbers can still be read, the next run starts it from scratch
+ */
+bool StatsPublisher::open(const char* name) {
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open stats segment " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, sizeof(StatsBlock)) != 0) {
+        std::cerr << "Failed to size stats segment " << name << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    void* mem = mmap(nullptr, sizeof(StatsBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        std::cerr << "Failed to map stats segment " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Touches every page now, so publishing never faults
+    std::memset(mem, 0, sizeof(StatsBlock));
+    block = static_cast<StatsBlock*>(mem);
+    block->magic = STATS_MAGIC;
+    block->version = STATS_VERSION;
+    block->size = sizeof(StatsBlock);
+    return true;
+}
+
+StatsReader::~StatsReader() {
+    if (block) munmap(const_cast<StatsBlock*>(block), sizeof(StatsBlock));
+}
+
+bool StatsReader::open(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "Failed to open stats segment " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(StatsBlock)) {
+        std::cerr << "Stats segment " << name << " is missing or too small, is the handler running?" << std::endl;
+        close(fd);
+        return false;
+    }
+    void* mem = mmap(nullptr, sizeof(StatsBlock), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        std::cerr << "Failed to map stats segment " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    block = static_cast<const StatsBlock*>(mem);
+    if (block->magic != STATS_MAGIC || block->version != STATS_VERSION || block->size != sizeof(StatsBlock)) {
+        std::cerr << "Stats segment " << name << " has a different layout (version " << block->version
+                  << "), rebuild mdp-stat against this handler" << std::endl;
+        munmap(mem, sizeof(StatsBlock));
+        block = nullptr;
+        return false;
+    }
+    return true;
+}
+
+/* Standard seqlock read: even sequence before, copy, same sequence after
+ * The writer publishes a few times a second so a retry is rare, yield between attempts so we don't spin against it
+ */
+bool StatsReader::read(StatsData& out, int max_attempts) const {
+    if (!block) return false;
+    for (int attempt = 0; attempt < max_attempts; ++attempt) {
+        uint64_t before = block->sequence.load(std::memory_order_acquire);
+        if (before == 0) return false;  // Nothing published yet
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        std::memcpy(&out, &block->data, sizeof(StatsData));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block->sequence.load(std::memory_order_relaxed) == before) return true;
+    }
+    return false;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "LatencyHistogram.h"
+
+/* Live stats in a POSIX shared memory segment, for mdp-stat and anything else that wants to watch the handler
+ * One writer (the worker core) publishes with a seqlock: bump the sequence to odd, plain stores, bump to even.
+ * Readers copy the block and retry if the sequence moved or was odd, so the writer never waits on a reader and
+ * never makes a syscall. The block is self-describing (names travel with the numbers), mdp-stat needs no handler headers
+ */
+
+constexpr const char* STATS_SHM_NAME = "/mdp_stats";
+constexpr uint32_t STATS_MAGIC = 0x5350444d;  // "MDPS"
+constexpr uint32_t STATS_VERSION = 2;
+
+constexpr size_t STATS_NAME_LEN = 24;
+constexpr size_t STATS_MAX_MESSAGE_KINDS = 8;
+constexpr size_t STATS_MAX_QUEUES = 64;
+constexpr size_t STATS_MAX_RX_QUEUES = 31;
+constexpr size_t STATS_MAX_LATENCY_SERIES = 4;
+constexpr size_t STATS_MAX_INSTRUMENTS = 256;
+
+struct StatsQueue {
+    char name[STATS_NAME_LEN];
+    uint64_t depth;
+    uint64_t capacity;
+    uint64_t high_water;
+    uint64_t dropped;
+    uint64_t spilled;
+    uint64_t spin_retries;
+};
+
+struct StatsInstrument {
+    char symbol[8];          // Space padded, not NUL terminated
+    uint32_t best_bid;       // 0 if no bids
+    uint32_t best_ask;       // UINT32_MAX if no asks
+};
+
+// Everything under the seqlock. Latency buckets are in TSC cycles, tsc_hz converts them
+struct StatsData {
+    uint64_t publish_tsc;
+    uint64_t tsc_hz;
+
+    uint64_t processed_messages;
+    uint64_t zero_copy_messages;
+    uint64_t copied_messages;
+    uint64_t unknown_symbol_messages;
+
+    uint32_t message_kind_count;
+    char message_kind_names[STATS_MAX_MESSAGE_KINDS][STATS_NAME_LEN];
+    uint64_t message_kind_counts[STATS_MAX_MESSAGE_KINDS];
+
+    uint32_t queue_count;
+    StatsQueue queues[STATS_MAX_QUEUES];
+
+    uint32_t rx_queue_count;
+    uint64_t rx_queue_packets[STATS_MAX_RX_QUEUES];  // Packets polled per NIC RX queue
+
+    uint32_t latency_series_count;
+    char latency_names[STATS_MAX_LATENCY_SERIES][STATS_NAME_LEN];
+    uint64_t latency_buckets[STATS_MAX_LATENCY_SERIES][LatencyHistogram::BUCKET_COUNT];
+
+    uint32_t instrument_count;
+    StatsInstrument instruments[STATS_MAX_INSTRUMENTS];
+};
+
+struct StatsBlock {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;                                  // sizeof(StatsBlock) of the writer, readers check it matches theirs
+    alignas(64) std::atomic<uint64_t> sequence;     // Odd while a publish is in progress
+    alignas(64) StatsData data;
+};
+
+/* Writer side. open() does all the syscalls (shm_open, ftruncate, mmap) and touches every page, so the worker
+ * never page-faults or enters the kernel when it publishes
+ */
+class StatsPublisher {
+private:
+    StatsBlock* block = nullptr;
+
+public:
+    StatsPublisher() = default;
+    StatsPublisher(const StatsPublisher&) = delete;
+    StatsPublisher& operator=(const StatsPublisher&) = delete;
+    ~StatsPublisher();
+
+    bool open(const char* name = STATS_SHM_NAME);
+    bool is_open() const { return block != nullptr; }
+
+    // Start a publish, fill in the returned data with plain stores, then commit()
+    StatsData& begin() {
+        uint64_t seq = block->sequence.load(std::memory_order_relaxed);
+        block->sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return block->data;
+    }
+
+    void commit() {
+        uint64_t seq = block->sequence.load(std::memory_order_relaxed);
+        block->sequence.store(seq + 1, std::memory_order_release);
+    }
+};
+
+// Reader side, for monitoring processes. Never writes to the segment
+class StatsReader {
+private:
+    const StatsBlock* block = nullptr;
+
+public:
+    StatsReader() = default;
+    StatsReader(const StatsReader&) = delete;
+    StatsReader& operator=(const StatsReader&) = delete;
+    ~StatsReader();
+
+    bool open(const char* name = STATS_SHM_NAME);
+
+    /* Consistent copy of the published data into out
+     * False if the writer hasn't published yet or kept the block busy for every attempt
+     */
+    bool read(StatsData& out, int max_attempts = 1000) const;
+};
@@ -1,45 +1,257 @@
 #include "TCPIPStack.h"
 #include <algorithm>
+#include <cstring>
+
+namespace {
+    uint16_t load_be16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+    uint32_t load_be32(const uint8_t* p) {
+        return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | p[3];
+    }
+    void store_be16(uint8_t* p, uint16_t v) { p[0] = static_cast<uint8_t>(v >> 8); p[1] = static_cast<uint8_t>(v); }
+    void store_be32(uint8_t* p, uint32_t v) { store_be16(p, static_cast<uint16_t>(v >> 16)); store_be16(p + 2, static_cast<uint16_t>(v)); }
+
+    // Sum of the big endian 16-bit words, odd length padded with a zero byte. Not folded
+    uint32_t word_sum(const uint8_t* data, size_t len) {
+        uint32_t sum = 0;
+        size_t i = 0;
+        for (; i + 1 < len; i += 2) sum += load_be16(data + i);
+        if (i < len) sum += uint32_t{data[i]} << 8;
+        return sum;
+    }
+
+    uint16_t fold(uint64_t sum) {
+        while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+        return static_cast<uint16_t>(sum);
+    }
+
+    void bump(std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    constexpr size_t VLAN_TAG_LEN = 4;
+    constexpr uint16_t ETHER_TYPE_IPV4 = 0x0800;
+    constexpr uint16_t ETHER_TYPE_VLAN = 0x8100;
+    constexpr uint8_t IP_PROTO_TCP = 6;
+    constexpr uint8_t IP_TTL = 64;
+    constexpr uint16_t IP_DONT_FRAGMENT = 0x4000;
+}
 
 // Constructor for TCPConnection initializes remote and local IP and ports and sets sequence numbers to 0
+// The receive ring is the connection's only allocation, nothing is allocated per segment
 TCPConnection::TCPConnection(uint32_t rip, uint16_t rport, uint32_t lip, uint16_t lport)
-        : remote_ip(rip), remote_port(rport), local_ip(lip), local_port(lport), next_seq_num(0), next_ack_num(0) {}
-
-// Process an incoming packet for this connection
-void TCPConnection::process_packet(const TCPHeader& tcp_header, const uint8_t* data, size_t len) {
-    // Update the acknowledgment number to the next expected sequence number
-    next_ack_num = tcp_header.seq_num + len;
-    // If the packet contains data, store it
-    if (len > 0) {
-        received_data.push(std::vector<uint8_t>(data, data + len));
-    }
-}
-
-// Create a TCP packet with the given data
-std::vector<uint8_t> TCPConnection::create_packet(const uint8_t* data, size_t len) {
-    // Allocate space for the TCP header and the data
-    std::vector<uint8_t> packet(sizeof(TCPHeader) + len);
-    // Pointer to the TCP header portion of the packet
-    TCPHeader* header = reinterpret_cast<TCPHeader*>(packet.data());
-    // Fill in the TCP header fields
-    header->src_port = local_port;
-    header->dest_port = remote_port;
-    header->seq_num = next_seq_num;
-    header->ack_num = next_ack_num;
-
-    // Copy the data into the packet after the header
-    std::copy(data, data + len, packet.begin() + sizeof(TCPHeader));
+        : remote_ip(rip), remote_port(rport), local_ip(lip), local_port(lport), next_seq_num(0), next_ack_num(0),
+          read_seq(0), ring(std::make_unique_for_overwrite<uint8_t[]>(RING_SIZE)) {}
+
+// Copy len bytes of the stream starting at seq into the ring, wrapping at the end
+void TCPConnection::copy_in(uint32_t seq, const uint8_t* data, size_t len) {
+    size_t offset = seq & (RING_SIZE - 1);
+    size_t first = std::min(len, RING_SIZE - offset);
+    std::memcpy(ring.get() + offset, data, first);
+    std::memcpy(ring.get(), data + first, len - first);
+}
+
+void TCPConnection::copy_out(uint32_t seq, uint8_t* out, size_t len) const {
+    size_t offset = seq & (RING_SIZE - 1);
+    size_t first = std::min(len, RING_SIZE - offset);
+    std::memcpy(out, ring.get() + offset, first);
+    std::memcpy(out + first, ring.get(), len - first);
+}
+
+/* Add [begin, end) to the out of order ranges, merging it with any it overlaps or touches
+ * False if that would need more than MAX_OUT_OF_ORDER_RANGES ranges, the segment is then dropped
+ */
+bool TCPConnection::hold_out_of_order(uint32_t begin, uint32_t end) {
+    SeqRange merged{begin, end};
+    SeqRange result[MAX_OUT_OF_ORDER_RANGES + 1];
+    size_t count = 0;
+    bool placed = false;
+    for (size_t i = 0; i < out_of_order_count; ++i) {
+        const SeqRange& range = out_of_order[i];
+        if (seq_diff(range.end, merged.begin) > 0) {
+            result[count++] = range;            // Entirely before
+        } else if (placed || seq_diff(merged.end, range.begin) > 0) {
+            if (!placed) result[count++] = merged;
+            placed = true;
+            result[count++] = range;            // Entirely after
+        } else {
+            if (seq_diff(range.begin, merged.begin) > 0) merged.begin = range.begin;
+            if (seq_diff(range.end, merged.end) < 0) merged.end = range.end;
+        }
+    }
+    if (!placed) result[count++] = merged;
+    if (count > MAX_OUT_OF_ORDER_RANGES) return false;
+    std::copy(result, result + count, out_of_order);
+    out_of_order_count = count;
+    return true;
+}
+
+// Pull next_ack_num forward over any out of order ranges the new in-order data reached
+void TCPConnection::advance_ack() {
+    size_t merged = 0;
+    while (merged < out_of_order_count && seq_diff(next_ack_num, out_of_order[merged].begin) <= 0) {
+        if (seq_diff(next_ack_num, out_of_order[merged].end) > 0) next_ack_num = out_of_order[merged].end;
+        ++merged;
+    }
+    if (merged > 0) {
+        std::copy(out_of_order + merged, out_of_order + out_of_order_count, out_of_order);
+        out_of_order_count -= merged;
+    }
+}
+
+/* No handshake here: a SYN starts the stream at its first data byte, otherwise the first data we see does
+ * (joining a connection that is already up). False for a segment that can't start one, a bare ACK
+ */
+bool TCPConnection::sync(const TCPSegment& segment) {
+    if (segment.payload_len == 0 && !(segment.flags & TCP_FLAG_SYN)) return false;
+    synced = true;
+    next_ack_num = read_seq = segment.seq_num;
+    return true;
+}
+
+/* Process an incoming segment
+ * Bytes we already have are trimmed off the front, bytes past the receive window off the back
+ * In-order data extends next_ack_num, anything past a hole is written to its slot and remembered as a range
+ */
+void TCPConnection::process_packet(const TCPSegment& segment, TCPReassemblyStats& stats) {
+    if (!synced && !sync(segment)) return;
+    size_t len = segment.payload_len;
+    if (len == 0) return;
+    const uint8_t* data = segment.payload;
+
+    uint32_t begin = segment.seq_num;
+    uint32_t end = begin + static_cast<uint32_t>(len);
+    if (seq_diff(next_ack_num, end) <= 0) {
+        bump(stats.duplicate_segments);
+        return;
+    }
+    if (seq_diff(next_ack_num, begin) < 0) {
+        data += next_ack_num - begin;
+        begin = next_ack_num;
+    }
+    uint32_t window_end = read_seq + static_cast<uint32_t>(RING_SIZE);
+    if (seq_diff(window_end, begin) >= 0) {
+        bump(stats.dropped_segments);
+        return;
+    }
+    if (seq_diff(window_end, end) > 0) end = window_end;
+
+    if (begin == next_ack_num) {
+        copy_in(begin, data, end - begin);
+        next_ack_num = end;
+        advance_ack();
+        return;
+    }
+    if (!hold_out_of_order(begin, end)) {
+        bump(stats.dropped_segments);
+        return;
+    }
+    copy_in(begin, data, end - begin);
+    bump(stats.out_of_order_segments);
+}
+
+// Fast path for the common case, see the header. Falls back to process_packet for everything it can't take in place
+size_t TCPConnection::consume_in_place(const TCPSegment& segment, TCPReassemblyStats& stats) {
+    if (!synced && !sync(segment)) return 0;
+    size_t len = segment.payload_len;
+    if (len == 0) return 0;
+    if (segment.seq_num != next_ack_num || read_seq != next_ack_num || out_of_order_count != 0) {
+        process_packet(segment, stats);
+        return 0;
+    }
+
+    size_t whole = whole_frames_length(segment.payload, len);
+    next_ack_num += static_cast<uint32_t>(whole);
+    read_seq = next_ack_num;
+    if (whole < len) {
+        TCPSegment rest = segment;
+        rest.seq_num = next_ack_num;
+        rest.payload += whole;
+        rest.payload_len -= whole;
+        process_packet(rest, stats);
+    }
+    return whole;
+}
+
+void TCPConnection::write_fixed_header(uint8_t* tcp) const {
+    store_be16(tcp, local_port);
+    store_be16(tcp + 2, remote_port);
+    tcp[12] = (TCPIPStack::TCP_HEADER_LEN / 4) << 4;   // Data offset in 32-bit words
+    tcp[13] = TCP_FLAG_PSH | TCP_FLAG_ACK;
+    store_be16(tcp + 16, 0);                            // Checksum, filled in by the stack or the NIC
+    store_be16(tcp + 18, 0);                            // Urgent pointer
+}
+
+// The window we advertise is the free space in the receive ring
+void TCPConnection::stamp_header(uint8_t* tcp, size_t stream_len) {
+    size_t window = RING_SIZE - (next_ack_num - read_seq);
+    store_be32(tcp + 4, next_seq_num);
+    store_be32(tcp + 8, next_ack_num);
+    store_be16(tcp + 14, static_cast<uint16_t>(std::min<size_t>(window, UINT16_MAX)));
     // Update the sequence number for the next packet to send
-    next_seq_num += len;
-    return packet;
+    next_seq_num += static_cast<uint32_t>(stream_len);
 }
 
-// Retrieve the next chunk of received data
-std::vector<uint8_t> TCPConnection::get_data() {
-    if (received_data.empty()) return {};
-    auto data = std::move(received_data.front());
-    received_data.pop();
-    return data;
+/* Copy the next complete message out of the ring
+ * A message the caller can't take (or that could never fit in the window) is skipped by moving read_seq past it.
+ * If that is past what we have received, next_ack_num moves too, so its remaining bytes are trimmed as they arrive
+ */
+size_t TCPConnection::get_message(uint8_t* out, size_t capacity, TCPReassemblyStats& stats) {
+    while (true) {
+        size_t available = next_ack_num - read_seq;
+        if (available < FRAME_HEADER_LEN) return 0;
+        uint8_t prefix[FRAME_HEADER_LEN];
+        copy_out(read_seq, prefix, FRAME_HEADER_LEN);
+        size_t len = frame_payload_length(prefix);
+        size_t frame = FRAME_HEADER_LEN + len;
+
+        if (len <= capacity && frame <= RING_SIZE) {
+            if (available < frame) return 0;
+            copy_out(read_seq + FRAME_HEADER_LEN, out, len);
+            read_seq += static_cast<uint32_t>(frame);
+            if (len > 0) return len;
+            continue;  // Empty frame, nothing to hand out
+        }
+
+        bump(stats.oversized_messages);
+        read_seq += static_cast<uint32_t>(frame);
+        if (seq_diff(next_ack_num, read_seq) > 0) {
+            next_ack_num = read_seq;
+            // Out of order ranges inside the skipped message are gone, one straddling its end is cut short
+            size_t keep = 0;
+            for (size_t i = 0; i < out_of_order_count; ++i) {
+                SeqRange range = out_of_order[i];
+                if (seq_diff(read_seq, range.end) <= 0) continue;
+                if (seq_diff(read_seq, range.begin) < 0) range.begin = read_seq;
+                out_of_order[keep++] = range;
+            }
+            out_of_order_count = keep;
+            advance_ack();
+        }
+    }
+}
+
+bool TCPConnection::has_message() const {
+    size_t available = next_ack_num - read_seq;
+    if (available < FRAME_HEADER_LEN) return false;
+    uint8_t prefix[FRAME_HEADER_LEN];
+    copy_out(read_seq, prefix, FRAME_HEADER_LEN);
+    size_t frame = FRAME_HEADER_LEN + frame_payload_length(prefix);
+    return frame > RING_SIZE || available >= frame;
+}
+
+size_t whole_frames_length(const uint8_t* data, size_t len) {
+    size_t offset = 0;
+    while (offset + FRAME_HEADER_LEN <= len) {
+        size_t frame = FRAME_HEADER_LEN + frame_payload_length(data + offset);
+        if (offset + frame > len) break;
+        offset += frame;
+    }
+    return offset;
+}
+
+TCPIPStack::TCPIPStack(size_t max_connections)
+        : connection_ids(max_connections), max_connections(max_connections) {
+    connections.reserve(max_connections);
 }
 
 // Generate a unique key for a connection based on the IP and port
@@ -47,82 +259,242 @@ uint64_t TCPIPStack::get_connection_key(uint32_t ip, uint16_t port) {
     return (static_cast<uint64_t>(ip) << 16) | port;
 }
 
+/* Header walk straight off the frame bytes, nothing is copied
+ * IPv4 total length bounds the payload, so the padding on minimum size Ethernet frames never reaches the stream
+ */
+bool TCPIPStack::parse_frame(const uint8_t* frame, size_t len, TCPSegment& segment) {
+    if (len < ETHER_HEADER_LEN) {
+        bump(reassembly_stats.malformed_packets);
+        return false;
+    }
+    size_t offset = ETHER_HEADER_LEN;
+    uint16_t ether_type = load_be16(frame + 12);
+    if (ether_type == ETHER_TYPE_VLAN) {
+        if (len < ETHER_HEADER_LEN + VLAN_TAG_LEN) {
+            bump(reassembly_stats.malformed_packets);
+            return false;
+        }
+        ether_type = load_be16(frame + 16);
+        offset += VLAN_TAG_LEN;
+    }
+    if (ether_type != ETHER_TYPE_IPV4) {
+        bump(reassembly_stats.non_tcp_packets);
+        return false;
+    }
+
+    const uint8_t* ip = frame + offset;
+    if (len - offset < IPV4_HEADER_LEN || (ip[0] >> 4) != 4) {
+        bump(reassembly_stats.malformed_packets);
+        return false;
+    }
+    size_t ip_header_len = static_cast<size_t>(ip[0] & 0x0F) * 4;
+    size_t ip_total_len = load_be16(ip + 2);
+    if (ip_header_len < IPV4_HEADER_LEN || ip_total_len < ip_header_len || ip_total_len > len - offset) {
+        bump(reassembly_stats.malformed_packets);
+        return false;
+    }
+    if (ip[9] != IP_PROTO_TCP || (load_be16(ip + 6) & 0x3FFF)) {  // Not TCP, or a fragment
+        bump(reassembly_stats.non_tcp_packets);
+        return false;
+    }
+
+    const uint8_t* tcp = ip + ip_header_len;
+    size_t tcp_len = ip_total_len - ip_header_len;
+    size_t tcp_header_len = tcp_len >= TCP_HEADER_LEN ? static_cast<size_t>(tcp[12] >> 4) * 4 : 0;
+    if (tcp_header_len < TCP_HEADER_LEN || tcp_header_len > tcp_len) {
+        bump(reassembly_stats.malformed_packets);
+        return false;
+    }
+
+    segment.src_ip = load_be32(ip + 12);
+    segment.dest_ip = load_be32(ip + 16);
+    segment.src_port = load_be16(tcp);
+    segment.dest_port = load_be16(tcp + 2);
+    segment.flags = tcp[13];
+    segment.seq_num = load_be32(tcp + 4) + ((segment.flags & TCP_FLAG_SYN) ? 1 : 0);
+    segment.ack_num = load_be32(tcp + 8);
+    segment.payload = tcp + tcp_header_len;
+    segment.payload_len = tcp_len - tcp_header_len;
+    return true;
+}
+
 // Process an incoming network packet
 void TCPIPStack::process_packet(const uint8_t* data, size_t len) {
-    if (len < sizeof(IPHeader) + sizeof(TCPHeader)) return; // Ignore packets that are too small
+    TCPSegment segment;
+    if (!parse_frame(data, len, segment)) return;
 
-    // Interpret the beginning of the data as IP and TCP headers
-    const IPHeader* ip_header = reinterpret_cast<const IPHeader*>(data);
-    const TCPHeader* tcp_header = reinterpret_cast<const TCPHeader*>(data + sizeof(IPHeader));
+    // Process the TCP segment using the appropriate connection
+    uint32_t id = connection_for(segment);
+    if (id == NO_CONNECTION) return;
+    connections[id].process_packet(segment, reassembly_stats);
+    mark_ready(id);
+}
 
-    // Generate a key for the connection based on the source IP and port
-    uint64_t conn_key = get_connection_key(ip_header->src_ip, tcp_header->src_port);
-    auto it = connections.find(conn_key);
-    if (it == connections.end()) {
-        // If the connection does not exist, create a new one
-        connections.emplace(std::piecewise_construct,
-                            std::forward_as_tuple(conn_key),
-                            std::forward_as_tuple(ip_header->src_ip, tcp_header->src_port, ip_header->dest_ip, tcp_header->dest_port));
-        it = connections.find(conn_key);
+// Zero-copy variant of process_packet: same header handling, but whole messages that continue the stream stay where they are
+size_t TCPIPStack::locate_payload(const uint8_t* data, size_t len, const uint8_t** payload) {
+    TCPSegment segment;
+    if (!parse_frame(data, len, segment)) return 0;
+
+    uint32_t id = connection_for(segment);
+    if (id == NO_CONNECTION) return 0;
+    *payload = segment.payload;
+    size_t in_place = connections[id].consume_in_place(segment, reassembly_stats);
+    mark_ready(id);
+    return in_place;
+}
+
+// Look the key up in the connection table, adding the connection if it's new and there is room
+uint32_t TCPIPStack::connection_id(uint64_t key, uint32_t remote_ip, uint16_t remote_port, uint32_t local_ip, uint16_t local_port) {
+    uint32_t id = connection_ids.find(key);
+    if (id != FlatHashIndex::NOT_FOUND) return id;
+    if (connections.size() >= max_connections) {
+        bump(reassembly_stats.table_full_segments);
+        return NO_CONNECTION;
     }
+    id = static_cast<uint32_t>(connections.size());
+    connections.emplace_back(remote_ip, remote_port, local_ip, local_port);
+    connection_ids.insert(key, id);
+    return id;
+}
+
+// Connection for an incoming segment, keyed by its source IP and port
+uint32_t TCPIPStack::connection_for(const TCPSegment& segment) {
+    return connection_id(get_connection_key(segment.src_ip, segment.src_port),
+                         segment.src_ip, segment.src_port, segment.dest_ip, segment.dest_port);
+}
 
-    // Process the TCP packet using the appropriate connection
-    it->second.process_packet(*tcp_header, data + sizeof(IPHeader) + sizeof(TCPHeader),
-                              len - sizeof(IPHeader) - sizeof(TCPHeader));
+void TCPIPStack::mark_ready(uint32_t id) {
+    TCPConnection& conn = connections[id];
+    if (conn.ready || !conn.has_message()) return;
+    conn.ready = true;
+    conn.next_ready = NO_CONNECTION;
+    if (ready_tail == NO_CONNECTION) ready_head = id;
+    else connections[ready_tail].next_ready = id;
+    ready_tail = id;
 }
 
-// Create a TCP packet to send to a remote host
-std::vector<uint8_t> TCPIPStack::create_packet(uint32_t dest_ip, uint16_t dest_port, const uint8_t* data, size_t len) {
+/* Ethernet and IPv4 headers here, the fixed TCP header fields from the connection
+ * Sent frames carry no IP or TCP options, so every header field is at a fixed offset
+ */
+bool TCPIPStack::build_template(uint32_t dest_ip, uint16_t dest_port, FrameTemplate& tmpl) {
     // Generate a key for the connection based on the destination IP and port
-    uint64_t conn_key = get_connection_key(dest_ip, dest_port);
-    auto it = connections.find(conn_key);
-    if (it == connections.end()) {
-        // If the connection does not exist, create a new one
-        connections.emplace(std::piecewise_construct,
-                            std::forward_as_tuple(conn_key),
-                            std::forward_as_tuple(dest_ip, dest_port, 0, 0));  // Use appropriate local IP and port
-        it = connections.find(conn_key);
-    }
-
-    // Create a TCP packet using the connection
-    std::vector<uint8_t> tcp_packet = it->second.create_packet(data, len);
-    // Allocate space for the IP header and the TCP packet
-    std::vector<uint8_t> ip_packet(sizeof(IPHeader) + tcp_packet.size());
-
-    // Pointer to the IP header portion of the packet
-    IPHeader* ip_header = reinterpret_cast<IPHeader*>(ip_packet.data());
-    // Fill in the IP header fields
-    ip_header->src_ip = 0;  // Use appropriate local IP
-    ip_header->dest_ip = dest_ip;
-    ip_header->protocol = 6;  // TCP
-    // Set other IP header fields as needed
-
-    // Copy the TCP packet into the IP packet after the header
-    std::copy(tcp_packet.begin(), tcp_packet.end(), ip_packet.begin() + sizeof(IPHeader));
-    return ip_packet;
-}
-
-// Retrieve the next available message from any connection
-std::vector<uint8_t> TCPIPStack::get_next_message() {
-    for (auto& conn : connections) {
-        if (conn.second.has_data()) {
-            return conn.second.get_data();
-        }
+    uint32_t id = connection_id(get_connection_key(dest_ip, dest_port), dest_ip, dest_port, link.local_ip, link.local_port);
+    if (id == NO_CONNECTION) return false;
+    tmpl.connection = id;
+
+    uint8_t* frame = tmpl.headers;
+    std::memcpy(frame, link.next_hop_mac, 6);
+    std::memcpy(frame + 6, link.local_mac, 6);
+    store_be16(frame + 12, ETHER_TYPE_IPV4);
+
+    uint8_t* ip = frame + ETHER_HEADER_LEN;
+    ip[0] = 0x45;                                   // Version 4, 5 words of header
+    ip[1] = 0;                                      // DSCP/ECN
+    store_be16(ip + 2, 0);                          // Total length, per frame
+    store_be16(ip + 4, 0);                          // Identification, per frame
+    store_be16(ip + 6, IP_DONT_FRAGMENT);
+    ip[8] = IP_TTL;
+    ip[9] = IP_PROTO_TCP;
+    store_be16(ip + 10, 0);                         // Checksum, per frame
+    store_be32(ip + 12, link.local_ip);
+    store_be32(ip + 16, dest_ip);
+
+    uint8_t* tcp = ip + IPV4_HEADER_LEN;
+    std::memset(tcp, 0, TCP_HEADER_LEN);
+    connections[id].write_fixed_header(tcp);
+
+    // Per frame fields are zero here, so these are exactly the fixed words' share of each checksum
+    tmpl.ip_sum = word_sum(ip, IPV4_HEADER_LEN);
+    tmpl.pseudo_sum = pseudo_header_sum(link.local_ip, dest_ip, IP_PROTO_TCP, 0);
+    tmpl.tcp_sum = word_sum(tcp, TCP_HEADER_LEN);
+    return true;
+}
+
+/* One 54-byte copy for the headers, then a handful of stores
+ * Software checksums only have to sum the per-frame words and the message, the template carries the rest
+ */
+size_t TCPIPStack::seal_frame(const FrameTemplate& tmpl, uint8_t* frame, size_t len, ChecksumMode checksums) {
+    size_t tcp_len = TCP_HEADER_LEN + FRAME_HEADER_LEN + len;
+    size_t ip_total_len = IPV4_HEADER_LEN + tcp_len;
+    if (len > MAX_MESSAGE_SIZE || ip_total_len > UINT16_MAX) return 0;
+
+    std::memcpy(frame, tmpl.headers, HEADERS_LEN);
+    uint8_t* ip = frame + ETHER_HEADER_LEN;
+    uint8_t* tcp = ip + IPV4_HEADER_LEN;
+    uint16_t ip_id = next_ip_id++;
+    store_be16(ip + 2, static_cast<uint16_t>(ip_total_len));
+    store_be16(ip + 4, ip_id);
+    connections[tmpl.connection].stamp_header(tcp, FRAME_HEADER_LEN + len);
+    tcp[TCP_HEADER_LEN] = static_cast<uint8_t>(len);           // Length prefix, the message is already behind it
+    tcp[TCP_HEADER_LEN + 1] = static_cast<uint8_t>(len >> 8);
+
+    uint32_t pseudo = tmpl.pseudo_sum + static_cast<uint32_t>(tcp_len);
+    if (checksums == ChecksumMode::Software) {
+        store_be16(ip + 10, static_cast<uint16_t>(~fold(tmpl.ip_sum + static_cast<uint32_t>(ip_total_len) + ip_id)));
+        // Sequence, ack and window words, then the length prefix and message
+        uint32_t stamped = word_sum(tcp + 4, 8) + load_be16(tcp + 14);
+        store_be16(tcp + 16, internet_checksum(tcp + TCP_HEADER_LEN, FRAME_HEADER_LEN + len, pseudo + tmpl.tcp_sum + stamped));
+    } else {
+        // The NIC adds the segment to the seed and complements it, the IPv4 checksum stays zero
+        store_be16(tcp + 16, fold(pseudo));
     }
-    return {};
+    return ETHER_HEADER_LEN + ip_total_len;
+}
+
+size_t TCPIPStack::write_packet(uint8_t* frame, size_t capacity, uint32_t dest_ip, uint16_t dest_port,
+                                const uint8_t* data, size_t len, ChecksumMode checksums) {
+    if (len > MAX_MESSAGE_SIZE || PAYLOAD_OFFSET + len > capacity) return 0;
+    FrameTemplate tmpl;
+    if (!build_template(dest_ip, dest_port, tmpl)) return 0;
+    std::memcpy(frame + PAYLOAD_OFFSET, data, len);
+    return seal_frame(tmpl, frame, len, checksums);
+}
+
+uint16_t TCPIPStack::internet_checksum(const uint8_t* data, size_t len, uint32_t partial) {
+    return static_cast<uint16_t>(~fold(uint64_t{partial} + word_sum(data, len)));
 }
 
+uint32_t TCPIPStack::pseudo_header_sum(uint32_t src_ip, uint32_t dest_ip, uint8_t protocol, size_t length) {
+    return (src_ip >> 16) + (src_ip & 0xFFFF) + (dest_ip >> 16) + (dest_ip & 0xFFFF) + protocol + static_cast<uint32_t>(length);
+}
+
+/* Copy the next complete message from the head of the ready list into out
+ * The connection is unlinked first and goes back on the tail if it still has a message, so busy connections take turns
+ */
+size_t TCPIPStack::get_next_message(uint8_t* out, size_t capacity) {
+    while (ready_head != NO_CONNECTION) {
+        uint32_t id = ready_head;
+        TCPConnection& conn = connections[id];
+        ready_head = conn.next_ready;
+        if (ready_head == NO_CONNECTION) ready_tail = NO_CONNECTION;
+        conn.ready = false;
+
+        size_t len = conn.get_message(out, capacity, reassembly_stats);
+        mark_ready(id);
+        if (len > 0) return len;
+    }
+    return 0;
+}
 
 /*
  * TCPConnection
 Constructor: Initializes a TCP connection with given remote and local IP addresses and ports.
-process_packet: Handles incoming packets by updating acknowledgment numbers and storing any received data.
-create_packet: Constructs a TCP packet with the provided data and updates the sequence number.
-get_data: Retrieves the next chunk of data that was received.
+process_packet: Reassembles incoming segments into the connection's receive ring, in order or not.
+consume_in_place: Takes in-order segments that start on a message boundary without copying them.
+write_fixed_header: Writes the TCP header fields that are the same in every segment of the connection.
+stamp_header: Writes the per-segment TCP header fields and updates the sequence number.
+has_message: Checks whether a whole message (or one that has to be skipped) is buffered.
+get_message: Copies the next complete message out of the receive ring.
 TCPIPStack
 get_connection_key: Generates a unique key for a connection based on the IP address and port, used to identify connections.
+connection_id: Finds a connection's id in the flat table, adding the connection on first contact if there is room.
+mark_ready: Links a connection onto the ready list when it has a whole message buffered.
+parse_frame: Walks the Ethernet/IPv4/TCP headers of a received frame in place.
 process_packet: Processes incoming network packets by extracting headers, finding the corresponding connection, and delegating packet processing to the connection.
-create_packet: Creates a TCP packet to send to a remote host, including both TCP and IP headers.
-get_next_message: Retrieves the next available message from any connection, if there is data to be read.
+build_template: Prebuilds a connection's Ethernet, IPv4 and TCP headers and the fixed part of their checksums.
+seal_frame: Completes a frame around a message the caller wrote in place, with software or offloaded checksums.
+write_packet: Copies a message into a caller buffer and seals it, for callers without a template.
+internet_checksum/pseudo_header_sum: RFC 1071 checksum and the IPv4 pseudo-header sum for TCP.
+get_next_message: Copies the next message from the connection at the head of the ready list into the caller's buffer.
 
  */
\ No newline at end of file
@@ -1,78 +1,258 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <unordered_map>
+#include <memory>
 #include <vector>
-#include <queue>
-
-// Structure to hold IP header information
-// Lots of comments for my personal study
-struct IPHeader {
-    uint32_t src_ip;     // Source IP address
-    uint32_t dest_ip;    // Destination IP address
-    uint8_t protocol;    // Protocol type (e.g., TCP)
+#include "FlatHashIndex.h"
+
+// The fields of an Ethernet/IPv4/TCP frame the stack uses, host byte order. Parsed in place, payload points into the frame
+struct TCPSegment {
+    uint32_t src_ip;            // Source IP address
+    uint32_t dest_ip;           // Destination IP address
+    uint16_t src_port;          // Source port number
+    uint16_t dest_port;         // Destination port number
+    uint32_t seq_num;           // Stream position of the first payload byte (one past the SYN's own sequence number)
+    uint32_t ack_num;           // Acknowledgment number
+    uint8_t flags;              // TCP_FLAG_* bits
+    const uint8_t* payload;
+    size_t payload_len;         // Up to the IPv4 total length, Ethernet padding is not payload
 };
 
-// Structure to hold TCP header information
-struct TCPHeader {
-    uint16_t src_port;   // Source port number
-    uint16_t dest_port;  // Destination port number
-    uint32_t seq_num;    // Sequence number
-    uint32_t ack_num;    // Acknowledgment number
+constexpr uint8_t TCP_FLAG_FIN = 0x01;
+constexpr uint8_t TCP_FLAG_SYN = 0x02;
+constexpr uint8_t TCP_FLAG_RST = 0x04;
+constexpr uint8_t TCP_FLAG_PSH = 0x08;
+constexpr uint8_t TCP_FLAG_ACK = 0x10;
+
+/* Addresses stamped into every frame a stack sends. MACs in wire order, IP and port in host order
+ * There is no ARP: next_hop_mac is the gateway's, or the peer's when it is on the same segment
+ */
+struct LinkConfig {
+    uint8_t local_mac[6];
+    uint8_t next_hop_mac[6];
+    uint32_t local_ip;
+    uint16_t local_port;
+};
+
+/* Who fills in the IPv4 and TCP checksums of a sent frame
+ * Offload leaves the IPv4 checksum zero and the TCP one seeded with the pseudo-header sum, which is what the NIC
+ * expects with RTE_MBUF_F_TX_IP_CKSUM | RTE_MBUF_F_TX_TCP_CKSUM set on the mbuf
+ */
+enum class ChecksumMode : uint8_t { Software, Offload };
+
+/* Messages on the stream are length prefixed: a little endian uint16_t payload length, then the payload
+ * A message can be split across segments and a segment can carry several, reassembly takes care of both
+ */
+constexpr size_t FRAME_HEADER_LEN = sizeof(uint16_t);
+constexpr size_t MAX_MESSAGE_SIZE = UINT16_MAX;
+
+// Payload length from the prefix of the frame starting at frame
+inline size_t frame_payload_length(const uint8_t* frame) {
+    return frame[0] | (size_t{frame[1]} << 8);
+}
+
+// Reassembly counters for every connection of a stack. Written by the owning RX core only
+struct TCPReassemblyStats {
+    std::atomic<uint64_t> out_of_order_segments{0};  // Held until the bytes before them arrived
+    std::atomic<uint64_t> duplicate_segments{0};     // Retransmits of bytes we already had
+    std::atomic<uint64_t> dropped_segments{0};       // Beyond the receive window or too many holes, the sender has to retransmit
+    std::atomic<uint64_t> oversized_messages{0};     // Longer than the caller's buffer, skipped
+    std::atomic<uint64_t> table_full_segments{0};    // From a new connection when the connection table was full
+    std::atomic<uint64_t> non_tcp_packets{0};        // Not IPv4/TCP, or an IP fragment
+    std::atomic<uint64_t> malformed_packets{0};      // Truncated, or header lengths that don't add up
 };
 
 // Class representing a TCP connection
 class TCPConnection {
+public:
+    static constexpr size_t RING_SIZE = 1 << 16;         // Receive window, power of two so seq & (RING_SIZE - 1) is the slot
+    static constexpr size_t MAX_OUT_OF_ORDER_RANGES = 8; // Holes we track past next_ack_num
+
 private:
+    struct SeqRange {
+        uint32_t begin;
+        uint32_t end;
+    };
+
     uint32_t remote_ip;          // Remote IP address
     uint16_t remote_port;        // Remote port number
     uint32_t local_ip;           // Local IP address
     uint16_t local_port;         // Local port number
     uint32_t next_seq_num;       // Next sequence number to use
-    uint32_t next_ack_num;       // Next acknowledgment number to send
-    std::queue<std::vector<uint8_t>> received_data; // Queue of received data packets
+    uint32_t next_ack_num;       // Next acknowledgment number to send, everything before it is in the ring
+    uint32_t read_seq;           // Stream position of the first byte not yet handed out as a message
+    bool synced = false;         // Seen the first segment, the sequence numbers above are meaningful
+
+    /* Receive ring indexed by stream position, allocated once with the connection
+     * Bytes from read_seq to next_ack_num are in order. Out of order segments are written straight to their slot
+     * and their ranges kept in out_of_order, so nothing is copied twice when the hole fills
+     */
+    std::unique_ptr<uint8_t[]> ring;
+    SeqRange out_of_order[MAX_OUT_OF_ORDER_RANGES];  // Sorted, disjoint, all past next_ack_num
+    size_t out_of_order_count = 0;
+
+    // Intrusive link in the stack's ready list, only TCPIPStack touches these
+    friend class TCPIPStack;
+    uint32_t next_ready = UINT32_MAX;
+    bool ready = false;
+
+    // Wrap-safe distance from a to b, negative when b is before a
+    static int32_t seq_diff(uint32_t a, uint32_t b) { return static_cast<int32_t>(b - a); }
+    // Start the stream at the segment, on the first SYN or data we see
+    bool sync(const TCPSegment& segment);
+    void copy_in(uint32_t seq, const uint8_t* data, size_t len);
+    void copy_out(uint32_t seq, uint8_t* out, size_t len) const;
+    bool hold_out_of_order(uint32_t begin, uint32_t end);
+    void advance_ack();
 
 public:
     // Constructor to initialize the connection with IP addresses and ports
     TCPConnection(uint32_t rip, uint16_t rport, uint32_t lip, uint16_t lport);
 
-    // Process an incoming TCP packet
-    void process_packet(const TCPHeader& tcp_header, const uint8_t* data, size_t len);
+    // Process an incoming TCP segment: reassemble its payload into the ring, in order or not
+    void process_packet(const TCPSegment& segment, TCPReassemblyStats& stats);
 
-    // Create a TCP packet to send data
-    std::vector<uint8_t> create_packet(const uint8_t* data, size_t len);
+    /* Zero-copy receive: if the segment is the next bytes of the stream and nothing is buffered, the whole messages
+     * at its start are consumed in place and their length returned (the caller walks the frames where they are).
+     * Everything else, including a partial message at the end, goes through process_packet
+     */
+    size_t consume_in_place(const TCPSegment& segment, TCPReassemblyStats& stats);
+
+    // Ports, data offset and flags (PSH|ACK, no options): the TCP header fields that are the same in every segment we send
+    void write_fixed_header(uint8_t* tcp) const;
+
+    // Sequence number, ack number and window of the next segment, which carries stream_len bytes. Advances the send sequence number
+    void stamp_header(uint8_t* tcp, size_t stream_len);
 
     // Check if there is any received data available
-    bool has_data() const { return !received_data.empty(); }
+    bool has_data() const { return read_seq != next_ack_num; }
 
-    // Get the next chunk of received data
-    std::vector<uint8_t> get_data();
+    // A whole message is buffered, or the next one can never fit the window and get_message has to skip it
+    bool has_message() const;
+
+    /* Copy the next complete message into out, returns its length or 0 if no whole message is buffered
+     * A message longer than capacity is skipped and counted
+     */
+    size_t get_message(uint8_t* out, size_t capacity, TCPReassemblyStats& stats);
 };
 
-// Class representing the TCP/IP stack
+// Length of the whole frames at the start of data, a trailing partial frame is left out
+size_t whole_frames_length(const uint8_t* data, size_t len);
+
+/* Class representing the TCP/IP stack
+ * Connections live in a flat table indexed by a compact connection id, found from their key with one FlatHashIndex probe
+ * Connections with a whole message buffered are linked into a FIFO ready list, so get_next_message never looks at
+ * idle connections: its cost is the same with one connection or ten thousand
+ */
 class TCPIPStack {
+public:
+    static constexpr size_t DEFAULT_MAX_CONNECTIONS = 1024;
+    static constexpr uint32_t NO_CONNECTION = UINT32_MAX;
+    static constexpr size_t ETHER_HEADER_LEN = 14;
+    static constexpr size_t IPV4_HEADER_LEN = 20;   // Without options, as we send it
+    static constexpr size_t TCP_HEADER_LEN = 20;    // Without options, as we send it
+    static constexpr size_t HEADERS_LEN = ETHER_HEADER_LEN + IPV4_HEADER_LEN + TCP_HEADER_LEN;
+    static constexpr size_t PAYLOAD_OFFSET = HEADERS_LEN + FRAME_HEADER_LEN;  // Where a sent message starts in its frame
+
+    /* Prebuilt headers for one connection's frames
+     * Everything that is the same in every frame (MACs, addresses, ports, TTL, flags) is written once, along with its
+     * share of both checksums. Per frame only the IP length and id, sequence and ack numbers, window and checksums change
+     */
+    struct FrameTemplate {
+        alignas(64) uint8_t headers[HEADERS_LEN];
+        uint32_t connection = NO_CONNECTION;
+        uint32_t ip_sum = 0;        // Fixed IPv4 header words, not folded
+        uint32_t pseudo_sum = 0;    // Pseudo-header addresses and protocol, the length is added per frame
+        uint32_t tcp_sum = 0;       // Fixed TCP header words
+    };
+
 private:
-    std::unordered_map<uint64_t, TCPConnection> connections; // Map of active connections
+    std::vector<TCPConnection> connections;  // Indexed by connection id, reserved up front so it never reallocates
+    FlatHashIndex connection_ids;            // Connection key -> connection id
+    size_t max_connections;
+    uint32_t ready_head = NO_CONNECTION;
+    uint32_t ready_tail = NO_CONNECTION;
+    TCPReassemblyStats reassembly_stats;
+    LinkConfig link{};
+    uint16_t next_ip_id = 0;
 
     // Generate a unique key for a connection based on IP and port
     uint64_t get_connection_key(uint32_t ip, uint16_t port);
 
+    // Id of the connection with this key, creating it on first contact. NO_CONNECTION if the table is full
+    uint32_t connection_id(uint64_t key, uint32_t remote_ip, uint16_t remote_port, uint32_t local_ip, uint16_t local_port);
+
+    // Id of the connection an incoming segment belongs to
+    uint32_t connection_for(const TCPSegment& segment);
+
+    // Link a connection onto the tail of the ready list if it has a message and isn't on it already
+    void mark_ready(uint32_t id);
+
 public:
-    // Process an incoming network packet
+    explicit TCPIPStack(size_t max_connections = DEFAULT_MAX_CONNECTIONS);
+
+    // Source addresses for sent frames. Set before the first send, connections keep the local IP and port they started with
+    void set_link(const LinkConfig& config) { link = config; }
+    const LinkConfig& link_config() const { return link; }
+
+    /* Ethernet (optionally one 802.1Q tag), IPv4 without fragments, TCP. Header lengths come from the packet,
+     * so IP and TCP options are skipped. False for anything else, counted in stats. Checksums are left to the NIC
+     */
+    bool parse_frame(const uint8_t* frame, size_t len, TCPSegment& segment);
+
+    // Process an incoming Ethernet frame
     void process_packet(const uint8_t* data, size_t len);
 
-    // Create a packet to send data to a remote host
-    std::vector<uint8_t> create_packet(uint32_t dest_ip, uint16_t dest_port, const uint8_t* data, size_t len);
+    /* Zero-copy receive: validate the headers, and if the segment continues its stream on a message boundary
+     * point payload at the whole messages inside the packet and return their length
+     * Out of order data and partial messages are reassembled instead (drain them with get_next_message)
+     */
+    size_t locate_payload(const uint8_t* data, size_t len, const uint8_t** payload);
+
+    // Headers for frames to a remote host, adding its connection if it's new. False if the connection table is full
+    bool build_template(uint32_t dest_ip, uint16_t dest_port, FrameTemplate& tmpl);
+
+    /* Finish a frame whose message (len bytes) the caller has already written at frame + PAYLOAD_OFFSET, e.g. serialized
+     * straight into an mbuf: headers copied from the template, then the per-frame fields, length prefix and checksums
+     * Returns the frame length, 0 if len is over MAX_MESSAGE_SIZE
+     */
+    size_t seal_frame(const FrameTemplate& tmpl, uint8_t* frame, size_t len, ChecksumMode checksums);
+
+    /* Build the Ethernet/IPv4/TCP frame carrying one framed message to a remote host into frame
+     * Copies data into place and seals it, for callers without a template. Returns the frame length, 0 if it doesn't
+     * fit in capacity or the connection table is full
+     */
+    size_t write_packet(uint8_t* frame, size_t capacity, uint32_t dest_ip, uint16_t dest_port,
+                        const uint8_t* data, size_t len, ChecksumMode checksums);
+
+    /* Copy the next complete message from the connection at the head of the ready list into out
+     * Returns its length or 0 if no connection has one. Connections take turns, one message each
+     */
+    size_t get_next_message(uint8_t* out, size_t capacity);
+
+    // A connection is on the ready list, get_next_message has something to hand out (or skip)
+    bool has_ready_message() const { return ready_head != NO_CONNECTION; }
+
+    size_t connection_count() const { return connections.size(); }
+
+    const TCPReassemblyStats& stats() const { return reassembly_stats; }
+
+    /* RFC 1071 checksum of len bytes, continuing from a partial sum (the pseudo-header's for TCP)
+     * Over a header that includes its own checksum the result is 0 when the checksum is right
+     */
+    static uint16_t internet_checksum(const uint8_t* data, size_t len, uint32_t partial = 0);
 
-    // Retrieve the next available message from any connection
-    std::vector<uint8_t> get_next_message();
+    // Partial sum of the IPv4 pseudo-header TCP and UDP checksums cover
+    static uint32_t pseudo_header_sum(uint32_t src_ip, uint32_t dest_ip, uint8_t protocol, size_t length);
 };
 
 /*
- * IPHeader
-IPHeader: Holds basic information about an IP packet, including source and destination IP addresses and the protocol type.
-TCPHeader
-TCPHeader: Contains information about a TCP packet, such as source and destination ports, sequence number, and acknowledgment number.
+ * TCPSegment
+TCPSegment: The parts of a received Ethernet/IPv4/TCP frame the stack needs, parsed in place: addresses, ports, sequence and acknowledgment numbers, flags and the payload.
+LinkConfig
+LinkConfig: Local MAC, next hop MAC, local IP and port written into every frame the stack sends.
 TCPConnection
 TCPConnection: Represents an individual TCP connection.
 remote_ip: The IP address of the remote end of the connection.
@@ -80,18 +260,29 @@ remote_port: The port number of the remote end of the connection.
 local_ip: The IP address of the local end of the connection.
 local_port: The port number of the local end of the connection.
 next_seq_num: The sequence number for the next packet to be sent.
-next_ack_num: The acknowledgment number for the next packet to be acknowledged.
-received_data: A queue to store received data packets.
+next_ack_num: The acknowledgment number for the next packet to be acknowledged, the end of the in-order data.
+read_seq: Stream position of the next message to hand out.
+ring: Fixed receive window the stream is reassembled into, indexed by sequence number.
+out_of_order: Ranges received past a hole, already in the ring, waiting for the hole to fill.
 TCPConnection: Initializes the connection with given remote and local IP addresses and ports.
-process_packet: Handles incoming packets by updating acknowledgment numbers and storing received data.
-create_packet: Constructs a TCP packet with the provided data and updates the sequence number.
+process_packet: Reassembles incoming segments into the ring, dropping retransmitted bytes and holding out of order ones.
+consume_in_place: Zero-copy fast path for in-order segments that start on a message boundary.
+write_fixed_header: Writes the TCP header fields that never change on a connection (ports, data offset, flags).
+stamp_header: Writes the sequence number, ack number and window of the next segment and updates the sequence number.
 has_data: Checks if there is any received data available.
-get_data: Retrieves the next chunk of data that was received.
+get_message: Copies the next complete length-prefixed message out of the ring.
 TCPIPStack
 TCPIPStack: Manages multiple TCP connections and processes network packets.
-connections: A map to store active connections, using a unique key based on IP and port.
+connections: Flat table of active connections, indexed by connection id.
+connection_ids: Hash index from the connection key (IP and port) to the connection id.
+ready_head/ready_tail: FIFO list, linked through the connections, of the ones with a whole message buffered.
 get_connection_key: Generates a unique key for a connection based on IP and port.
+parse_frame: Walks the Ethernet, IPv4 and TCP headers of a received frame.
 process_packet: Processes incoming network packets by extracting headers, finding the corresponding connection, and delegating packet processing to the connection.
-create_packet: Creates a TCP packet to send to a remote host, including both TCP and IP headers.
-get_next_message: Retrieves the next available message from any connection, if there is data to be rea
+FrameTemplate: A connection's headers, prebuilt along with the fixed part of both checksums.
+build_template: Prepares the FrameTemplate for a remote host.
+seal_frame: Completes a frame around a message already written in place, with software or offloaded checksums.
+write_packet: Builds a wire-valid Ethernet/IPv4/TCP frame to a remote host into a caller buffer.
+mark_ready: Puts a connection on the ready list when it has a whole message and isn't on it already.
+get_next_message: Copies the next message from the connection at the head of the ready list into the caller's buffer
  */
\ No newline at end of file
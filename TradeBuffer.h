@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// One fill between an incoming (aggressive) order and a resting one, at the resting order's price
+struct Trade {
+    uint64_t aggressor_id;
+    uint64_t resting_id;
+    uint32_t price;
+    uint32_t quantity;
+    bool aggressor_is_buy;
+};
+
+/* Fixed-capacity trade log a matching book writes fills into, drained by whoever owns the book
+ * Storage is allocated once, push never allocates. Fills past capacity are counted in overflow_count but not kept,
+ * the match itself still happens so the book stays right. Cache line aligned so two shards' buffers never share one
+ */
+class alignas(64) TradeBuffer {
+private:
+    std::vector<Trade> trades;
+    size_t count = 0;
+    std::atomic<uint64_t> overflowed{0};   // Written by the owner only, readable from any core
+
+public:
+    explicit TradeBuffer(size_t capacity) : trades(capacity) {}
+
+    void push(const Trade& trade) {
+        if (count < trades.size()) trades[count++] = trade;
+        else overflowed.store(overflowed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::span<const Trade> view() const { return {trades.data(), count}; }
+    void clear() { count = 0; }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    size_t capacity() const { return trades.size(); }
+    uint64_t overflow_count() const { return overflowed.load(std::memory_order_relaxed); }
+};
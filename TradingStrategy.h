@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <span>
+#include <cstdint>
+#include "LatencyHistogram.h"
+#include "OrderPool.h"
+#include "TradeBuffer.h"
+#include "TscClock.h"
+
+// What a strategy sees when a book's top changes. All timestamps in TSC cycles
+struct TopOfBookEvent {
+    uint32_t instrument;    // BookManager instrument index
+    uint64_t symbol;        // Packed wire symbol
+    TopOfBook top;
+    uint64_t rx_tsc;        // When the message that moved the top came off the wire
+    uint64_t update_tsc;    // When the book finished applying it
+};
+
+/* Static interface for strategies driven by top-of-book changes
+ * Derived implements on_top_of_book(const TopOfBookEvent&), and on_trades(instrument, fills) if it wants the fills
+ * of a matching book. The calls are resolved at compile time, so they inline into the worker's apply loop: no
+ * virtual call, no std::function
+ * One instance per worker shard, called only on that worker's core for the books it owns, so strategies need no locks
+ * The base measures book update to callback entry, single writer like everything else on the worker
+ */
+template<typename Derived>
+class TradingStrategy {
+private:
+    LatencyHistogram callback_latency;
+
+public:
+    void top_of_book_changed(const TopOfBookEvent& event) {
+        uint64_t now = TscClock::now();
+        callback_latency.record(now > event.update_tsc ? now - event.update_tsc : 0);
+        static_cast<Derived*>(this)->on_top_of_book(event);
+    }
+
+    void trades_executed(uint32_t instrument, std::span<const Trade> fills) {
+        static_cast<Derived*>(this)->on_trades(instrument, fills);
+    }
+
+    // Default for strategies that don't care about fills, hidden by Derived's own on_trades
+    void on_trades(uint32_t, std::span<const Trade>) {}
+
+    const LatencyHistogram& latency() const { return callback_latency; }
+};
+
+/* Example strategy: flags every tight spread as a two-sided quoting opportunity
+ * Very simple and should be replaced with an actual strategy. Only counts its signals, order entry is owned by
+ * the main thread so nothing is sent from the worker
+ */
+class SpreadStrategy : public TradingStrategy<SpreadStrategy> {
+public:
+    static constexpr uint32_t MAX_SPREAD = 2;   // Ticks
+
+private:
+    std::atomic<uint64_t> signal_count{0};
+
+public:
+    void on_top_of_book(const TopOfBookEvent& event) {
+        const TopOfBook& top = event.top;
+        if (top.bid_price == 0 || top.ask_price == UINT32_MAX || top.ask_price < top.bid_price) return;
+        if (top.ask_price - top.bid_price <= MAX_SPREAD) {
+            signal_count.store(signal_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t signals() const { return signal_count.load(std::memory_order_relaxed); }
+};
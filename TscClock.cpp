@@ -0,0 +1,75 @@
+#include "TscClock.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <rte_ethdev.h>
+#include <rte_mbuf_dyn.h>
+
+/* Calibrate the TSC against rte_get_tsc_hz()
+ * 50ms against steady_clock is plenty to catch a wrong nominal rate, it is not trying to beat DPDK's own estimate
+ */
+void TscClock::calibrate() {
+    uint64_t reported_hz = rte_get_tsc_hz();
+
+    auto wall_start = std::chrono::steady_clock::now();
+    uint64_t tsc_start = rte_rdtsc_precise();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    uint64_t tsc_end = rte_rdtsc_precise();
+    auto wall_end = std::chrono::steady_clock::now();
+
+    uint64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wall_end - wall_start).count();
+    uint64_t measured_hz = elapsed_ns > 0 ? (tsc_end - tsc_start) * 1000000000ULL / elapsed_ns : 0;
+
+    tsc_hz = reported_hz;
+    if (reported_hz == 0 || (measured_hz > 0 && (reported_hz > measured_hz ? reported_hz - measured_hz : measured_hz - reported_hz) * 100 > measured_hz)) {
+        std::cerr << "TSC: rte_get_tsc_hz() reports " << reported_hz << " Hz but measured " << measured_hz
+                  << " Hz, using the measured rate" << std::endl;
+        tsc_hz = measured_hz;
+    }
+
+    ns_per_cycle_fp = static_cast<uint64_t>((static_cast<unsigned __int128>(1000000000ULL) << 32) / tsc_hz);
+    cycles_per_ns_fp = static_cast<uint64_t>((static_cast<unsigned __int128>(tsc_hz) << 32) / 1000000000ULL);
+    std::cout << "TSC running at " << tsc_hz / 1000000 << " MHz" << std::endl;
+}
+
+bool NicRxTimestamps::register_field() {
+    if (rte_mbuf_dyn_rx_timestamp_register(&field_offset, &rx_flag) != 0) {
+        std::cerr << "Failed to register the mbuf RX timestamp field, using software timestamps" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/* Two samples of (NIC clock, TSC) 10ms apart give the NIC clock rate in TSC cycles, the first sample is the origin
+ * Each sample brackets rte_eth_read_clock with TSC reads and takes the midpoint, the read is a PCIe round trip
+ */
+bool NicRxTimestamps::sync(uint16_t port) {
+    auto sample = [port](uint64_t& nic, uint64_t& tsc) {
+        uint64_t before = rte_rdtsc_precise();
+        int ret = rte_eth_read_clock(port, &nic);
+        uint64_t after = rte_rdtsc_precise();
+        tsc = before + (after - before) / 2;
+        return ret == 0;
+    };
+
+    uint64_t nic_a, tsc_a, nic_b, tsc_b;
+    if (!sample(nic_a, tsc_a)) {
+        std::cerr << "Port " << port << " can't read its clock, using software timestamps" << std::endl;
+        enabled = false;
+        return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (!sample(nic_b, tsc_b) || nic_b <= nic_a) {
+        std::cerr << "Port " << port << " clock isn't advancing, using software timestamps" << std::endl;
+        enabled = false;
+        return false;
+    }
+
+    nic_ref = nic_a;
+    tsc_ref = tsc_a;
+    tsc_per_nic_fp = static_cast<uint64_t>((static_cast<unsigned __int128>(tsc_b - tsc_a) << 32) / (nic_b - nic_a));
+    enabled = true;
+    std::cout << "Port " << port << " hardware RX timestamps enabled, NIC clock "
+              << (nic_b - nic_a) * TscClock::hz() / (tsc_b - tsc_a) / 1000000 << " MHz" << std::endl;
+    return true;
+}
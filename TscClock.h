@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <rte_cycles.h>
+#include <rte_mbuf.h>
+
+/* Hot-path clock: raw TSC cycles
+ * now() is a single rdtsc, no vDSO call and no conversion. Everything on the hot path stores and subtracts cycles,
+ * to_ns() is only for printing. Assumes an invariant TSC, which every server CPU we run on has
+ * calibrate() must run once after rte_eal_init and before any conversion
+ */
+class TscClock {
+private:
+    static inline uint64_t tsc_hz = 0;
+    static inline uint64_t ns_per_cycle_fp = 0;  // ns per cycle, 32.32 fixed point
+    static inline uint64_t cycles_per_ns_fp = 0; // cycles per ns, 32.32 fixed point
+
+public:
+    static uint64_t now() { return rte_rdtsc(); }
+
+    // rdtsc that waits for earlier instructions to finish, for the end of a measured section
+    static uint64_t now_precise() { return rte_rdtsc_precise(); }
+
+    /* Take the TSC frequency from rte_get_tsc_hz() and check it against the wall clock
+     * If DPDK's figure is more than 1% off the measured one (some VMs report the nominal rate) the measured one wins
+     */
+    static void calibrate();
+
+    static uint64_t hz() { return tsc_hz; }
+
+    static uint64_t to_ns(uint64_t cycles) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(cycles) * ns_per_cycle_fp) >> 32);
+    }
+
+    static uint64_t to_cycles(uint64_t ns) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(ns) * cycles_per_ns_fp) >> 32);
+    }
+};
+
+/* NIC hardware RX timestamps, mapped onto the TSC
+ * The PMD writes its own clock into the mbuf's dynamic timestamp field. We sample that clock against the TSC at
+ * startup, so a stamped mbuf converts to "TSC when the frame hit the wire" with one multiply
+ * The mapping is linear from one sync point, drift between the two clocks shows up over hours, not in a session
+ */
+struct NicRxTimestamps {
+    bool enabled = false;
+    int field_offset = -1;
+    uint64_t rx_flag = 0;
+    uint64_t nic_ref = 0;            // NIC clock at the sync point
+    uint64_t tsc_ref = 0;            // TSC at the sync point
+    uint64_t tsc_per_nic_fp = 0;     // TSC cycles per NIC tick, 32.32 fixed point
+
+    // Register the dynamic field and flag, before the port is configured. False if the mbuf library refused
+    bool register_field();
+
+    // Sample the NIC clock against the TSC, after the port is started. Disables stamping if the PMD can't read its clock
+    bool sync(uint16_t port);
+
+    // TSC time an mbuf arrived: the NIC stamp when there is one, otherwise the caller's software stamp
+    uint64_t rx_tsc(const struct rte_mbuf* mbuf, uint64_t fallback_tsc) const {
+        if (!enabled || !(mbuf->ol_flags & rx_flag)) return fallback_tsc;
+        uint64_t nic = *RTE_MBUF_DYNFIELD(mbuf, field_offset, const rte_mbuf_timestamp_t*);
+        int64_t ticks = static_cast<int64_t>(nic - nic_ref);
+        int64_t cycles = static_cast<int64_t>((static_cast<__int128>(ticks) * static_cast<__int128>(tsc_per_nic_fp)) >> 32);
+        return tsc_ref + static_cast<uint64_t>(cycles);
+    }
+};
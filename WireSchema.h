@@ -0,0 +1,154 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+/* Compile-time description of a fixed-size binary wire format
+ * Declare every field once (struct member, wire offset, endianness) and get from that:
+ *  - a scalar decoder and encoder that compile down to plain loads/stores
+ *  - static_asserts that the fields tile the wire message exactly and fit in the struct
+ *  - the byte map WireSchemaSimd.h turns into shuffle masks for the vector decoder
+ * Adding a feed format is then a new field list, no hand-written offsets in hot-path code
+ */
+
+enum class Endian { Little, Big };
+
+template<typename T>
+struct MemberPointerTraits;
+
+template<typename C, typename T>
+struct MemberPointerTraits<T C::*> {
+    using struct_type = C;
+    using member_type = T;
+};
+
+/* One wire field mapped onto a struct member
+ * StructOffset is passed in because offsetof can't be computed from a member pointer at compile time, use WIRE_FIELD below
+ */
+template<auto Member, size_t StructOffset, size_t WireOffset, Endian Order = Endian::Little>
+struct WireField {
+    using struct_type = typename MemberPointerTraits<decltype(Member)>::struct_type;
+    using member_type = typename MemberPointerTraits<decltype(Member)>::member_type;
+
+    static constexpr auto member = Member;
+    static constexpr size_t struct_offset = StructOffset;
+    static constexpr size_t wire_offset = WireOffset;
+    static constexpr size_t size = sizeof(member_type);
+    static constexpr Endian endian = Order;
+
+    static_assert(std::is_integral_v<member_type> || std::is_array_v<member_type>, "Wire fields are integers or byte arrays");
+    static_assert(endian == Endian::Little || std::is_integral_v<member_type>, "Byte order only applies to integer fields");
+
+    // Wire byte that lands in byte b of the struct member. Big endian fields read their bytes back to front
+    static constexpr size_t wire_byte(size_t b) {
+        return endian == Endian::Little ? wire_offset + b : wire_offset + size - 1 - b;
+    }
+
+    // Just this field off the wire, integer fields only
+    template<typename V = member_type> requires std::is_integral_v<V>
+    static V load(const char* wire) {
+        V value;
+        std::memcpy(&value, wire + wire_offset, size);
+        if constexpr (endian == Endian::Big) value = std::byteswap(value);
+        return value;
+    }
+
+    static void decode(const char* wire, struct_type& out) {
+        if constexpr (std::is_array_v<member_type>) {
+            std::memcpy(out.*Member, wire + wire_offset, size);
+        } else {
+            out.*Member = load(wire);
+        }
+    }
+
+    static void encode(const struct_type& in, char* wire) {
+        if constexpr (std::is_array_v<member_type>) {
+            std::memcpy(wire + wire_offset, in.*Member, size);
+        } else {
+            member_type value = in.*Member;
+            if constexpr (endian == Endian::Big) value = std::byteswap(value);
+            std::memcpy(wire + wire_offset, &value, size);
+        }
+    }
+};
+
+#define WIRE_FIELD(Struct, member, wire_offset, endian) \
+    WireField<&Struct::member, offsetof(Struct, member), wire_offset, endian>
+
+template<typename Struct, size_t WireSize, typename... Fields>
+class WireSchema {
+private:
+    // Every wire byte is claimed by exactly one field
+    static constexpr bool fields_tile_wire() {
+        bool claimed[WireSize] = {};
+        bool ok = true;
+        auto claim = [&](size_t offset, size_t size) {
+            for (size_t b = offset; b < offset + size; ++b) {
+                if (b >= WireSize || claimed[b]) ok = false;
+                else claimed[b] = true;
+            }
+        };
+        (claim(Fields::wire_offset, Fields::size), ...);
+        for (bool c : claimed) ok = ok && c;
+        return ok;
+    }
+
+    template<auto Member, typename F>
+    static constexpr bool maps_member() {
+        if constexpr (std::is_same_v<decltype(Member), std::remove_const_t<decltype(F::member)>>) return Member == F::member;
+        else return false;
+    }
+
+    // Position of Member's field in the list, field_count if it isn't there
+    template<auto Member>
+    static constexpr size_t field_index() {
+        size_t index = 0;
+        size_t found = field_count;
+        ((found = maps_member<Member, Fields>() && found == field_count ? index : found, ++index), ...);
+        return found;
+    }
+
+public:
+    using struct_type = Struct;
+    static constexpr size_t wire_size = WireSize;
+    static constexpr size_t field_count = sizeof...(Fields);
+
+    static_assert((std::is_same_v<typename Fields::struct_type, Struct> && ...), "All fields must belong to the schema's struct");
+    static_assert(((Fields::struct_offset + Fields::size <= sizeof(Struct)) && ...), "Field lies outside the struct");
+    static_assert((Fields::size + ...) == WireSize, "Field sizes must add up to the wire size");
+    static_assert(fields_tile_wire(), "Wire fields overlap, leave gaps or run past the wire size");
+    static_assert(std::is_trivially_copyable_v<Struct>, "Decoded struct must be trivially copyable");
+
+    // Value-initialised so struct padding and any non-wire members come out zero, same as the SIMD decoder
+    static Struct decode(const char* wire) {
+        Struct out{};
+        (Fields::decode(wire, out), ...);
+        return out;
+    }
+
+    static void encode(const Struct& in, char* wire) {
+        (Fields::encode(in, wire), ...);
+    }
+
+    /* The field declared for Member, e.g. field<&Msg::sequence_number>::load(wire) to peek at one field
+     * without decoding the message. A member that isn't on the wire doesn't compile
+     */
+    template<auto Member>
+    using field = std::tuple_element_t<field_index<Member>(), std::tuple<Fields...>>;
+
+    /* Fill map so that map[struct_byte] = wire_byte for every struct byte that comes off the wire
+     * Untouched entries keep whatever the caller put there (the SIMD planner uses -1 for "write zero")
+     */
+    static constexpr void byte_map(int* map, size_t struct_base, size_t wire_base) {
+        auto add = [&]<typename F>(F) {
+            for (size_t b = 0; b < F::size; ++b) {
+                map[struct_base + F::struct_offset + b] = static_cast<int>(wire_base + F::wire_byte(b));
+            }
+        };
+        (add(Fields{}), ...);
+    }
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <x86intrin.h>
+#include "WireSchema.h"
+
+/* Vector batch decoder generated from a WireSchema
+ * Messages are decoded a block at a time, where a block is the smallest number of messages whose struct output
+ * is a whole number of 64-byte vectors. The shuffle plan for one block is computed at compile time from the
+ * schema's byte map, the kernels below only replay it, so there are no offsets written by hand anywhere
+ *
+ * Kernels, picked once at runtime from CPUID:
+ *  - AVX-512 VBMI: one vpermi2b per 64 output bytes, from a 128-byte input window
+ *  - AVX2: in-lane vpshufb per 32 output bytes, each lane from its own 16-byte input windows
+ *  - SSSE3: pshufb per 16 output bytes
+ *  - scalar: the schema's field-by-field decoder
+ */
+template<typename Schema>
+class WireSchemaSimd {
+public:
+    using Struct = typename Schema::struct_type;
+    using DecodeBlockFn = void (*)(const char*, Struct*);
+
+    static constexpr size_t BLOCK = 64 / std::gcd(sizeof(Struct), size_t{64});
+    static constexpr size_t IN_BYTES = BLOCK * Schema::wire_size;
+    static constexpr size_t OUT_BYTES = BLOCK * sizeof(Struct);
+    static_assert(IN_BYTES >= 16, "Block must be at least one xmm of input");
+
+private:
+    static constexpr size_t MAX_WINDOWS = 4;
+
+    // For every output byte of a block, the input byte it comes from, or -1 for bytes that aren't on the wire (written as zero)
+    static constexpr std::array<int, OUT_BYTES> make_byte_map() {
+        std::array<int, OUT_BYTES> map{};
+        for (auto& b : map) b = -1;
+        for (size_t m = 0; m < BLOCK; ++m) {
+            Schema::byte_map(map.data(), m * sizeof(Struct), m * Schema::wire_size);
+        }
+        return map;
+    }
+    static constexpr std::array<int, OUT_BYTES> BYTE_MAP = make_byte_map();
+
+    /* 16-byte output chunk built from a few 16-byte input windows: out = OR of pshufb(window[w], mask[w])
+     * A mask byte of 0x80 makes pshufb write zero, which is how other windows' bytes and padding are left out
+     * Unused windows repeat the last start with an all-zero mask so every chunk runs the same straight-line code
+     */
+    struct Chunk128 {
+        size_t start[MAX_WINDOWS];
+        alignas(16) int8_t mask[MAX_WINDOWS][16];
+        size_t windows;
+    };
+
+    static constexpr std::array<Chunk128, OUT_BYTES / 16> make_chunks128() {
+        std::array<Chunk128, OUT_BYTES / 16> chunks{};
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            bool covered[16] = {};
+            for (size_t j = 0; j < 16; ++j) covered[j] = BYTE_MAP[c * 16 + j] < 0;
+            size_t start = 0;
+            for (size_t w = 0; w < MAX_WINDOWS; ++w) {
+                int lowest = -1;
+                for (size_t j = 0; j < 16; ++j) {
+                    int src = BYTE_MAP[c * 16 + j];
+                    if (!covered[j] && (lowest < 0 || src < lowest)) lowest = src;
+                }
+                if (lowest >= 0) {
+                    start = static_cast<size_t>(lowest);
+                    if (start > IN_BYTES - 16) start = IN_BYTES - 16; // Never read past the block
+                    chunks[c].windows = w + 1;
+                }
+                chunks[c].start[w] = start;
+                for (size_t j = 0; j < 16; ++j) {
+                    int src = BYTE_MAP[c * 16 + j];
+                    bool in_window = lowest >= 0 && !covered[j] && src >= static_cast<int>(start) && src < static_cast<int>(start + 16);
+                    chunks[c].mask[w][j] = in_window ? static_cast<int8_t>(src - static_cast<int>(start)) : static_cast<int8_t>(0x80);
+                    if (in_window) covered[j] = true;
+                }
+            }
+            for (size_t j = 0; j < 16; ++j) {
+                if (!covered[j]) throw "output chunk needs more than MAX_WINDOWS input windows"; // Compile error in constexpr context
+            }
+        }
+        return chunks;
+    }
+    static constexpr std::array<Chunk128, OUT_BYTES / 16> CHUNKS128 = make_chunks128();
+
+    // Most windows any chunk needs, the xmm/ymm kernels only run that many
+    static constexpr size_t windows_needed() {
+        size_t most = 1;
+        for (const Chunk128& chunk : CHUNKS128) most = chunk.windows > most ? chunk.windows : most;
+        return most;
+    }
+    static constexpr size_t WINDOWS = windows_needed();
+
+    /* 64-byte output chunk built from one 128-byte input window with vpermi2b
+     * keep has a bit set for every output byte that comes off the wire, the rest are zeroed by the masked permute
+     */
+    struct Chunk512 {
+        size_t start;
+        uint64_t keep;
+        alignas(64) uint8_t index[64];
+    };
+
+    // A 64-byte chunk only works if its input fits in 128 bytes, otherwise the AVX-512 kernel is not offered
+    static constexpr bool avx512_plan_fits() {
+        if (IN_BYTES < 128) return false;
+        for (size_t c = 0; c < OUT_BYTES / 64; ++c) {
+            int lowest = -1, highest = -1;
+            for (size_t j = 0; j < 64; ++j) {
+                int src = BYTE_MAP[c * 64 + j];
+                if (src < 0) continue;
+                if (lowest < 0 || src < lowest) lowest = src;
+                if (src > highest) highest = src;
+            }
+            if (highest - lowest >= 128) return false;
+        }
+        return true;
+    }
+    static constexpr bool AVX512_OK = avx512_plan_fits();
+
+    static constexpr std::array<Chunk512, OUT_BYTES / 64> make_chunks512() {
+        std::array<Chunk512, OUT_BYTES / 64> chunks{};
+        if (!AVX512_OK) return chunks;
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            int lowest = -1;
+            for (size_t j = 0; j < 64; ++j) {
+                int src = BYTE_MAP[c * 64 + j];
+                if (src >= 0 && (lowest < 0 || src < lowest)) lowest = src;
+            }
+            size_t start = lowest < 0 ? 0 : static_cast<size_t>(lowest);
+            if (start > IN_BYTES - 128) start = IN_BYTES - 128;
+            chunks[c].start = start;
+            for (size_t j = 0; j < 64; ++j) {
+                int src = BYTE_MAP[c * 64 + j];
+                if (src < 0) continue;
+                chunks[c].index[j] = static_cast<uint8_t>(src - static_cast<int>(start));
+                chunks[c].keep |= 1ULL << j;
+            }
+        }
+        return chunks;
+    }
+    static constexpr std::array<Chunk512, OUT_BYTES / 64> CHUNKS512 = make_chunks512();
+
+    static DecodeBlockFn select_block_decoder() {
+        for (DecodeBlockFn fn : {decode_block_avx512, decode_block_avx2, decode_block_ssse3}) {
+            if (supported(fn)) return fn;
+        }
+        return decode_block_scalar;
+    }
+
+public:
+    // Whether a kernel can run on this CPU, and for AVX-512 whether this schema has a plan for it. mdp-simdcheck skips the rest
+    static bool supported(DecodeBlockFn fn) {
+        __builtin_cpu_init();
+        if (fn == decode_block_avx512) return AVX512_OK && __builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bw");
+        if (fn == decode_block_avx2) return __builtin_cpu_supports("avx2");
+        if (fn == decode_block_ssse3) return __builtin_cpu_supports("ssse3");
+        return true;
+    }
+
+    /* Decode n back-to-back wire messages from buf into out
+     * Whole blocks go through the widest kernel the CPU supports, the tail through the scalar decoder
+     */
+    static void decode_batch(const char* buf, size_t n, Struct* out) {
+        static const DecodeBlockFn decode_block = select_block_decoder();
+        size_t i = 0;
+        for (; i + BLOCK <= n; i += BLOCK) {
+            decode_block(buf + i * Schema::wire_size, out + i);
+        }
+        for (; i < n; ++i) {
+            out[i] = Schema::decode(buf + i * Schema::wire_size);
+        }
+    }
+
+    // Name of the kernel decode_batch uses on this CPU, for the startup log
+    static const char* active_kernel() {
+        DecodeBlockFn fn = select_block_decoder();
+        if (fn == decode_block_avx512) return "AVX-512 VBMI";
+        if (fn == decode_block_avx2) return "AVX2";
+        if (fn == decode_block_ssse3) return "SSSE3";
+        return "scalar";
+    }
+
+    static void decode_block_scalar(const char* in, Struct* out) {
+        for (size_t m = 0; m < BLOCK; ++m) {
+            out[m] = Schema::decode(in + m * Schema::wire_size);
+        }
+    }
+
+    __attribute__((target("ssse3")))
+    static void decode_block_ssse3(const char* in, Struct* out) {
+        char* dst = reinterpret_cast<char*>(out);
+        for (size_t c = 0; c < CHUNKS128.size(); ++c) {
+            const Chunk128& chunk = CHUNKS128[c];
+            __m128i r = _mm_setzero_si128();
+            for (size_t w = 0; w < WINDOWS; ++w) {
+                __m128i window = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + chunk.start[w]));
+                r = _mm_or_si128(r, _mm_shuffle_epi8(window, _mm_load_si128(reinterpret_cast<const __m128i*>(chunk.mask[w]))));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + c * 16), r);
+        }
+    }
+
+    // vpshufb only shuffles within 128-bit lanes, so each lane gets its own input windows and two chunk plans run side by side
+    __attribute__((target("avx2")))
+    static void decode_block_avx2(const char* in, Struct* out) {
+        char* dst = reinterpret_cast<char*>(out);
+        for (size_t c = 0; c < CHUNKS128.size(); c += 2) {
+            const Chunk128& lo = CHUNKS128[c];
+            const Chunk128& hi = CHUNKS128[c + 1];
+            __m256i r = _mm256_setzero_si256();
+            for (size_t w = 0; w < WINDOWS; ++w) {
+                __m256i window = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + lo.start[w]))),
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + hi.start[w])), 1);
+                __m256i mask = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(lo.mask[w]))),
+                        _mm_load_si128(reinterpret_cast<const __m128i*>(hi.mask[w])), 1);
+                r = _mm256_or_si256(r, _mm256_shuffle_epi8(window, mask));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + c * 16), r);
+        }
+    }
+
+    __attribute__((target("avx512f,avx512bw,avx512vbmi")))
+    static void decode_block_avx512(const char* in, Struct* out) {
+        char* dst = reinterpret_cast<char*>(out);
+        for (size_t c = 0; c < CHUNKS512.size(); ++c) {
+            const Chunk512& chunk = CHUNKS512[c];
+            __m512i a = _mm512_loadu_si512(in + chunk.start);
+            __m512i b = _mm512_loadu_si512(in + chunk.start + 64);
+            __m512i index = _mm512_load_si512(chunk.index);
+            __m512i r = _mm512_maskz_permutex2var_epi8(chunk.keep, a, index, b);
+            _mm512_storeu_si512(dst + c * 64, r);
+        }
+    }
+};
@@ -1,10 +1,24 @@
+#include <algorithm>
 #include <iostream>
 #include <signal.h>
 #include "DPDKSetup.h"
 #include "MarketDataHandler.h"
 
-#define RX_CORE 1
-#define WORKER_CORE 2
+/* Instruments we build books for, with the price they are expected to trade around
+ * In production this comes from the exchange's reference data at startup
+ */
+static const std::vector<InstrumentConfig> INSTRUMENTS = {
+        {"AAPL", 1500}, {"MSFT", 1500}, {"AMZN", 1500}, {"GOOGL", 1500},
+        {"META", 1500}, {"NVDA", 1500}, {"TSLA", 1500}, {"JPM", 1500},
+};
+
+/* Multicast channels for --feed-ports, each published on an A and a B group
+ * In production this comes from the exchange's feed configuration
+ */
+static const std::vector<FeedChannelConfig> FEED_CHANNELS = {
+        {"equities-1", FeedHandler::parse_ipv4("239.1.1.1"), 30001, FeedHandler::parse_ipv4("239.2.1.1"), 30001},
+        {"equities-2", FeedHandler::parse_ipv4("239.1.1.2"), 30002, FeedHandler::parse_ipv4("239.2.1.2"), 30002},
+};
 
 /* Signal handler for graceful shutdown
  * This function is called when SIGINT or SIGTERM is received
@@ -22,40 +36,152 @@ int main(int argc, char *argv[]) {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
+    AppConfig config;
+    if (!parse_app_config(argc, argv, config)) {
+        return -1;
+    }
+
     std::cout << "Starting DPDK initialization..." << std::endl;
-    if (dpdk_init(argc, argv) < 0) {
+    if (dpdk_init(argv[0], config) < 0) {
         std::cerr << "DPDK initialization failed." << std::endl;
         return -1;
     }
     std::cout << "DPDK initialization completed." << std::endl;
 
-    MarketDataHandler handler;
+    // --shard pins a symbol to a worker, the rest are spread by symbol hash
+    std::vector<InstrumentConfig> instruments = INSTRUMENTS;
+    for (const auto& [symbol, worker] : config.shard_overrides) {
+        auto it = std::find_if(instruments.begin(), instruments.end(),
+                               [&](const InstrumentConfig& instrument) { return instrument.symbol == symbol; });
+        if (it == instruments.end()) {
+            std::cerr << "--shard for unknown symbol " << symbol << std::endl;
+            return -1;
+        }
+        it->shard = worker;
+    }
+
+    MarketDataHandler handler(instruments, config.rx_queues, config.workers);
+    // Opens burst well past the primary ring, spill rather than drop so the books stay in sync
+    handler.set_overflow_policy(OverflowPolicy::SpillToOverflow);
+    // --matching on: the books act as the exchange, crossing orders trade instead of locking or crossing the book
+    if (config.matching) handler.enable_matching();
 
-    /* Launch RX core
-     * This core is responsible for receiving packets
+    /* Order entry out of the order stream port's TX queue, sent from this (the main) thread
+     * Feed ports are receive only, in feed mode submitted orders are looped back as before
      */
-    std::cout << "Launching RX core..." << std::endl;
-    if (rte_eal_remote_launch(lcore_rx, &handler, RX_CORE) != 0) {
-        std::cerr << "Failed to launch RX core." << std::endl;
-        return -1;
+    if (config.feed_ports.empty()) {
+        LinkConfig link{};
+        struct rte_ether_addr mac;
+        if (rte_eth_macaddr_get(config.port, &mac) == 0) std::copy(mac.addr_bytes, mac.addr_bytes + 6, link.local_mac);
+        std::copy(config.gateway_mac.begin(), config.gateway_mac.end(), link.next_hop_mac);
+        link.local_ip = config.local_ip;
+        link.local_port = config.local_port;
+        handler.enable_order_tx(tx_mbuf_pool, config.port, 0, link, config.order_dest_ip, config.order_dest_port);
+    }
+
+    // Live stats for mdp-stat. Optional, the handler runs the same without it
+    StatsPublisher stats_publisher;
+    if (stats_publisher.open()) {
+        handler.set_stats_publisher(&stats_publisher);
     }
-    std::cout << "RX core launched." << std::endl;
 
-    /* Launch worker core
-     * This core processes the received market data
+    // --record: the RX cores hand what they receive to a writer thread, the pcap is written off the hot path
+    FrameRecorder recorder;
+    FrameRecorder* record = nullptr;
+    if (!config.record_path.empty()) {
+        if (!recorder.open(config.record_path.c_str(), config.rx_queues)) return -1;
+        recorder.start();
+        record = &recorder;
+        std::cout << "Recording received frames to " << config.record_path << std::endl;
+    }
+
+    // --replay: the whole capture is loaded into mbufs up front, the replay core stands in for the RX core
+    PcapReplay replay;
+    if (!config.replay_path.empty()) {
+        PcapReplay::Pacing pacing = config.replay_max_speed ? PcapReplay::Pacing::MaxSpeed : PcapReplay::Pacing::Recorded;
+        if (!replay.load(config.replay_path.c_str(), pacing)) return -1;  // Prints what it loaded and skipped
+    }
+
+    /* Launch RX cores
+     * Feed mode: one core polls both lines of the multicast feed
+     * Otherwise one per RX queue, each responsible for receiving that queue's packets
+     * Replay: one core injects the capture into whichever of the two paths the run is configured for
      */
-    std::cout << "Launching worker core..." << std::endl;
-    if (rte_eal_remote_launch(lcore_worker, &handler, WORKER_CORE) != 0) {
-        std::cerr << "Failed to launch worker core." << std::endl;
-        return -1;
+    FeedLcoreArgs feed_args{&handler, {}, 0, record};
+    std::vector<RxLcoreArgs> rx_args;
+    for (uint16_t q = 0; q < config.rx_queues; ++q) {
+        rx_args.push_back({&handler, config.port, q, record});
+    }
+    ReplayLcoreArgs replay_args{&handler, &replay, !config.feed_ports.empty()};
+    if (!config.feed_ports.empty()) {
+        handler.enable_feed(FEED_CHANNELS, uint64_t{config.feed_max_hold_us} * 1000);
+    }
+    if (replay.loaded()) {
+        std::cout << "Launching replay core " << config.rx_cores[0] << "..." << std::endl;
+        if (rte_eal_remote_launch(lcore_replay, &replay_args, config.rx_cores[0]) != 0) {
+            std::cerr << "Failed to launch replay core " << config.rx_cores[0] << "." << std::endl;
+            return -1;
+        }
+    } else if (!config.feed_ports.empty()) {
+        for (uint16_t port : active_ports(config)) feed_args.ports[feed_args.port_count++] = port;
+        std::cout << "Launching feed core " << config.rx_cores[0] << " for " << FEED_CHANNELS.size() << " channel(s)..." << std::endl;
+        if (rte_eal_remote_launch(lcore_feed, &feed_args, config.rx_cores[0]) != 0) {
+            std::cerr << "Failed to launch feed core " << config.rx_cores[0] << "." << std::endl;
+            return -1;
+        }
+    } else {
+        for (uint16_t q = 0; q < config.rx_queues; ++q) {
+            std::cout << "Launching RX core " << config.rx_cores[q] << " for queue " << q << "..." << std::endl;
+            if (rte_eal_remote_launch(lcore_rx, &rx_args[q], config.rx_cores[q]) != 0) {
+                std::cerr << "Failed to launch RX core " << config.rx_cores[q] << "." << std::endl;
+                return -1;
+            }
+        }
+        std::cout << config.rx_queues << " RX core(s) launched." << std::endl;
     }
-    std::cout << "Worker core launched." << std::endl;
+
+    /* Launch worker cores
+     * One per shard, each processes the market data for the books it owns
+     */
+    std::vector<WorkerLcoreArgs> worker_args;
+    for (uint16_t w = 0; w < config.workers; ++w) {
+        worker_args.push_back({&handler, w});
+    }
+    for (uint16_t w = 0; w < config.workers; ++w) {
+        std::cout << "Launching worker core " << config.worker_cores[w] << " for shard " << w << "..." << std::endl;
+        if (rte_eal_remote_launch(lcore_worker, &worker_args[w], config.worker_cores[w]) != 0) {
+            std::cerr << "Failed to launch worker core " << config.worker_cores[w] << "." << std::endl;
+            return -1;
+        }
+    }
+    std::cout << config.workers << " worker core(s) launched." << std::endl;
 
     // Some time for the cores to initialize
     std::this_thread::sleep_for(std::chrono::seconds(1));
 
-    // Simulate market activity
-    handler.simulate_market_activity(10000);  // 10,000 orders
+    if (replay.loaded()) {
+        // The capture is the market activity, wait for the replay core to get through it
+        while (!force_quit && !replay.done()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (replay.done()) {
+            uint64_t replay_ns = TscClock::to_ns(replay.replay_cycles());
+            std::cout << "Replayed " << replay.frame_count() << " frame(s) in " << replay_ns / 1000000.0 << " ms ("
+                      << (replay.mode() == PcapReplay::Pacing::MaxSpeed ? "max speed" : "recorded pacing")
+                      << ", captured over " << replay.capture_duration_ns() / 1000000.0 << " ms), "
+                      << (replay_ns > 0 ? replay.frame_count() * 1000000000.0 / replay_ns : 0.0) << " frames/s" << std::endl;
+        }
+    } else {
+        // Simulate market activity
+        handler.simulate_market_activity(10000);  // 10,000 orders
+    }
+
+    // --tx-orders: random orders out through order entry, e.g. into a net_pcap tx_pcap capture to check with mdp-txcheck
+    for (uint32_t i = 0; i < config.tx_orders && !force_quit; ++i) {
+        Order order = handler.generate_random_order();
+        handler.submit_order(order, TscClock::now());
+    }
+    handler.flush_orders();
 
     // Allow processing to complete first
     std::this_thread::sleep_for(std::chrono::seconds(5));
@@ -69,6 +195,14 @@ int main(int argc, char *argv[]) {
     std::cout << "Waiting for all cores to complete..." << std::endl;
     rte_eal_mp_wait_lcore();
 
+    // The RX cores are done capturing, let the writer drain what they left and close the file
+    if (record != nullptr) {
+        recorder.stop();
+        std::cout << "Recorded " << recorder.recorded_count() << " frame(s) to " << config.record_path
+                  << " (" << recorder.dropped_count() << " dropped, " << recorder.error_count() << " write errors)" << std::endl;
+    }
+    replay.release();
+
     // Clean up DPDK resources
     dpdk_cleanup();
     std::cout << "DPDK cleanup completed." << std::endl;
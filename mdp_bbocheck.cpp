@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "BboRecord.h"
+
+/* mdp-bbocheck: BboRecord's seqlock under contention, one writer publishing as fast as it can and 4 readers polling
+ * the same record. Every field of publish k is derived from k, so a quote mixing two publishes breaks the relation:
+ * - read() always returns one whole publish, with its sequence number
+ * - a reader's sequence numbers never go backwards
+ * - try_read() either fails or returns one whole publish
+ * On a single CPU the threads share it and the writer is preempted mid-publish instead, the check still holds
+ *
+ *   ./mdp-bbocheck             # 4 readers, 500 ms
+ *   ./mdp-bbocheck 8 2000
+ *
+ * Exits 1 on any torn or backwards quote
+ */
+
+namespace {
+    TopOfBook top_for(uint64_t k) {
+        return {static_cast<uint32_t>(k), static_cast<uint32_t>(k + 1), 3 * k, 5 * k};
+    }
+
+    // Publish k has sequence k, and every field is what top_for(k) stored
+    bool whole(const BboQuote& quote) {
+        uint64_t k = quote.sequence;
+        if (k == 0) {
+            return quote.bid_price == 0 && quote.ask_price == UINT32_MAX && quote.bid_quantity == 0 &&
+                   quote.ask_quantity == 0 && quote.update_tsc == 0;
+        }
+        TopOfBook top = top_for(k);
+        return quote.bid_price == top.bid_price && quote.ask_price == top.ask_price && quote.bid_quantity == top.bid_quantity &&
+               quote.ask_quantity == top.ask_quantity && quote.update_tsc == 7 * k;
+    }
+
+    struct ReaderResult {
+        uint64_t reads = 0;
+        uint64_t failed_attempts = 0;  // try_read calls that saw a publish in progress
+        uint64_t torn = 0;
+        uint64_t backwards = 0;
+        uint64_t last_sequence = 0;
+    };
+
+    void reader(const BboRecord& record, const std::atomic<bool>& done, ReaderResult& result) {
+        uint64_t last = 0;
+        auto check = [&](const BboQuote& quote) {
+            result.torn += !whole(quote);
+            result.backwards += quote.sequence < last;
+            last = std::max(last, quote.sequence);
+            ++result.reads;
+        };
+        while (!done.load(std::memory_order_relaxed)) {
+            check(record.read());
+            BboQuote quote;
+            if (record.try_read(quote)) check(quote);
+            else ++result.failed_attempts;
+        }
+        result.last_sequence = last;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t readers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4;
+    long run_ms = argc > 2 ? std::strtol(argv[2], nullptr, 10) : 500;
+
+    auto record = std::make_unique<BboRecord>();
+    std::atomic<bool> done{false};
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+    for (size_t r = 0; r < readers; ++r) {
+        threads.emplace_back(reader, std::cref(*record), std::cref(done), std::ref(results[r]));
+    }
+
+    // Checks the clock every 4096 publishes so the writer stays in its publish loop almost all the time
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(run_ms);
+    uint64_t published = 0;
+    do {
+        for (int i = 0; i < 4096; ++i) {
+            ++published;
+            record->publish(top_for(published), 7 * published);
+        }
+    } while (std::chrono::steady_clock::now() < end);
+    done.store(true, std::memory_order_relaxed);
+    for (std::thread& thread : threads) thread.join();
+
+    bool ok = true;
+    uint64_t reads = 0;
+    uint64_t failed_attempts = 0;
+    for (size_t r = 0; r < readers; ++r) {
+        const ReaderResult& result = results[r];
+        reads += result.reads;
+        failed_attempts += result.failed_attempts;
+        if (result.torn || result.backwards || result.last_sequence > published) {
+            std::fprintf(stderr, "  reader %zu: %llu torn, %llu backwards, last sequence %llu of %llu published\n", r,
+                         static_cast<unsigned long long>(result.torn), static_cast<unsigned long long>(result.backwards),
+                         static_cast<unsigned long long>(result.last_sequence), static_cast<unsigned long long>(published));
+            ok = false;
+        }
+    }
+    if (!whole(record->read()) || record->read().sequence != published) ok = false;
+
+    std::printf("bbo seqlock: %llu publishes, %zu readers, %llu reads, %llu try_read attempts hit a publish, %s\n",
+                static_cast<unsigned long long>(published), readers, static_cast<unsigned long long>(reads),
+                static_cast<unsigned long long>(failed_attempts), ok ? "no torn or backwards quotes" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1136 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <random>
+#include <sched.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ArrayOrderBook.h"
+#include "BboRecord.h"
+#include "BookManager.h"
+#include "FlatHashIndex.h"
+#include "LatencyHistogram.h"
+#include "LockFreeRingBuffer.h"
+#include "MessageDispatch.h"
+#include "OrderBook.h"
+#include "OrderProtocol.h"
+#include "SPSCRing.h"
+#include "SIMDMessageParser.h"
+#include "TCPIPStack.h"
+#include "TradingStrategy.h"
+#include "TscClock.h"
+#include <rte_ring.h>
+#include <x86intrin.h>
+
+/* mdp-bench: microbenchmarks of the hot path pieces, one at a time by name or all of them
+ *
+ *   ./mdp-bench book
+ *   taskset -c 2 ./mdp-bench all
+ *
+ * Timed with the TSC, reported in ns. Inputs are generated before the clock starts, so only the code under test is
+ * measured. Pin it to an isolated core, numbers from a shared or frequency scaling core wander
+ * No NIC and no EAL, nothing here touches a port
+ */
+
+namespace {
+    // Cycles of one timed section, converted to ns per operation
+    double ns_per_op(uint64_t cycles, size_t ops) {
+        return ops > 0 ? static_cast<double>(TscClock::to_ns(cycles)) / static_cast<double>(ops) : 0.0;
+    }
+
+    // p50/p99/max of per-operation samples, recorded in cycles. Each sample includes one rdtsc pair (~20 cycles)
+    void print_percentiles(const char* label, const LatencyHistogram& histogram) {
+        std::printf("    %-10s p50 %6llu   p99 %6llu   max %8llu ns\n", label,
+                    static_cast<unsigned long long>(TscClock::to_ns(histogram.percentile(50.0))),
+                    static_cast<unsigned long long>(TscClock::to_ns(histogram.percentile(99.0))),
+                    static_cast<unsigned long long>(TscClock::to_ns(histogram.max())));
+    }
+
+    // Keeps a result alive so the compiler can't drop the loop that produced it
+    template<typename T>
+    void keep(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /* Book engines: ns per add, modify, best bid/ask and cancel, each timed as one pass over BOOK_ORDERS orders
+     * Prices are uniform over the $10.00 - $20.00 range the simulation uses, a share far outside it exercises the
+     * array engine's sparse fallback
+     */
+    constexpr size_t BOOK_ORDERS = 1 << 19;
+
+    template<typename Book>
+    void bench_book_engine(const char* name, Book& book, double far_share) {
+        std::mt19937 rng(1);
+        std::bernoulli_distribution far(far_share);
+        std::vector<uint32_t> prices(BOOK_ORDERS);
+        std::vector<uint64_t> cancel_order(BOOK_ORDERS);
+        for (size_t i = 0; i < BOOK_ORDERS; ++i) {
+            prices[i] = far(rng) ? 100000 + rng() % 100000 : 1000 + rng() % 1000;
+            cancel_order[i] = i + 1;
+        }
+        std::shuffle(cancel_order.begin(), cancel_order.end(), rng);
+
+        uint64_t start = TscClock::now();
+        for (size_t i = 0; i < BOOK_ORDERS; ++i) {
+            // Every other order buys $5 below the drawn price, the rest sell $5 above, so the book never crosses
+            bool is_buy = i & 1;
+            book.addOrder(i + 1, is_buy ? prices[i] - 500 : prices[i] + 500, 100, is_buy);
+        }
+        uint64_t add = TscClock::now_precise() - start;
+
+        start = TscClock::now();
+        for (size_t i = 0; i < BOOK_ORDERS; ++i) book.modifyOrder(cancel_order[i], 50);
+        uint64_t modify = TscClock::now_precise() - start;
+
+        start = TscClock::now();
+        uint64_t sum = 0;
+        for (size_t i = 0; i < BOOK_ORDERS; ++i) {
+            sum += book.getBestBid() + book.getBestAsk();
+            keep(sum);
+        }
+        uint64_t best = TscClock::now_precise() - start;
+
+        start = TscClock::now();
+        for (size_t i = 0; i < BOOK_ORDERS; ++i) book.removeOrder(cancel_order[i]);
+        uint64_t cancel = TscClock::now_precise() - start;
+
+        std::printf("  %-16s %5.0f%% far   add %6.1f   modify %6.1f   best %6.1f   cancel %6.1f ns/op\n", name,
+                    far_share * 100, ns_per_op(add, BOOK_ORDERS), ns_per_op(modify, BOOK_ORDERS),
+                    ns_per_op(best, BOOK_ORDERS), ns_per_op(cancel, BOOK_ORDERS));
+    }
+
+    void bench_book() {
+        std::printf("book: %zu orders per pass\n", BOOK_ORDERS);
+        for (double far_share : {0.0, 0.05}) {
+            auto map_book = std::make_unique<OrderBook>(BOOK_ORDERS);
+            bench_book_engine("OrderBook", *map_book, far_share);
+            auto array_book = std::make_unique<ArrayOrderBook>(1500, BOOK_ORDERS);
+            bench_book_engine("ArrayOrderBook", *array_book, far_share);
+        }
+    }
+
+    /* Depth snapshots while updates flow: a resting book of DEPTH_RESTING orders, then every update cancels a random live
+     * order and adds one on the same side, mostly within 20 ticks of the inside so the top levels keep changing
+     * The update pass is run bare and again with a depth-10 snapshot of both sides after every update, the difference
+     * is what the snapshots cost in the flow. A third pass stamps each snapshot on its own for p50/p99
+     */
+    constexpr size_t DEPTH_RESTING = 1 << 16;
+    constexpr size_t DEPTH_UPDATES = 1 << 20;
+    constexpr size_t DEPTH_LEVELS = 10;
+
+    template<typename Book>
+    void bench_depth_engine(const char* name, std::unique_ptr<Book> (*make_book)()) {
+        struct Update {
+            uint64_t cancel_id;
+            uint32_t price;
+            bool is_buy;
+        };
+        std::mt19937 rng(9);
+        auto draw_price = [&rng](bool is_buy) {
+            uint32_t away = rng() % 5 != 0 ? 1 + rng() % 20 : 1 + rng() % 500;
+            return is_buy ? 1500 - away : 1500 + away;
+        };
+        std::vector<std::pair<uint64_t, uint32_t>> resting;  // id, price
+        std::vector<uint64_t> live[2];
+        for (size_t i = 0; i < DEPTH_RESTING; ++i) {
+            bool is_buy = i & 1;
+            resting.push_back({i + 1, draw_price(is_buy)});
+            live[is_buy].push_back(i + 1);
+        }
+        std::vector<Update> updates(DEPTH_UPDATES);
+        for (size_t i = 0; i < DEPTH_UPDATES; ++i) {
+            Update& update = updates[i];
+            update.is_buy = rng() & 1;
+            std::vector<uint64_t>& side = live[update.is_buy];
+            size_t at = rng() % side.size();
+            update.cancel_id = side[at];
+            update.price = draw_price(update.is_buy);
+            side[at] = DEPTH_RESTING + i + 1;  // The order added in its place
+        }
+
+        uint32_t prices[DEPTH_LEVELS];
+        uint64_t quantities[DEPTH_LEVELS];
+        uint32_t order_counts[DEPTH_LEVELS];
+        DepthSpan out{prices, quantities, order_counts};
+        auto snapshot_latency = std::make_unique<LatencyHistogram>();
+        uint64_t cycles[2] = {};
+        size_t levels = 0;
+        for (int pass = 0; pass < 3; ++pass) {
+            std::unique_ptr<Book> book = make_book();
+            for (size_t i = 0; i < DEPTH_RESTING; ++i) book->addOrder(resting[i].first, resting[i].second, 100, i & 1);
+            uint64_t start = TscClock::now();
+            for (size_t i = 0; i < DEPTH_UPDATES; ++i) {
+                const Update& update = updates[i];
+                book->removeOrder(update.cancel_id);
+                book->addOrder(DEPTH_RESTING + i + 1, update.price, 100, update.is_buy);
+                if (pass == 0) continue;
+                uint64_t snapshot_start = pass == 2 ? TscClock::now_precise() : 0;
+                levels += book->getDepth(DEPTH_LEVELS, true, out);
+                keep(prices[0]);
+                levels += book->getDepth(DEPTH_LEVELS, false, out);
+                keep(prices[0]);
+                if (pass == 2) snapshot_latency->record(TscClock::now_precise() - snapshot_start);
+            }
+            if (pass < 2) cycles[pass] = TscClock::now_precise() - start;
+        }
+        double update_ns = ns_per_op(cycles[0], DEPTH_UPDATES);
+        double with_depth_ns = ns_per_op(cycles[1], DEPTH_UPDATES);
+        std::printf("  %-16s update %6.1f ns   update + depth %6.1f ns   snapshot %5.1f ns in the flow   %.1f levels/side\n",
+                    name, update_ns, with_depth_ns, with_depth_ns - update_ns, levels / (4.0 * DEPTH_UPDATES));
+        print_percentiles("snapshot", *snapshot_latency);
+    }
+
+    void bench_depth() {
+        std::printf("depth: %zu resting orders, %zu cancel + add updates, depth-%zu of both sides after each\n", DEPTH_RESTING,
+                    DEPTH_UPDATES, DEPTH_LEVELS);
+        bench_depth_engine<OrderBook>("OrderBook", [] { return std::make_unique<OrderBook>(DEPTH_RESTING * 2); });
+        bench_depth_engine<ArrayOrderBook>("ArrayOrderBook", [] { return std::make_unique<ArrayOrderBook>(1500, DEPTH_RESTING * 2); });
+    }
+
+    /* Order id index: FlatHashIndex against the std::unordered_map it replaced, at LIVE orders in steady state
+     * Ids are sequential like an exchange's. Each round looks up a random live id, inserts the next id and erases a
+     * random live one, every call timed on its own. The unordered_map is filled without reserve, like the old book did
+     */
+    constexpr size_t INDEX_ROUNDS = 1000000;
+
+    struct FlatIndex {
+        FlatHashIndex index;
+        explicit FlatIndex(size_t live) : index(live + 1) {}
+        uint32_t find(uint64_t id) const { return index.find(id); }
+        void insert(uint64_t id, uint32_t value) { index.insert(id, value); }
+        void erase(uint64_t id) { index.erase(id); }
+    };
+
+    struct StdIndex {
+        std::unordered_map<uint64_t, uint32_t> index;
+        explicit StdIndex(size_t) {}
+        uint32_t find(uint64_t id) const {
+            auto it = index.find(id);
+            return it == index.end() ? FlatHashIndex::NOT_FOUND : it->second;
+        }
+        void insert(uint64_t id, uint32_t value) { index.emplace(id, value); }
+        void erase(uint64_t id) { index.erase(id); }
+    };
+
+    template<typename Index>
+    void bench_index_at(const char* name, size_t live) {
+        auto index = std::make_unique<Index>(live);
+        std::vector<uint64_t> ids(live);
+        uint64_t next_id = 1;
+        for (size_t i = 0; i < live; ++i) {
+            ids[i] = next_id++;
+            index->insert(ids[i], static_cast<uint32_t>(i));
+        }
+
+        auto find_latency = std::make_unique<LatencyHistogram>();
+        auto insert_latency = std::make_unique<LatencyHistogram>();
+        auto erase_latency = std::make_unique<LatencyHistogram>();
+        std::mt19937_64 rng(3);
+        uint64_t found = 0;
+        for (size_t round = 0; round < INDEX_ROUNDS; ++round) {
+            uint64_t id = ids[rng() % live];
+            uint64_t start = TscClock::now_precise();
+            found += index->find(id);
+            find_latency->record(TscClock::now_precise() - start);
+            keep(found);
+
+            start = TscClock::now_precise();
+            index->insert(next_id, static_cast<uint32_t>(round));
+            insert_latency->record(TscClock::now_precise() - start);
+
+            size_t victim = rng() % live;
+            start = TscClock::now_precise();
+            index->erase(ids[victim]);
+            erase_latency->record(TscClock::now_precise() - start);
+            ids[victim] = next_id++;
+        }
+
+        std::printf("  %-18s %zu live\n", name, live);
+        print_percentiles("lookup", *find_latency);
+        print_percentiles("insert", *insert_latency);
+        print_percentiles("erase", *erase_latency);
+    }
+
+    void bench_index() {
+        std::printf("index: %zu rounds of lookup + insert + erase\n", INDEX_ROUNDS);
+        for (size_t live : {size_t{1000000}, size_t{10000000}}) {
+            bench_index_at<FlatIndex>("FlatHashIndex", live);
+            bench_index_at<StdIndex>("std::unordered_map", live);
+        }
+    }
+
+    /* Message dispatch: a generated ITCH-style stream replayed through BookManager routing and the dispatch table,
+     * the same lookup + MESSAGE_DISPATCH + book update a worker's applyMessage does
+     * Mix is 50% adds, 40% deletes, 5% partial cancels, 3% partial executions and 2% replaces over 8 symbols. Every
+     * cancel, execute and replace targets an order that is live at that point in the stream
+     * The stream is replayed twice on fresh books: untimed for overall throughput, then stamped per message for per type
+     */
+    constexpr size_t DISPATCH_MESSAGES = 2000000;
+
+    std::vector<MarketDataMessage> make_message_stream(const std::vector<InstrumentConfig>& instruments) {
+        struct LiveOrder {
+            uint64_t id;
+            uint32_t symbol;
+            uint32_t quantity;
+        };
+        std::vector<MarketDataMessage> stream(DISPATCH_MESSAGES);
+        std::vector<LiveOrder> live;
+        std::mt19937_64 rng(5);
+        uint64_t next_id = 1;
+        for (MarketDataMessage& msg : stream) {
+            msg = {};
+            unsigned draw = rng() % 100;
+            if (live.empty() || draw < 50) {
+                uint32_t symbol = static_cast<uint32_t>(rng() % instruments.size());
+                LiveOrder order{next_id++, symbol, 100 + static_cast<uint32_t>(rng() % 900)};
+                msg.message_type = 'A';
+                msg.order_id = order.id;
+                msg.side = rng() & 1 ? 'B' : 'S';
+                msg.price = instruments[symbol].reference_price - 50 + static_cast<uint32_t>(rng() % 100);
+                msg.quantity = order.quantity;
+                uint64_t packed = BookManager::pack_symbol(instruments[symbol].symbol);
+                std::memcpy(msg.symbol, &packed, sizeof(msg.symbol));
+                live.push_back(order);
+                continue;
+            }
+            size_t at = rng() % live.size();
+            LiveOrder& order = live[at];
+            uint64_t packed = BookManager::pack_symbol(instruments[order.symbol].symbol);
+            std::memcpy(msg.symbol, &packed, sizeof(msg.symbol));
+            msg.order_id = order.id;
+            if (draw < 90 || order.quantity < 2) {
+                msg.message_type = 'D';
+                live[at] = live.back();
+                live.pop_back();
+            } else if (draw < 98) {
+                msg.message_type = draw < 95 ? 'X' : 'E';
+                msg.quantity = 1 + static_cast<uint32_t>(rng() % (order.quantity - 1));  // Partial, the order stays live
+                order.quantity -= msg.quantity;
+            } else {
+                msg.message_type = 'U';
+                msg.price = instruments[order.symbol].reference_price - 50 + static_cast<uint32_t>(rng() % 100);
+                msg.quantity = order.quantity = 100 + static_cast<uint32_t>(rng() % 900);
+            }
+        }
+        return stream;
+    }
+
+    std::vector<InstrumentConfig> dispatch_instruments() {
+        return {
+                {"AAPL", 1500}, {"MSFT", 1500}, {"AMZN", 1500}, {"GOOGL", 1500},
+                {"META", 1500}, {"NVDA", 1500}, {"TSLA", 1500}, {"JPM", 1500},
+        };
+    }
+
+    void bench_dispatch() {
+        const std::vector<InstrumentConfig> instruments = dispatch_instruments();
+        std::vector<MarketDataMessage> stream = make_message_stream(instruments);
+        constexpr size_t MAX_ORDERS_PER_BOOK = 1 << 17;
+
+        auto books = std::make_unique<BookManager>(instruments, MAX_ORDERS_PER_BOOK);
+        uint64_t start = TscClock::now();
+        for (const MarketDataMessage& msg : stream) {
+            uint32_t instrument = books->lookup(msg.symbol);
+            MESSAGE_DISPATCH[static_cast<uint8_t>(msg.message_type)].handler(books->book(instrument), msg);
+        }
+        uint64_t total = TscClock::now_precise() - start;
+        std::printf("dispatch: %zu messages, %s engine, %.1f ns/msg, %.2fM msgs/s\n", stream.size(),
+                    sizeof(BookEngine) == sizeof(OrderBook) ? "OrderBook" : "ArrayOrderBook",
+                    ns_per_op(total, stream.size()), stream.size() * 1e3 / TscClock::to_ns(total));
+
+        books = std::make_unique<BookManager>(instruments, MAX_ORDERS_PER_BOOK);
+        uint64_t cycles[static_cast<size_t>(MessageKind::Count)] = {};
+        uint64_t counts[static_cast<size_t>(MessageKind::Count)] = {};
+        // One rdtsc per message, each message gets the time since the previous stamp. Unfenced so cache misses of
+        // neighbouring messages still overlap the way they do untimed, the types' shares add up to the whole run
+        uint64_t first = TscClock::now();
+        uint64_t previous = first;
+        for (const MarketDataMessage& msg : stream) {
+            const MessageDispatchEntry& dispatch = MESSAGE_DISPATCH[static_cast<uint8_t>(msg.message_type)];
+            dispatch.handler(books->book(books->lookup(msg.symbol)), msg);
+            uint64_t now = TscClock::now();
+            cycles[static_cast<size_t>(dispatch.kind)] += now - previous;
+            ++counts[static_cast<size_t>(dispatch.kind)];
+            previous = now;
+        }
+        std::printf("  stamped run %.1f ns/msg, the difference is what the stamps cost\n", ns_per_op(previous - first, stream.size()));
+        for (size_t kind = 0; kind < static_cast<size_t>(MessageKind::Count); ++kind) {
+            if (counts[kind] == 0) continue;
+            std::printf("  %-8s %8llu messages (%4.1f%%)   %6.1f ns/msg   %6.2fM msgs/s\n", MESSAGE_KIND_NAMES[kind],
+                        static_cast<unsigned long long>(counts[kind]), counts[kind] * 100.0 / stream.size(),
+                        ns_per_op(cycles[kind], counts[kind]), counts[kind] * 1e3 / TscClock::to_ns(cycles[kind]));
+        }
+    }
+
+    /* Strategy hook: the dispatch stream applied the way applyMessage does it, with the top change check, the BBO publish
+     * and the SpreadStrategy callback after each message, against plain dispatch of the same stream
+     * Books flag a top change while applying, so a message that leaves the top alone costs the hook one flag test
+     * The callback percentiles are the strategy's own histogram: book update done to callback entry
+     */
+    void bench_strategy() {
+        const std::vector<InstrumentConfig> instruments = dispatch_instruments();
+        std::vector<MarketDataMessage> stream = make_message_stream(instruments);
+        constexpr size_t MAX_ORDERS_PER_BOOK = 1 << 17;
+
+        auto books = std::make_unique<BookManager>(instruments, MAX_ORDERS_PER_BOOK);
+        uint64_t start = TscClock::now();
+        for (const MarketDataMessage& msg : stream) {
+            uint32_t instrument = books->lookup(msg.symbol);
+            MESSAGE_DISPATCH[static_cast<uint8_t>(msg.message_type)].handler(books->book(instrument), msg);
+        }
+        uint64_t plain = TscClock::now_precise() - start;
+
+        books = std::make_unique<BookManager>(instruments, MAX_ORDERS_PER_BOOK);
+        auto strategy = std::make_unique<SpreadStrategy>();
+        size_t changes = 0;
+        uint64_t hook = 0;
+        start = TscClock::now();
+        for (const MarketDataMessage& msg : stream) {
+            uint32_t instrument = books->lookup(msg.symbol);
+            BookEngine& book = books->book(instrument);
+            MESSAGE_DISPATCH[static_cast<uint8_t>(msg.message_type)].handler(book, msg);
+            if (book.take_top_change()) {
+                uint64_t end = TscClock::now();
+                TopOfBook top = book.top();
+                books->publish_top(instrument, top, end);
+                strategy->top_of_book_changed({instrument, books->symbol(instrument), top, msg.rx_tsc, end});
+                hook += TscClock::now() - end;
+                ++changes;
+            }
+        }
+        uint64_t hooked = TscClock::now_precise() - start;
+
+        std::printf("strategy: %zu messages, %zu moved a top (%.1f%%), %llu spread signals\n", stream.size(), changes,
+                    changes * 100.0 / stream.size(), static_cast<unsigned long long>(strategy->signals()));
+        std::printf("  dispatch only  %6.1f ns/msg\n", ns_per_op(plain, stream.size()));
+        std::printf("  with the hook  %6.1f ns/msg   %.1f ns per top change for top, publish and callback\n",
+                    ns_per_op(hooked, stream.size()), ns_per_op(hook, changes));
+        print_percentiles("callback", strategy->latency());
+    }
+
+    /* Batch decode kernels: GB/s of wire input through each kernel the CPU can run, and parse_batch as dispatched
+     * The buffer fits in L2, so this is the decoder and not memory bandwidth. mdp-simdcheck checks they agree
+     */
+    constexpr size_t PARSE_MESSAGES = 4096;
+    constexpr size_t PARSE_ROUNDS = 500;
+
+    void print_parse(const char* name, uint64_t cycles) {
+        size_t messages = PARSE_MESSAGES * PARSE_ROUNDS;
+        double ns = static_cast<double>(TscClock::to_ns(cycles));
+        std::printf("  %-14s %5.2f GB/s   %5.2f ns/msg\n", name, messages * SIMDMessageParser::WIRE_SIZE / ns,
+                    ns_per_op(cycles, messages));
+    }
+
+    void bench_parse() {
+        using Simd = WireSchemaSimd<MarketDataWireSchema>;
+        struct Kernel {
+            const char* name;
+            Simd::DecodeBlockFn fn;
+        };
+        const Kernel kernels[] = {
+                {"scalar", Simd::decode_block_scalar},
+                {"SSSE3", Simd::decode_block_ssse3},
+                {"AVX2", Simd::decode_block_avx2},
+                {"AVX-512 VBMI", Simd::decode_block_avx512},
+        };
+        static_assert(PARSE_MESSAGES % Simd::BLOCK == 0);
+
+        std::mt19937 rng(5);
+        std::vector<char> wire(PARSE_MESSAGES * SIMDMessageParser::WIRE_SIZE);
+        for (auto& b : wire) b = static_cast<char>(rng());
+        std::vector<MarketDataMessage> out(PARSE_MESSAGES);
+
+        std::printf("parse: %zu messages of %zu bytes, %zu rounds\n", PARSE_MESSAGES, SIMDMessageParser::WIRE_SIZE, PARSE_ROUNDS);
+        for (const Kernel& kernel : kernels) {
+            if (!Simd::supported(kernel.fn)) {
+                std::printf("  %-14s not supported here\n", kernel.name);
+                continue;
+            }
+            uint64_t start = TscClock::now();
+            for (size_t round = 0; round < PARSE_ROUNDS; ++round) {
+                for (size_t i = 0; i < PARSE_MESSAGES; i += Simd::BLOCK) {
+                    kernel.fn(wire.data() + i * SIMDMessageParser::WIRE_SIZE, out.data() + i);
+                }
+                keep(out[round % PARSE_MESSAGES]);
+            }
+            print_parse(kernel.name, TscClock::now_precise() - start);
+        }
+
+        uint64_t start = TscClock::now();
+        for (size_t round = 0; round < PARSE_ROUNDS; ++round) {
+            SIMDMessageParser::parse_batch(wire.data(), PARSE_MESSAGES, out.data());
+            keep(out[round % PARSE_MESSAGES]);
+        }
+        print_parse("parse_batch", TscClock::now_precise() - start);
+    }
+
+    /* Order stream receive: orders used in place in their packet (the zero-copy path) vs reassembled and copied out of
+     * the TCP stack. Same stream both ways, 4 orders per segment. Cut on frame boundaries every segment is consumed in
+     * place, shifted by half an order every segment ends mid-order and the whole stream goes through reassembly
+     * Per order: header walk, frame walk or reassembly, decode into an Order, the RX core's work in receive_burst
+     * without the mbufs and rings. mdp-rxcheck checks that path allocates nothing
+     */
+    constexpr size_t RX_ORDERS = 1 << 16;
+    constexpr size_t RX_ORDERS_PER_SEGMENT = 4;
+    constexpr size_t RX_ROUNDS = 20;
+    constexpr size_t RX_FRAME_LEN = FRAME_HEADER_LEN + OrderProtocol::WIRE_SIZE;
+
+    void put_be16(uint8_t* p, uint16_t v) {
+        p[0] = static_cast<uint8_t>(v >> 8);
+        p[1] = static_cast<uint8_t>(v);
+    }
+
+    void put_be32(uint8_t* p, uint32_t v) {
+        put_be16(p, static_cast<uint16_t>(v >> 16));
+        put_be16(p + 2, static_cast<uint16_t>(v));
+    }
+
+    // Ethernet/IPv4/TCP frame carrying len bytes of the stream from stream position seq, one flow per remote port
+    std::vector<uint8_t> rx_segment(uint32_t seq, const uint8_t* payload, size_t len, uint16_t remote_port = 40000) {
+        std::vector<uint8_t> frame(TCPIPStack::HEADERS_LEN + len);
+        put_be16(frame.data() + 12, 0x0800);
+        uint8_t* ip = frame.data() + TCPIPStack::ETHER_HEADER_LEN;
+        ip[0] = 0x45;
+        put_be16(ip + 2, static_cast<uint16_t>(frame.size() - TCPIPStack::ETHER_HEADER_LEN));
+        ip[8] = 64;
+        ip[9] = 6;
+        put_be32(ip + 12, 0x0A000002);
+        put_be32(ip + 16, 0x0A000001);
+        uint8_t* tcp = ip + TCPIPStack::IPV4_HEADER_LEN;
+        put_be16(tcp, remote_port);
+        put_be16(tcp + 2, 12345);
+        put_be32(tcp + 4, seq);
+        tcp[12] = (TCPIPStack::TCP_HEADER_LEN / 4) << 4;
+        tcp[13] = TCP_FLAG_PSH | TCP_FLAG_ACK;
+        std::memcpy(frame.data() + TCPIPStack::HEADERS_LEN, payload, len);
+        return frame;
+    }
+
+    // The stream cut into segments of RX_ORDERS_PER_SEGMENT orders, the first one first_len bytes long
+    std::vector<std::vector<uint8_t>> rx_segments(const std::vector<uint8_t>& stream, size_t first_len) {
+        std::vector<std::vector<uint8_t>> segments;
+        for (size_t at = 0, len = first_len; at < stream.size(); at += len, len = RX_ORDERS_PER_SEGMENT * RX_FRAME_LEN) {
+            len = std::min(len, stream.size() - at);
+            segments.push_back(rx_segment(static_cast<uint32_t>(at), stream.data() + at, len));
+        }
+        return segments;
+    }
+
+    // What receive_burst does per packet: whole frames in place, then whatever reassembly has completed
+    void bench_rx_path(const char* name, const std::vector<std::vector<uint8_t>>& segments) {
+        uint64_t cycles = 0;
+        uint64_t in_place = 0;
+        uint64_t copied = 0;
+        for (size_t round = 0; round < RX_ROUNDS; ++round) {
+            auto stack = std::make_unique<TCPIPStack>();
+            uint64_t sum = 0;
+            uint64_t start = TscClock::now();
+            for (const auto& segment : segments) {
+                const uint8_t* payload = nullptr;
+                size_t len = stack->locate_payload(segment.data(), segment.size(), &payload);
+                for (size_t offset = 0; offset < len; offset += FRAME_HEADER_LEN + frame_payload_length(payload + offset)) {
+                    sum += OrderProtocol::deserialize_order(payload + offset + FRAME_HEADER_LEN, sizeof(Order)).order_id;
+                    ++in_place;
+                }
+                uint8_t message[sizeof(Order)];
+                while (stack->get_next_message(message, sizeof(message)) == sizeof(Order)) {
+                    sum += OrderProtocol::deserialize_order(message, sizeof(Order)).order_id;
+                    ++copied;
+                }
+            }
+            cycles += TscClock::now_precise() - start;
+            keep(sum);
+        }
+        std::printf("  %-10s %6.1f ns/order   %5.2fM orders/s   %llu in place, %llu copied\n", name,
+                    ns_per_op(cycles, RX_ORDERS * RX_ROUNDS), RX_ORDERS * RX_ROUNDS * 1e3 / TscClock::to_ns(cycles),
+                    static_cast<unsigned long long>(in_place), static_cast<unsigned long long>(copied));
+    }
+
+    // One order with its length prefix, RX_FRAME_LEN bytes
+    void write_order_frame(uint8_t* frame, uint64_t order_id) {
+        frame[0] = static_cast<uint8_t>(OrderProtocol::WIRE_SIZE);
+        frame[1] = static_cast<uint8_t>(OrderProtocol::WIRE_SIZE >> 8);
+        Order order{order_id, 1000, 100, (order_id & 1) == 0, {'T', 'E', 'S', 'T', ' ', ' ', ' ', ' '}};
+        OrderProtocol::serialize_order(order, std::span<uint8_t>(frame + FRAME_HEADER_LEN, OrderProtocol::WIRE_SIZE));
+    }
+
+    void bench_rx() {
+        std::vector<uint8_t> stream(RX_ORDERS * RX_FRAME_LEN);
+        for (size_t i = 0; i < RX_ORDERS; ++i) write_order_frame(stream.data() + i * RX_FRAME_LEN, i + 1);
+        std::printf("rx: %zu orders of %zu bytes on one flow, %zu per segment, %zu rounds\n", RX_ORDERS, OrderProtocol::WIRE_SIZE,
+                    RX_ORDERS_PER_SEGMENT, RX_ROUNDS);
+        bench_rx_path("in place", rx_segments(stream, RX_ORDERS_PER_SEGMENT * RX_FRAME_LEN));
+        bench_rx_path("copied", rx_segments(stream, RX_FRAME_LEN / 2));
+    }
+
+    /* Order entry framing: an Order serialized in place behind the prebuilt headers and sealed, what OrderSender::send
+     * does per order minus the mbuf. Frames rotate through a TX batch worth of buffers, as staged mbufs would
+     * Software checksums vs offload (the TCP checksum only seeded with the pseudo-header sum). mdp-sendcheck runs the
+     * whole send path through tx_burst, counts its allocations and reports tick-to-trade
+     */
+    constexpr size_t TX_ORDERS = 1 << 20;
+    constexpr size_t TX_FRAMES = 32;
+    constexpr size_t TX_FRAME_ROOM = 128;
+
+    void bench_order_mode(const char* name, ChecksumMode checksums) {
+        auto stack = std::make_unique<TCPIPStack>(1);
+        stack->set_link({{0x02, 0, 0, 0, 0, 0x01}, {0x02, 0, 0, 0, 0, 0x02}, 0x0A000001, 40000});
+        TCPIPStack::FrameTemplate tmpl;
+        stack->build_template(0x0A000002, 9000, tmpl);
+        auto frames = std::make_unique<uint8_t[]>(TX_FRAMES * TX_FRAME_ROOM);
+        auto frame_latency = std::make_unique<LatencyHistogram>();
+        uint64_t bytes = 0;
+        uint64_t cycles = 0;
+        for (bool stamped : {false, true}) {
+            uint64_t start = TscClock::now();
+            for (size_t i = 0; i < TX_ORDERS; ++i) {
+                uint64_t order_start = stamped ? TscClock::now_precise() : 0;
+                Order order{i + 1, 1000 + static_cast<uint32_t>(i % 16), 100, (i & 1) != 0, {'T', 'E', 'S', 'T', ' ', ' ', ' ', ' '}};
+                uint8_t* frame = frames.get() + (i % TX_FRAMES) * TX_FRAME_ROOM;
+                size_t len = OrderProtocol::serialize_order(order, {frame + TCPIPStack::PAYLOAD_OFFSET, TX_FRAME_ROOM - TCPIPStack::PAYLOAD_OFFSET});
+                bytes += stack->seal_frame(tmpl, frame, len, checksums);
+                if (stamped) frame_latency->record(TscClock::now_precise() - order_start);
+            }
+            if (!stamped) cycles = TscClock::now_precise() - start;
+        }
+        keep(bytes);
+        std::printf("  %-10s %6.1f ns/order   %6.2fM orders/s   %zu byte frames\n", name, ns_per_op(cycles, TX_ORDERS),
+                    TX_ORDERS * 1e3 / TscClock::to_ns(cycles), static_cast<size_t>(bytes / (2 * TX_ORDERS)));
+        print_percentiles("per order", *frame_latency);
+    }
+
+    void bench_order() {
+        std::printf("order: %zu orders serialized in place and sealed into frames, no mbufs\n", TX_ORDERS);
+        bench_order_mode("software", ChecksumMode::Software);
+        bench_order_mode("offload", ChecksumMode::Offload);
+    }
+
+    /* Connection table and ready list: one order per segment through process_packet and get_next_message (the
+     * reassembly path) with 1, 100 and 10,000 connections open. With one busy connection among idle ones the ready list
+     * keeps the per-message cost flat. With every connection busy in turn, the table lookups and the rings miss cache
+     * Every connection is opened and drained before the clock starts
+     */
+    constexpr size_t CONN_MESSAGES = 1 << 18;
+    constexpr uint16_t CONN_FIRST_PORT = 20000;
+
+    void bench_conn_at(size_t connections) {
+        auto stack = std::make_unique<TCPIPStack>(connections);
+        std::vector<uint32_t> next_seq(connections, 0);
+        uint64_t next_id = 1;
+        auto segment_for = [&](size_t connection) {
+            uint8_t frame[RX_FRAME_LEN];
+            write_order_frame(frame, next_id++);
+            uint32_t seq = next_seq[connection];
+            next_seq[connection] += RX_FRAME_LEN;
+            return rx_segment(seq, frame, RX_FRAME_LEN, static_cast<uint16_t>(CONN_FIRST_PORT + connection));
+        };
+        uint8_t message[sizeof(Order)];
+        for (size_t connection = 0; connection < connections; ++connection) {
+            std::vector<uint8_t> segment = segment_for(connection);
+            stack->process_packet(segment.data(), segment.size());
+            while (stack->get_next_message(message, sizeof(message)) != 0) {}
+        }
+        if (stack->connection_count() != connections) {
+            std::printf("  %zu connections: only %zu opened\n", connections, stack->connection_count());
+            return;
+        }
+
+        for (bool all_busy : {false, true}) {
+            std::vector<std::vector<uint8_t>> segments;
+            segments.reserve(CONN_MESSAGES);
+            for (size_t i = 0; i < CONN_MESSAGES; ++i) segments.push_back(segment_for(all_busy ? i % connections : 0));
+            uint64_t sum = 0;
+            size_t delivered = 0;
+            uint64_t start = TscClock::now();
+            for (const auto& segment : segments) {
+                stack->process_packet(segment.data(), segment.size());
+                while (stack->get_next_message(message, sizeof(message)) == sizeof(Order)) {
+                    sum += OrderProtocol::deserialize_order(message, sizeof(Order)).order_id;
+                    ++delivered;
+                }
+            }
+            uint64_t total = TscClock::now_precise() - start;
+            keep(sum);
+            std::printf("  %6zu connections  %-8s %6.1f ns/msg   %5.2fM msgs/s%s\n", connections, all_busy ? "all busy" : "one busy",
+                        ns_per_op(total, CONN_MESSAGES), CONN_MESSAGES * 1e3 / TscClock::to_ns(total),
+                        delivered == CONN_MESSAGES ? "" : "   MESSAGES MISSING");
+        }
+    }
+
+    void bench_conn() {
+        std::printf("conn: %zu orders, one per segment, through the connection table, reassembly and the ready list\n", CONN_MESSAGES);
+        for (size_t connections : {size_t{1}, size_t{100}, size_t{10000}}) bench_conn_at(connections);
+    }
+
+    /* Cross-core rings: SPSCRing vs the old LockFreeRingBuffer vs DPDK's rte_ring in single producer/consumer mode
+     * Sequence numbers go from a producer thread to a consumer thread, which checks they arrive in order. Throughput
+     * at burst 1 and at a full RX burst of 32, then half the round trip of a ping-pong over two rings, p50/p99
+     * Producer and consumer are pinned to the first two CPUs of the affinity mask, so run it under taskset with two
+     * isolated cores on one socket. rte_ring is set up with rte_ring_init in plain memory, no EAL needed
+     */
+    constexpr size_t RING_SLOTS = 1024;
+    constexpr size_t RING_ITEMS = 1 << 23;
+    constexpr size_t PING_PONGS = 200000;
+
+    struct SpscRingAdapter {
+        static constexpr const char* NAME = "SPSCRing";
+        SPSCRing<uint64_t, RING_SLOTS> ring;
+
+        bool ready() const { return true; }
+        size_t push(const uint64_t* items, size_t n) { return ring.push_bulk(items, n); }
+        size_t pop(uint64_t* out, size_t n) { return ring.pop_bulk(out, n); }
+    };
+
+    // No bulk calls, a burst is pushed and popped one item at a time
+    struct LockFreeRingAdapter {
+        static constexpr const char* NAME = "LockFreeRingBuffer";
+        LockFreeRingBuffer<uint64_t, RING_SLOTS> ring;
+
+        bool ready() const { return true; }
+        size_t push(const uint64_t* items, size_t n) {
+            size_t pushed = 0;
+            while (pushed < n && ring.push(items[pushed])) ++pushed;
+            return pushed;
+        }
+        size_t pop(uint64_t* out, size_t n) {
+            size_t popped = 0;
+            while (popped < n && ring.pop(out[popped])) ++popped;
+            return popped;
+        }
+    };
+
+    struct RteRingAdapter {
+        static constexpr const char* NAME = "rte_ring SP/SC";
+        std::unique_ptr<std::byte[]> memory;
+        rte_ring* ring = nullptr;
+
+        RteRingAdapter() {
+            ssize_t size = rte_ring_get_memsize(RING_SLOTS);
+            if (size < 0) return;
+            memory = std::make_unique<std::byte[]>(static_cast<size_t>(size) + 64);
+            void* aligned = reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(memory.get()) + 63) & ~uintptr_t{63});
+            if (rte_ring_init(static_cast<rte_ring*>(aligned), "bench", RING_SLOTS, RING_F_SP_ENQ | RING_F_SC_DEQ) == 0) {
+                ring = static_cast<rte_ring*>(aligned);
+            }
+        }
+
+        bool ready() const { return ring != nullptr; }
+        size_t push(const uint64_t* items, size_t n) {
+            return rte_ring_sp_enqueue_burst(ring, reinterpret_cast<void* const*>(items), static_cast<unsigned>(n), nullptr);
+        }
+        size_t pop(uint64_t* out, size_t n) {
+            return rte_ring_sc_dequeue_burst(ring, reinterpret_cast<void**>(out), static_cast<unsigned>(n), nullptr);
+        }
+    };
+    static_assert(sizeof(uint64_t) == sizeof(void*), "rte_ring carries the sequence numbers as pointers");
+
+    struct RingCpus {
+        int producer = -1;
+        int consumer = -1;
+    };
+
+    RingCpus ring_cpus() {
+        cpu_set_t allowed;
+        RingCpus cpus;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed)) continue;
+            if (cpus.producer < 0) cpus.producer = cpu;
+            else if (cpus.consumer < 0) cpus.consumer = cpu;
+        }
+        return cpus;
+    }
+
+    void pin_to(int cpu) {
+        if (cpu < 0) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    // Both threads on one CPU only make progress if the waiting side gives up the CPU
+    void ring_wait(bool shared_cpu) {
+        if (shared_cpu) std::this_thread::yield();
+        else _mm_pause();
+    }
+
+    template<typename Ring>
+    void bench_ring_throughput(const RingCpus& cpus, size_t burst) {
+        auto ring = std::make_unique<Ring>();
+        if (!ring->ready()) {
+            std::printf("  %-18s unavailable, rte_ring_init failed\n", Ring::NAME);
+            return;
+        }
+        bool shared_cpu = cpus.consumer < 0;
+        std::atomic<bool> go{false};
+
+        std::thread producer([&] {
+            pin_to(cpus.producer);
+            uint64_t items[32];
+            uint64_t next = 1;
+            while (!go.load(std::memory_order_acquire)) ring_wait(shared_cpu);
+            while (next <= RING_ITEMS) {
+                size_t n = std::min<size_t>(burst, RING_ITEMS - next + 1);
+                for (size_t i = 0; i < n; ++i) items[i] = next + i;
+                size_t sent = 0;
+                while (sent < n) {
+                    size_t pushed = ring->push(items + sent, n - sent);
+                    if (pushed == 0) ring_wait(shared_cpu);
+                    sent += pushed;
+                }
+                next += n;
+            }
+        });
+
+        pin_to(shared_cpu ? cpus.producer : cpus.consumer);
+        uint64_t items[32];
+        uint64_t expected = 1;
+        uint64_t out_of_order = 0;
+        uint64_t start = TscClock::now();
+        go.store(true, std::memory_order_release);
+        while (expected <= RING_ITEMS) {
+            size_t n = ring->pop(items, burst);
+            if (n == 0) {
+                ring_wait(shared_cpu);
+                continue;
+            }
+            for (size_t i = 0; i < n; ++i) out_of_order += items[i] != expected++;
+        }
+        uint64_t total = TscClock::now_precise() - start;
+        producer.join();
+
+        std::printf("  %-18s burst %2zu   %6.2fM items/s   %6.2f ns/item%s\n", Ring::NAME, burst,
+                    RING_ITEMS * 1e3 / TscClock::to_ns(total), ns_per_op(total, RING_ITEMS),
+                    out_of_order ? "   OUT OF ORDER" : "");
+    }
+
+    // Item out on one ring, echoed back on the other. Half a round trip is one cross-core hand-off
+    template<typename Ring>
+    void bench_ring_ping_pong(const RingCpus& cpus) {
+        auto there = std::make_unique<Ring>();
+        auto back = std::make_unique<Ring>();
+        if (!there->ready() || !back->ready()) return;
+        std::atomic<bool> done{false};
+
+        std::thread echo([&] {
+            pin_to(cpus.consumer);
+            uint64_t item;
+            while (!done.load(std::memory_order_relaxed)) {
+                if (there->pop(&item, 1) == 1) {
+                    while (back->push(&item, 1) == 0) _mm_pause();
+                } else {
+                    _mm_pause();
+                }
+            }
+        });
+
+        pin_to(cpus.producer);
+        auto half_round_trip = std::make_unique<LatencyHistogram>();
+        for (uint64_t i = 0; i < PING_PONGS; ++i) {
+            uint64_t start = TscClock::now_precise();
+            while (there->push(&i, 1) == 0) _mm_pause();
+            uint64_t item;
+            while (back->pop(&item, 1) == 0) _mm_pause();
+            half_round_trip->record((TscClock::now_precise() - start) / 2);
+        }
+        done.store(true, std::memory_order_relaxed);
+        echo.join();
+        print_percentiles(Ring::NAME, *half_round_trip);
+    }
+
+    void bench_ring() {
+        RingCpus cpus = ring_cpus();
+        if (cpus.consumer < 0) {
+            std::printf("ring: only CPU %d allowed, both sides share it and yield while waiting. Not a cross-core number\n", cpus.producer);
+        } else {
+            std::printf("ring: producer on CPU %d, consumer on CPU %d, %zu slots, %zu items\n", cpus.producer, cpus.consumer,
+                        RING_SLOTS, RING_ITEMS);
+        }
+        for (size_t burst : {size_t{1}, size_t{32}}) {
+            bench_ring_throughput<SpscRingAdapter>(cpus, burst);
+            bench_ring_throughput<LockFreeRingAdapter>(cpus, burst);
+            bench_ring_throughput<RteRingAdapter>(cpus, burst);
+        }
+        if (cpus.consumer < 0) return;
+        std::printf("  one-way hand-off, half of a ping-pong round trip over two rings:\n");
+        bench_ring_ping_pong<SpscRingAdapter>(cpus);
+        bench_ring_ping_pong<LockFreeRingAdapter>(cpus);
+        bench_ring_ping_pong<RteRingAdapter>(cpus);
+        pin_to(cpus.producer);
+    }
+
+    /* Sharded dispatch: the dispatch stream over 64 symbols, routed by one producer thread to the owning shard's
+     * SPSC ring the way an RX core does, and applied by 1..N worker threads the way lcore_worker does
+     * Books are spread over the workers by BookManager's symbol hash. Throughput is the whole stream, from the first
+     * push to the last worker done, per worker counts show how even the spread is
+     * Every thread gets its own CPU of the affinity mask, so N stops at CPUs - 1. Run it under taskset on isolated cores
+     */
+    constexpr size_t SHARD_SYMBOLS = 64;
+    constexpr size_t SHARD_RING_SLOTS = 4096;
+    constexpr size_t SHARD_BURST = 32;
+    constexpr uint16_t SHARD_MAX_WORKERS = 16;
+
+    std::vector<int> allowed_cpus() {
+        cpu_set_t allowed;
+        std::vector<int> cpus;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    // Messages per second with this many workers
+    double bench_shard_workers(const std::vector<InstrumentConfig>& instruments, const std::vector<MarketDataMessage>& stream,
+                               const std::vector<int>& cpus, uint16_t workers, double baseline) {
+        using ShardRing = SPSCRing<MarketDataMessage, SHARD_RING_SLOTS>;
+        constexpr size_t MAX_ORDERS_PER_BOOK = 1 << 15;
+        auto books = std::make_unique<BookManager>(instruments, MAX_ORDERS_PER_BOOK);
+        books->assign_shards(workers);
+        std::vector<std::unique_ptr<ShardRing>> rings;
+        for (uint16_t w = 0; w < workers; ++w) rings.push_back(std::make_unique<ShardRing>());
+        bool shared_cpu = cpus.size() < workers + 1u;
+        std::atomic<bool> go{false};
+        std::atomic<bool> produced{false};
+        std::vector<uint64_t> applied(workers);
+        std::vector<uint64_t> finished(workers);
+
+        std::vector<std::thread> threads;
+        for (uint16_t w = 0; w < workers; ++w) {
+            threads.emplace_back([&, w] {
+                pin_to(cpus.empty() ? -1 : cpus[(w + 1u) % cpus.size()]);
+                ShardRing& ring = *rings[w];
+                MarketDataMessage batch[SHARD_BURST];
+                uint64_t count = 0;
+                while (!go.load(std::memory_order_acquire)) ring_wait(shared_cpu);
+                while (true) {
+                    bool last = produced.load(std::memory_order_acquire);  // Before the pop, an empty pop after it is the end
+                    size_t n = ring.pop_bulk(batch, SHARD_BURST);
+                    if (n == 0) {
+                        if (last) break;
+                        ring_wait(shared_cpu);
+                        continue;
+                    }
+                    for (size_t i = 0; i < n; ++i) {
+                        uint32_t instrument = books->lookup(batch[i].symbol);
+                        MESSAGE_DISPATCH[static_cast<uint8_t>(batch[i].message_type)].handler(books->book(instrument), batch[i]);
+                    }
+                    count += n;
+                }
+                applied[w] = count;
+                finished[w] = TscClock::now_precise();
+            });
+        }
+
+        // Staged per shard and pushed a burst at a time, like receive_burst
+        pin_to(cpus.empty() ? -1 : cpus[0]);
+        std::vector<MarketDataMessage> staged(static_cast<size_t>(workers) * SHARD_BURST);
+        std::vector<size_t> staged_count(workers);
+        auto flush = [&](uint16_t shard) {
+            const MarketDataMessage* items = &staged[shard * SHARD_BURST];
+            size_t sent = 0;
+            while (sent < staged_count[shard]) {
+                size_t pushed = rings[shard]->push_bulk(items + sent, staged_count[shard] - sent);
+                if (pushed == 0) ring_wait(shared_cpu);
+                sent += pushed;
+            }
+            staged_count[shard] = 0;
+        };
+        uint64_t start = TscClock::now();
+        go.store(true, std::memory_order_release);
+        for (const MarketDataMessage& msg : stream) {
+            uint16_t shard = books->shard_of(books->lookup(msg.symbol));
+            staged[shard * SHARD_BURST + staged_count[shard]++] = msg;
+            if (staged_count[shard] == SHARD_BURST) flush(shard);
+        }
+        for (uint16_t w = 0; w < workers; ++w) flush(w);
+        produced.store(true, std::memory_order_release);
+        for (std::thread& thread : threads) thread.join();
+
+        uint64_t total = *std::max_element(finished.begin(), finished.end()) - start;
+        double rate = stream.size() * 1e3 / TscClock::to_ns(total);
+        std::printf("  %2u worker%s  %6.2fM msgs/s  %5.2fx   per worker:", workers, workers == 1 ? " " : "s", rate,
+                    baseline > 0 ? rate / baseline : 1.0);
+        for (uint64_t count : applied) std::printf(" %.0f%%", count * 100.0 / stream.size());
+        std::printf("\n");
+        return rate;
+    }
+
+    void bench_shard() {
+        std::vector<InstrumentConfig> instruments;
+        for (size_t i = 0; i < SHARD_SYMBOLS; ++i) {
+            char symbol[8];
+            std::snprintf(symbol, sizeof(symbol), "SYM%02zu", i);
+            instruments.push_back({symbol, 1500});
+        }
+        std::vector<MarketDataMessage> stream = make_message_stream(instruments);
+        std::vector<int> cpus = allowed_cpus();
+        uint16_t max_workers = static_cast<uint16_t>(std::clamp<size_t>(cpus.size(), 2, SHARD_MAX_WORKERS + 1) - 1);
+        if (cpus.size() < 2) {
+            std::printf("shard: only %zu CPU allowed, producer and worker share it and yield while waiting. Not a scaling number\n",
+                        cpus.size());
+        } else {
+            std::printf("shard: %zu messages over %zu symbols, producer on CPU %d, up to %u workers on their own CPUs\n",
+                        stream.size(), SHARD_SYMBOLS, cpus[0], max_workers);
+        }
+        std::vector<uint16_t> steps;
+        for (uint16_t workers = 1; workers < max_workers; workers *= 2) steps.push_back(workers);
+        steps.push_back(max_workers);  // Powers of two, then always the most the CPUs allow
+        double baseline = 0;
+        for (uint16_t workers : steps) {
+            double rate = bench_shard_workers(instruments, stream, cpus, workers, baseline);
+            if (workers == 1) baseline = rate;
+        }
+        if (!cpus.empty()) pin_to(cpus[0]);
+    }
+
+    /* BBO publication: one writer publishing a quote per top change as fast as it can, 0, 1 and 4 readers polling the
+     * same record from their own CPUs, the way strategy or risk threads poll BookManager::top_of_book
+     * BboRecord's seqlock against the same quote behind a std::mutex. A retry is a try_read that hit a publish
+     */
+    constexpr size_t BBO_PUBLISHES = 1 << 23;
+
+    struct MutexBbo {
+        mutable std::mutex lock;
+        BboQuote quote;
+
+        void publish(const TopOfBook& top, uint64_t tsc) {
+            std::lock_guard<std::mutex> guard(lock);
+            quote = {top.bid_price, top.ask_price, top.bid_quantity, top.ask_quantity, quote.sequence + 1, tsc};
+        }
+        bool try_read(BboQuote& out) const {
+            std::lock_guard<std::mutex> guard(lock);
+            out = quote;
+            return true;
+        }
+    };
+
+    struct alignas(64) BboReader {
+        uint64_t reads = 0;
+        uint64_t retries = 0;
+        uint64_t cycles = 0;
+    };
+
+    template<typename Record>
+    void bench_bbo_readers(const char* name, const std::vector<int>& cpus, size_t readers) {
+        auto record = std::make_unique<Record>();
+        auto results = std::make_unique<BboReader[]>(readers);
+        bool shared_cpu = cpus.size() < readers + 1;
+        std::atomic<bool> go{false};
+        std::atomic<bool> done{false};
+
+        std::vector<std::thread> threads;
+        for (size_t r = 0; r < readers; ++r) {
+            threads.emplace_back([&, r] {
+                pin_to(cpus.empty() ? -1 : cpus[(r + 1) % cpus.size()]);
+                BboReader& result = results[r];
+                BboQuote quote;
+                while (!go.load(std::memory_order_acquire)) ring_wait(shared_cpu);
+                uint64_t start = TscClock::now();
+                while (!done.load(std::memory_order_relaxed)) {
+                    if (record->try_read(quote)) {
+                        keep(quote);
+                        ++result.reads;
+                    } else {
+                        ++result.retries;
+                        ring_wait(shared_cpu);
+                    }
+                }
+                result.cycles = TscClock::now_precise() - start;
+            });
+        }
+
+        pin_to(cpus.empty() ? -1 : cpus[0]);
+        uint64_t start = TscClock::now();
+        go.store(true, std::memory_order_release);
+        for (uint64_t k = 1; k <= BBO_PUBLISHES; ++k) {
+            record->publish({static_cast<uint32_t>(k), static_cast<uint32_t>(k + 1), k, k}, k);
+        }
+        uint64_t total = TscClock::now_precise() - start;
+        done.store(true, std::memory_order_relaxed);
+        for (std::thread& thread : threads) thread.join();
+
+        uint64_t reads = 0;
+        uint64_t retries = 0;
+        uint64_t read_cycles = 0;
+        for (size_t r = 0; r < readers; ++r) {
+            reads += results[r].reads;
+            retries += results[r].retries;
+            read_cycles += results[r].cycles;
+        }
+        std::printf("  %-10s %zu reader%s  publish %6.1f ns", name, readers, readers == 1 ? " " : "s", ns_per_op(total, BBO_PUBLISHES));
+        if (readers > 0) {
+            std::printf("   read %6.1f ns   %.4f retries/read", ns_per_op(read_cycles, reads),
+                        reads ? static_cast<double>(retries) / static_cast<double>(reads) : 0.0);
+        }
+        std::printf("\n");
+    }
+
+    void bench_bbo() {
+        std::vector<int> cpus = allowed_cpus();
+        if (cpus.size() < 5) {
+            std::printf("bbo: only %zu CPU%s allowed, 4 readers and the writer don't each get one and yield while waiting. "
+                        "Not a cross-core number\n", cpus.size(), cpus.size() == 1 ? "" : "s");
+        } else {
+            std::printf("bbo: %zu publishes, writer on CPU %d, readers on the next CPUs\n", BBO_PUBLISHES, cpus[0]);
+        }
+        for (size_t readers : {size_t{0}, size_t{1}, size_t{4}}) {
+            bench_bbo_readers<BboRecord>("BboRecord", cpus, readers);
+            bench_bbo_readers<MutexBbo>("std::mutex", cpus, readers);
+        }
+        if (!cpus.empty()) pin_to(cpus[0]);
+    }
+
+    struct Bench {
+        const char* name;
+        const char* what;
+        void (*run)();
+    };
+
+    const Bench BENCHES[] = {
+            {"book", "OrderBook vs ArrayOrderBook, ns per add/modify/best/cancel", bench_book},
+            {"depth", "Depth-10 snapshot of both sides after every update, cost in the flow and p50/p99, both engines", bench_depth},
+            {"index", "FlatHashIndex vs std::unordered_map, lookup/insert/erase p50/p99 at 1M and 10M live", bench_index},
+            {"dispatch", "Replay of an add/cancel/execute/replace/delete mix through routing and dispatch, per type", bench_dispatch},
+            {"strategy", "Top change check, BBO publish and strategy callback per message, book update to callback p50/p99", bench_strategy},
+            {"parse", "Batch decode kernels (scalar, SSSE3, AVX2, AVX-512) and parse_batch, GB/s of wire input", bench_parse},
+            {"rx", "Order stream receive, orders used in place vs reassembled and copied, ns per order", bench_rx},
+            {"order", "Order serialized in place and its frame sealed, software vs offloaded checksums, ns per order", bench_order},
+            {"conn", "TCP connection table and ready list at 1, 100 and 10k connections, ns per message", bench_conn},
+            {"ring", "SPSCRing vs LockFreeRingBuffer vs rte_ring, cross-core items/s and hand-off p50/p99", bench_ring},
+            {"bbo", "Seqlocked BboRecord vs a mutex, 1 writer and 0/1/4 readers, ns per publish and read, retries", bench_bbo},
+            {"shard", "Multi-symbol stream routed to 1..N sharded worker threads over SPSC rings, msgs/s scaling", bench_shard},
+    };
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s all|NAME...\n", argv[0]);
+        for (const Bench& bench : BENCHES) std::fprintf(stderr, "  %-10s %s\n", bench.name, bench.what);
+        return 1;
+    }
+    TscClock::calibrate();
+
+    int status = 0;
+    for (int i = 1; i < argc; ++i) {
+        bool all = std::strcmp(argv[i], "all") == 0;
+        bool found = false;
+        for (const Bench& bench : BENCHES) {
+            if (!all && std::strcmp(argv[i], bench.name) != 0) continue;
+            found = true;
+            bench.run();
+        }
+        if (!found) {
+            std::fprintf(stderr, "Unknown benchmark %s\n", argv[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
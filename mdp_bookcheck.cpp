@@ -0,0 +1,432 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "AllocCounter.h"
+#include "ArrayOrderBook.h"
+#include "OrderBook.h"
+#include "TradeBuffer.h"
+
+/* mdp-bookcheck: stress test for the book engines' allocation-free update path
+ * Runs both engines in lockstep through millions of random adds, cancels, modifies, partial executions and replaces,
+ * resting and in matching mode. After a warm-up every heap allocation in the process is counted, the count has to
+ * stay at zero, and the two engines have to agree on the top of book after every update:
+ *
+ *   ./mdp-bookcheck            # 5M updates per mode
+ *   ./mdp-bookcheck 20000000
+ *
+ * Then each engine on its own in matching mode:
+ * - an order with an id that is already live, or with no pool slot left, is rejected before it can trade
+ * - a random stream against a plain std::map/std::deque price-time book: the same fills in the same order, the same
+ *   accept/reject, top, depth and resting order count after every update
+ *
+ * Exits 1 on any allocation or any disagreement
+ */
+
+namespace {
+    constexpr size_t MAX_ORDERS = 1 << 16;
+    constexpr size_t TARGET_LIVE = 20000;       // Adds and cancels are balanced around this many resting orders
+    constexpr size_t WARM_UP_UPDATES = 200000;
+    constexpr uint32_t FAR_PRICE = 100000;      // Far outside the array engine's band, lands in its sparse levels
+
+    struct CheckStats {
+        uint64_t updates = 0;
+        uint64_t allocations = 0;
+        uint64_t mismatches = 0;
+        uint64_t fills[2] = {};
+    };
+
+    bool same_top(const TopOfBook& a, const TopOfBook& b) {
+        return a.bid_price == b.bid_price && a.ask_price == b.ask_price &&
+               a.bid_quantity == b.bid_quantity && a.ask_quantity == b.ask_quantity;
+    }
+
+    /* Updates in lockstep on both engines. Live ids are tracked in a preallocated vector, swap-removed, so the driver
+     * itself never allocates either. In matching mode ids that filled completely stay in the list, cancelling them is
+     * a no-op on both engines
+     */
+    struct Driver {
+        OrderBook& map_book;
+        ArrayOrderBook& array_book;
+        TradeBuffer* fills[2];
+        std::vector<uint64_t> live;
+        std::mt19937_64 rng{7};
+        uint64_t next_id = 1;
+
+        Driver(OrderBook& a, ArrayOrderBook& b, TradeBuffer* map_fills, TradeBuffer* array_fills)
+                : map_book(a), array_book(b), fills{map_fills, array_fills} {
+            live.reserve(MAX_ORDERS);
+        }
+
+        uint32_t price() {
+            if (rng() % 20 == 0) return FAR_PRICE + static_cast<uint32_t>(rng() % 1000);
+            return 1000 + static_cast<uint32_t>(rng() % 1000);
+        }
+
+        uint64_t pick() {
+            return live[rng() % live.size()];
+        }
+
+        void update(CheckStats& stats) {
+            unsigned op = rng() % 100;
+            bool add = live.empty() || op < (live.size() < TARGET_LIVE ? 55 : 25);
+            if (add && live.size() < MAX_ORDERS) {
+                uint64_t id = next_id++;
+                uint32_t p = price();
+                uint32_t quantity = 1 + rng() % 500;
+                bool is_buy = rng() & 1;
+                map_book.addOrder(id, p, quantity, is_buy);
+                array_book.addOrder(id, p, quantity, is_buy);
+                live.push_back(id);
+            } else if (op < 80) {
+                size_t at = rng() % live.size();
+                map_book.removeOrder(live[at]);
+                array_book.removeOrder(live[at]);
+                live[at] = live.back();
+                live.pop_back();
+            } else if (op < 88) {
+                uint64_t id = pick();
+                uint32_t quantity = 1 + rng() % 500;
+                map_book.modifyOrder(id, quantity);
+                array_book.modifyOrder(id, quantity);
+            } else if (op < 95) {
+                uint64_t id = pick();
+                uint32_t quantity = 1 + rng() % 100;
+                map_book.reduceOrder(id, quantity);
+                array_book.reduceOrder(id, quantity);
+            } else {
+                uint64_t id = pick();
+                uint32_t p = price();
+                uint32_t quantity = 1 + rng() % 500;
+                map_book.replaceOrder(id, p, quantity);
+                array_book.replaceOrder(id, p, quantity);
+            }
+            for (size_t engine = 0; engine < 2; ++engine) {
+                if (fills[engine]) {
+                    stats.fills[engine] += fills[engine]->size();
+                    fills[engine]->clear();
+                }
+            }
+            map_book.take_top_change();
+            array_book.take_top_change();
+            if (!same_top(map_book.top(), array_book.top())) ++stats.mismatches;
+            ++stats.updates;
+        }
+    };
+
+    bool run(const char* mode, bool matching, uint64_t updates) {
+        auto map_book = std::make_unique<OrderBook>(MAX_ORDERS);
+        auto array_book = std::make_unique<ArrayOrderBook>(1500, MAX_ORDERS);
+        auto map_fills = std::make_unique<TradeBuffer>(4096);
+        auto array_fills = std::make_unique<TradeBuffer>(4096);
+        if (matching) {
+            map_book->set_matching(map_fills.get());
+            array_book->set_matching(array_fills.get());
+        }
+        Driver driver(*map_book, *array_book, matching ? map_fills.get() : nullptr, matching ? array_fills.get() : nullptr);
+
+        CheckStats warm_up;
+        for (size_t i = 0; i < WARM_UP_UPDATES; ++i) driver.update(warm_up);
+
+        CheckStats stats;
+        AllocCounter::start();
+        for (uint64_t i = 0; i < updates; ++i) driver.update(stats);
+        AllocCounter::stop();
+        stats.allocations = AllocCounter::count();
+        stats.mismatches += warm_up.mismatches;
+
+        std::printf("%-8s %llu updates, %zu live ids, %llu/%llu fills, %llu heap allocations, %llu top-of-book mismatches\n", mode,
+                    static_cast<unsigned long long>(stats.updates), driver.live.size(),
+                    static_cast<unsigned long long>(stats.fills[0]), static_cast<unsigned long long>(stats.fills[1]),
+                    static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.mismatches));
+        return stats.allocations == 0 && stats.mismatches == 0 && stats.fills[0] == stats.fills[1];
+    }
+
+    /* Price-time matching done the obvious way, what the engines are checked against
+     * Levels are std::deque FIFOs in std::maps, ids in a std::unordered_map. Allocates freely, only runs uncounted
+     */
+    class ReferenceBook {
+    private:
+        struct Resting {
+            uint64_t id;
+            uint32_t quantity;
+        };
+        struct Where {
+            uint32_t price;
+            bool is_buy;
+        };
+        std::map<uint32_t, std::deque<Resting>, std::greater<>> bids;
+        std::map<uint32_t, std::deque<Resting>> asks;
+        std::unordered_map<uint64_t, Where> orders;
+        size_t capacity;
+
+        template<typename Levels>
+        void sweep(Levels& levels, uint64_t id, uint32_t price, uint32_t& quantity, bool is_buy) {
+            while (quantity > 0 && !levels.empty()) {
+                auto best = levels.begin();
+                if (is_buy ? best->first > price : best->first < price) break;
+                Resting& resting = best->second.front();
+                uint32_t fill = std::min(quantity, resting.quantity);
+                fills.push_back({id, resting.id, best->first, fill, is_buy});
+                quantity -= fill;
+                resting.quantity -= fill;
+                if (resting.quantity == 0) {
+                    orders.erase(resting.id);
+                    best->second.pop_front();
+                    if (best->second.empty()) levels.erase(best);
+                }
+            }
+        }
+
+        Resting* find(uint64_t id) {
+            auto it = orders.find(id);
+            if (it == orders.end()) return nullptr;
+            std::deque<Resting>& level = it->second.is_buy ? bids[it->second.price] : asks[it->second.price];
+            for (Resting& resting : level) {
+                if (resting.id == id) return &resting;
+            }
+            return nullptr;
+        }
+
+        template<typename Levels>
+        static void depth_of(const Levels& levels, size_t n, const DepthSpan& out, size_t& count) {
+            for (auto it = levels.begin(); it != levels.end() && count < n; ++it) {
+                uint64_t quantity = 0;
+                for (const Resting& resting : it->second) quantity += resting.quantity;
+                out.prices[count] = it->first;
+                out.quantities[count] = quantity;
+                out.order_counts[count] = static_cast<uint32_t>(it->second.size());
+                ++count;
+            }
+        }
+
+    public:
+        std::vector<Trade> fills;
+
+        explicit ReferenceBook(size_t capacity) : capacity(capacity) {}
+
+        bool add(uint64_t id, uint32_t price, uint32_t quantity, bool is_buy) {
+            if (orders.count(id) || orders.size() >= capacity) return false;
+            if (is_buy) sweep(asks, id, price, quantity, true);
+            else sweep(bids, id, price, quantity, false);
+            if (quantity == 0) return true;
+            if (is_buy) bids[price].push_back({id, quantity});
+            else asks[price].push_back({id, quantity});
+            orders[id] = {price, is_buy};
+            return true;
+        }
+
+        void remove(uint64_t id) {
+            auto it = orders.find(id);
+            if (it == orders.end()) return;
+            auto erase_from = [id](auto& levels, uint32_t price) {
+                auto level = levels.find(price);
+                for (auto at = level->second.begin(); at != level->second.end(); ++at) {
+                    if (at->id == id) {
+                        level->second.erase(at);
+                        break;
+                    }
+                }
+                if (level->second.empty()) levels.erase(level);
+            };
+            if (it->second.is_buy) erase_from(bids, it->second.price);
+            else erase_from(asks, it->second.price);
+            orders.erase(it);
+        }
+
+        void modify(uint64_t id, uint32_t quantity) {
+            if (Resting* resting = find(id)) resting->quantity = quantity;
+        }
+
+        void reduce(uint64_t id, uint32_t quantity) {
+            Resting* resting = find(id);
+            if (!resting) return;
+            if (quantity >= resting->quantity) remove(id);
+            else resting->quantity -= quantity;
+        }
+
+        void replace(uint64_t id, uint32_t price, uint32_t quantity) {
+            auto it = orders.find(id);
+            if (it == orders.end()) return;
+            bool is_buy = it->second.is_buy;
+            remove(id);
+            add(id, price, quantity, is_buy);
+        }
+
+        TopOfBook top() const {
+            TopOfBook top;
+            if (!bids.empty()) {
+                top.bid_price = bids.begin()->first;
+                for (const Resting& resting : bids.begin()->second) top.bid_quantity += resting.quantity;
+            }
+            if (!asks.empty()) {
+                top.ask_price = asks.begin()->first;
+                for (const Resting& resting : asks.begin()->second) top.ask_quantity += resting.quantity;
+            }
+            return top;
+        }
+
+        size_t depth(size_t n, bool is_buy, const DepthSpan& out) const {
+            size_t count = 0;
+            if (is_buy) depth_of(bids, n, out, count);
+            else depth_of(asks, n, out, count);
+            return count;
+        }
+
+        size_t order_count() const { return orders.size(); }
+        std::vector<uint64_t> live_ids() const {
+            std::vector<uint64_t> ids;
+            for (const auto& [id, where] : orders) ids.push_back(id);
+            return ids;
+        }
+    };
+
+    bool same_fills(std::span<const Trade> a, const std::vector<Trade>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].aggressor_id != b[i].aggressor_id || a[i].resting_id != b[i].resting_id || a[i].price != b[i].price ||
+                a[i].quantity != b[i].quantity || a[i].aggressor_is_buy != b[i].aggressor_is_buy) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename Book>
+    std::unique_ptr<Book> make_book(size_t max_orders) {
+        if constexpr (std::is_same_v<Book, ArrayOrderBook>) return std::make_unique<ArrayOrderBook>(1500, max_orders);
+        else return std::make_unique<OrderBook>(max_orders);
+    }
+
+    /* Rejections happen before matching: with the pool full a crossing buy trades nothing, a live id is turned away
+     * even when it would trade, and a slot taken for an order that then fills completely goes back to the pool
+     */
+    template<typename Book>
+    bool check_rejections(const char* name) {
+        constexpr size_t CAPACITY = 4;
+        auto book = make_book<Book>(CAPACITY);
+        auto fills = std::make_unique<TradeBuffer>(64);
+        book->set_matching(fills.get());
+        std::vector<const char*> failures;
+        auto expect = [&failures](bool condition, const char* what) {
+            if (!condition) failures.push_back(what);
+        };
+
+        for (uint64_t id = 1; id <= CAPACITY; ++id) book->addOrder(id, static_cast<uint32_t>(1500 + id), 100, false);
+        expect(book->order_count() == CAPACITY, "asks rest up to capacity");
+        expect(!book->addOrder(5, 1510, 50, true), "crossing buy with the pool full is rejected");
+        expect(fills->empty() && book->top().ask_quantity == 100 && book->order_count() == CAPACITY,
+               "rejected crossing buy trades nothing");
+        expect(!book->addOrder(2, 1510, 100, true), "live id is rejected");
+        expect(fills->empty() && book->order_count() == CAPACITY && book->getBestAsk() == 1501, "rejected live id trades nothing");
+
+        book->removeOrder(CAPACITY);
+        expect(book->addOrder(5, 1510, 50, true) && fills->size() == 1, "crossing buy with a free slot trades");
+        expect(book->order_count() == CAPACITY - 1, "a completely filled order gives its slot back");
+        fills->clear();
+        expect(book->addOrder(6, 1501, 100, true) && fills->size() == 1 && book->getBestBid() == 1501 &&
+               book->top().bid_quantity == 50 && book->order_count() == CAPACITY - 1, "partly filled order rests its remainder");
+        fills->clear();
+        for (int attempt = 0; attempt < 100; ++attempt) book->addOrder(6, 1400, 10, true);
+        expect(book->order_count() == CAPACITY - 1 && book->top().bid_quantity == 50, "repeated live id leaks no slot");
+        expect(book->addOrder(7, 1400, 10, true) && !book->addOrder(8, 1400, 10, true), "exactly one slot left");
+
+        std::printf("reject   %-16s %zu failures\n", name, failures.size());
+        for (const char* failure : failures) std::fprintf(stderr, "  %s: %s\n", name, failure);
+        return failures.empty();
+    }
+
+    /* Random updates around one price, so most adds cross, against ReferenceBook
+     * A small pool keeps it near capacity (capacity rejections), and a share of adds reuse a live id
+     */
+    template<typename Book>
+    bool check_reference(const char* name, uint64_t updates) {
+        constexpr size_t CAPACITY = 512;
+        constexpr size_t DEPTH = 5;
+        auto book = make_book<Book>(CAPACITY);
+        auto fills = std::make_unique<TradeBuffer>(CAPACITY + 1);
+        book->set_matching(fills.get());
+        ReferenceBook reference(CAPACITY);
+        std::mt19937_64 rng(13);
+        std::vector<uint64_t> ids;
+        uint64_t next_id = 1;
+        uint64_t mismatches = 0;
+        uint64_t rejected = 0;
+        uint64_t fill_count = 0;
+
+        uint32_t prices[2][DEPTH];
+        uint64_t quantities[2][DEPTH];
+        uint32_t order_counts[2][DEPTH];
+        DepthSpan engine_depth{prices[0], quantities[0], order_counts[0]};
+        DepthSpan reference_depth{prices[1], quantities[1], order_counts[1]};
+
+        for (uint64_t i = 0; i < updates; ++i) {
+            if (i % 1024 == 0) ids = reference.live_ids();  // Cancels and modifies mostly hit live orders
+            unsigned op = rng() % 100;
+            uint32_t price = 1490 + static_cast<uint32_t>(rng() % 21);
+            uint32_t quantity = 1 + static_cast<uint32_t>(rng() % 300);
+            uint64_t id = ids.empty() ? next_id : ids[rng() % ids.size()];
+            bool accepted[2] = {true, true};
+            if (op < 55) {
+                if (rng() % 20 != 0) id = next_id++;
+                bool is_buy = rng() & 1;
+                accepted[0] = book->addOrder(id, price, quantity, is_buy);
+                accepted[1] = reference.add(id, price, quantity, is_buy);
+                rejected += !accepted[1];
+            } else if (op < 80) {
+                book->removeOrder(id);
+                reference.remove(id);
+            } else if (op < 88) {
+                book->modifyOrder(id, quantity);
+                reference.modify(id, quantity);
+            } else if (op < 95) {
+                book->reduceOrder(id, quantity);
+                reference.reduce(id, quantity);
+            } else {
+                book->replaceOrder(id, price, quantity);
+                reference.replace(id, price, quantity);
+            }
+
+            bool same = accepted[0] == accepted[1] && same_fills(fills->view(), reference.fills) &&
+                        same_top(book->top(), reference.top()) && book->order_count() == reference.order_count();
+            for (bool is_buy : {true, false}) {
+                size_t n = book->getDepth(DEPTH, is_buy, engine_depth);
+                same = same && n == reference.depth(DEPTH, is_buy, reference_depth);
+                for (size_t level = 0; same && level < n; ++level) {
+                    same = prices[0][level] == prices[1][level] && quantities[0][level] == quantities[1][level] &&
+                           order_counts[0][level] == order_counts[1][level];
+                }
+            }
+            if (!same && mismatches++ < 5) std::fprintf(stderr, "  %s: differs from the reference at update %llu (op %u)\n",
+                                                        name, static_cast<unsigned long long>(i), op);
+            fill_count += reference.fills.size();
+            fills->clear();
+            reference.fills.clear();
+        }
+        std::printf("model    %-16s %llu updates, %llu fills, %llu rejected adds, %llu mismatches\n", name,
+                    static_cast<unsigned long long>(updates), static_cast<unsigned long long>(fill_count),
+                    static_cast<unsigned long long>(rejected), static_cast<unsigned long long>(mismatches));
+        return mismatches == 0 && fills->overflow_count() == 0 && rejected > 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t updates = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+    bool ok = run("resting", false, updates);
+    ok = run("matching", true, updates) && ok;
+    ok = check_rejections<OrderBook>("OrderBook") && ok;
+    ok = check_rejections<ArrayOrderBook>("ArrayOrderBook") && ok;
+    uint64_t model_updates = std::min<uint64_t>(updates / 10, 1000000);
+    ok = check_reference<OrderBook>("OrderBook", model_updates) && ok;
+    ok = check_reference<ArrayOrderBook>("ArrayOrderBook", model_updates) && ok;
+    return ok ? 0 : 1;
+}
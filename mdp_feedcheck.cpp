@@ -0,0 +1,181 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "FeedHandler.h"
+#include "SIMDMessageParser.h"
+
+/* mdp-feedcheck: the feed handler's header walk on well-formed and damaged packets
+ * Every frame is copied to the very end of a page with an inaccessible page after it, so a header field read past
+ * the frame crashes instead of quietly reading whatever follows. Damaged frames have to be counted as malformed
+ * (or fragments) and deliver nothing, the good frames around them have to come out in sequence:
+ *
+ *   ./mdp-feedcheck
+ *
+ * Exits 1 on any failure
+ */
+
+namespace {
+    constexpr uint32_t GROUP_A = 0xEF010101;  // 239.1.1.1
+    constexpr uint32_t GROUP_B = 0xEF020101;  // 239.2.1.1
+    constexpr uint16_t FEED_PORT = 30001;
+    constexpr size_t HEADERS_LEN = 14 + 20 + 8;  // Ethernet, IPv4, UDP
+
+    void store_be16(uint8_t* p, uint16_t v) { p[0] = v >> 8; p[1] = v & 0xFF; }
+    void store_be32(uint8_t* p, uint32_t v) { store_be16(p, v >> 16); store_be16(p + 2, v & 0xFFFF); }
+
+    // Ethernet/IPv4/UDP frame to group carrying count messages from first_seq on. No checksums, the handler doesn't look
+    std::vector<uint8_t> feed_frame(uint32_t group, uint32_t first_seq, size_t count) {
+        size_t payload_len = count * SIMDMessageParser::WIRE_SIZE;
+        std::vector<uint8_t> frame(HEADERS_LEN + payload_len);
+        store_be16(frame.data() + 12, 0x0800);
+        uint8_t* ip = frame.data() + 14;
+        ip[0] = 0x45;
+        store_be16(ip + 2, static_cast<uint16_t>(20 + 8 + payload_len));
+        ip[8] = 16;
+        ip[9] = 17;
+        store_be32(ip + 16, group);
+        uint8_t* udp = ip + 20;
+        store_be16(udp, FEED_PORT);
+        store_be16(udp + 2, FEED_PORT);
+        store_be16(udp + 4, static_cast<uint16_t>(8 + payload_len));
+        for (size_t i = 0; i < count; ++i) {
+            MarketDataMessage msg{};
+            msg.sequence_number = first_seq + static_cast<uint32_t>(i);
+            msg.message_type = 'A';
+            std::memcpy(msg.symbol, "AAPL    ", sizeof(msg.symbol));
+            msg.side = 'B';
+            msg.order_id = msg.sequence_number;
+            msg.price = 1500;
+            msg.quantity = 100;
+            SIMDMessageParser::serialize(msg, reinterpret_cast<char*>(frame.data() + HEADERS_LEN + i * SIMDMessageParser::WIRE_SIZE));
+        }
+        return frame;
+    }
+
+    struct Sink {
+        std::vector<uint32_t> delivered;
+        uint32_t gaps = 0;
+
+        void on_message(const MarketDataMessage& msg) { delivered.push_back(msg.sequence_number); }
+        void on_gap(uint16_t, uint32_t, uint32_t) { ++gaps; }
+    };
+
+    // One readable page with a PROT_NONE page behind it, frames are placed to end on the boundary
+    struct GuardedPage {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        uint8_t* base = nullptr;
+
+        GuardedPage() {
+            void* memory = mmap(nullptr, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) return;
+            base = static_cast<uint8_t*>(memory);
+            if (mprotect(base + page, page, PROT_NONE) != 0) {
+                munmap(base, 2 * page);
+                base = nullptr;
+            }
+        }
+        ~GuardedPage() {
+            if (base) munmap(base, 2 * page);
+        }
+
+        const uint8_t* place(const std::vector<uint8_t>& frame) {
+            uint8_t* at = base + page - frame.size();
+            std::memcpy(at, frame.data(), frame.size());
+            return at;
+        }
+    };
+
+    struct Damage {
+        const char* name;
+        std::vector<uint8_t> frame;
+        bool fragment = false;  // Counted as a fragment rather than malformed
+    };
+
+    std::vector<Damage> damaged_frames() {
+        std::vector<Damage> cases;
+        std::vector<uint8_t> good = feed_frame(GROUP_A, 100, 2);
+
+        cases.push_back({"short Ethernet header", std::vector<uint8_t>(good.begin(), good.begin() + 10)});
+        std::vector<uint8_t> vlan(good.begin(), good.begin() + 15);
+        store_be16(vlan.data() + 12, 0x8100);
+        cases.push_back({"cut inside the VLAN tag", vlan});
+        cases.push_back({"cut inside the IPv4 header", std::vector<uint8_t>(good.begin(), good.begin() + 14 + 12)});
+
+        // IP total length leaves room for only half a UDP header, and the frame ends there too
+        std::vector<uint8_t> udp_cut(good.begin(), good.begin() + 14 + 20 + 4);
+        store_be16(udp_cut.data() + 14 + 2, 20 + 4);
+        cases.push_back({"UDP header cut short", udp_cut});
+        std::vector<uint8_t> ip_only(good.begin(), good.begin() + 14 + 20);
+        store_be16(ip_only.data() + 14 + 2, 20);
+        cases.push_back({"no UDP header", ip_only});
+
+        std::vector<uint8_t> short_frame(good.begin(), good.end() - 5);
+        cases.push_back({"frame shorter than the IP total length", short_frame});
+        std::vector<uint8_t> ihl = good;
+        ihl[14] = 0x44;
+        cases.push_back({"IPv4 header length below 20", ihl});
+        std::vector<uint8_t> udp_long = good;
+        store_be16(udp_long.data() + 14 + 20 + 4, static_cast<uint16_t>(8 + 3 * SIMDMessageParser::WIRE_SIZE));
+        cases.push_back({"UDP length past the datagram", udp_long});
+        std::vector<uint8_t> udp_tiny = good;
+        store_be16(udp_tiny.data() + 14 + 20 + 4, 7);
+        cases.push_back({"UDP length below its header", udp_tiny});
+
+        // Whole headers, but the payload isn't whole messages
+        std::vector<uint8_t> partial(good.begin(), good.end() - 1);
+        store_be16(partial.data() + 14 + 2, static_cast<uint16_t>(partial.size() - 14));
+        store_be16(partial.data() + 14 + 20 + 4, static_cast<uint16_t>(partial.size() - 14 - 20));
+        cases.push_back({"partial message in the payload", partial});
+
+        std::vector<uint8_t> fragment = good;
+        store_be16(fragment.data() + 14 + 6, 0x2000);  // More fragments
+        cases.push_back({"IP fragment", fragment, true});
+        return cases;
+    }
+}
+
+int main() {
+    GuardedPage guard;
+    if (!guard.base) {
+        std::perror("mmap");
+        return 1;
+    }
+    FeedHandler feed({{"check", GROUP_A, FEED_PORT, GROUP_B, FEED_PORT}}, ~uint64_t{0});
+    Sink sink;
+    bool ok = true;
+
+    std::vector<uint8_t> first = feed_frame(GROUP_A, 100, 2);
+    feed.process_packet(guard.place(first), first.size(), 0, sink);
+    for (const Damage& damage : damaged_frames()) {
+        uint64_t malformed = feed.malformed_packet_count();
+        uint64_t fragments = feed.fragment_count();
+        size_t delivered = sink.delivered.size();
+        feed.process_packet(guard.place(damage.frame), damage.frame.size(), 0, sink);
+        bool counted = damage.fragment ? feed.fragment_count() == fragments + 1 && feed.malformed_packet_count() == malformed
+                                       : feed.malformed_packet_count() == malformed + 1 && feed.fragment_count() == fragments;
+        if (!counted || sink.delivered.size() != delivered) {
+            std::fprintf(stderr, "%s: not rejected as %s\n", damage.name, damage.fragment ? "a fragment" : "malformed");
+            ok = false;
+        }
+    }
+    // Same messages again on B, then the next ones: B's copy is a duplicate, the feed carries on in sequence
+    std::vector<uint8_t> repeat = feed_frame(GROUP_B, 100, 2);
+    feed.process_packet(guard.place(repeat), repeat.size(), 0, sink);
+    std::vector<uint8_t> next = feed_frame(GROUP_B, 102, 3);
+    feed.process_packet(guard.place(next), next.size(), 0, sink);
+
+    const std::vector<uint32_t> expected = {100, 101, 102, 103, 104};
+    if (sink.delivered != expected || sink.gaps != 0 || feed.channel_stats(0).duplicates.load() != 2) {
+        std::fprintf(stderr, "well-formed frames: %zu delivered, %u gaps, %llu duplicates, expected 100..104 in order\n",
+                     sink.delivered.size(), sink.gaps, static_cast<unsigned long long>(feed.channel_stats(0).duplicates.load()));
+        ok = false;
+    }
+    std::printf("feed headers: %zu damaged frames %s, %llu malformed and %llu fragments counted, %zu messages delivered\n",
+                damaged_frames().size(), ok ? "rejected" : "NOT all rejected",
+                static_cast<unsigned long long>(feed.malformed_packet_count()),
+                static_cast<unsigned long long>(feed.fragment_count()), sink.delivered.size());
+    return ok ? 0 : 1;
+}
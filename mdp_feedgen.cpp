@@ -0,0 +1,144 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+#include "FeedHandler.h"
+#include "SIMDMessageParser.h"
+
+/* mdp-feedgen: writes an A and a B line capture of one feed channel, for replaying through net_pcap vdevs
+ * Both files carry the same sequenced messages. Each line loses and reorders packets independently, so the
+ * arbitration, reorder window and gap detection all get exercised without a real feed:
+ *
+ *   ./mdp-feedgen a.pcap b.pcap 100000 2 5
+ *   sudo ./Low_latency_DPDK --vdev=net_pcap0,rx_pcap=a.pcap --vdev=net_pcap1,rx_pcap=b.pcap -- --feed-ports 0,1
+ *
+ * Usage: mdp-feedgen A.pcap B.pcap [packets] [loss_pct] [reorder_pct]
+ * Addresses match the first FEED_CHANNELS entry in main.cpp
+ */
+
+constexpr const char* GROUP_A = "239.1.1.1";
+constexpr const char* GROUP_B = "239.2.1.1";
+constexpr uint16_t FEED_PORT = 30001;
+constexpr size_t MESSAGES_PER_PACKET = 8;
+constexpr size_t HEADERS_LEN = 14 + 20 + 8;  // Ethernet, IPv4, UDP
+
+static const char* SYMBOLS[] = {"AAPL", "MSFT", "AMZN", "GOOGL", "META", "NVDA", "TSLA", "JPM"};
+
+static void store_be16(uint8_t* p, uint16_t v) { p[0] = v >> 8; p[1] = v & 0xFF; }
+static void store_be32(uint8_t* p, uint32_t v) { store_be16(p, v >> 16); store_be16(p + 2, v & 0xFFFF); }
+
+// Ethernet/IPv4/UDP headers in front of payload_len bytes, to a multicast group
+static void write_headers(uint8_t* packet, uint32_t group, size_t payload_len) {
+    // Multicast MAC: 01:00:5e + low 23 bits of the group
+    const uint8_t dst_mac[6] = {0x01, 0x00, 0x5e, static_cast<uint8_t>((group >> 16) & 0x7F),
+                                static_cast<uint8_t>(group >> 8), static_cast<uint8_t>(group)};
+    const uint8_t src_mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    std::memcpy(packet, dst_mac, 6);
+    std::memcpy(packet + 6, src_mac, 6);
+    store_be16(packet + 12, 0x0800);
+
+    uint8_t* ip = packet + 14;
+    std::memset(ip, 0, 20);
+    ip[0] = 0x45;
+    store_be16(ip + 2, static_cast<uint16_t>(20 + 8 + payload_len));
+    ip[8] = 16;   // TTL
+    ip[9] = 17;   // UDP
+    store_be32(ip + 12, FeedHandler::parse_ipv4("10.0.0.1"));
+    store_be32(ip + 16, group);
+    uint32_t sum = 0;
+    for (int i = 0; i < 20; i += 2) sum += (ip[i] << 8) | ip[i + 1];
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    store_be16(ip + 10, static_cast<uint16_t>(~sum));
+
+    uint8_t* udp = ip + 20;
+    store_be16(udp, FEED_PORT);
+    store_be16(udp + 2, FEED_PORT);
+    store_be16(udp + 4, static_cast<uint16_t>(8 + payload_len));
+    store_be16(udp + 6, 0);  // No checksum, allowed on IPv4
+}
+
+// Classic libpcap format, microsecond timestamps, Ethernet link type
+static bool write_pcap(const char* path, const std::vector<std::pair<uint32_t, std::vector<uint8_t>>>& packets) {
+    FILE* file = std::fopen(path, "wb");
+    if (!file) {
+        std::perror(path);
+        return false;
+    }
+    const uint32_t header[6] = {0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1};
+    std::fwrite(header, sizeof(header), 1, file);
+    for (const auto& [time_us, packet] : packets) {
+        const uint32_t record[4] = {time_us / 1000000, time_us % 1000000,
+                                    static_cast<uint32_t>(packet.size()), static_cast<uint32_t>(packet.size())};
+        std::fwrite(record, sizeof(record), 1, file);
+        std::fwrite(packet.data(), packet.size(), 1, file);
+    }
+    return std::fclose(file) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: %s A.pcap B.pcap [packets] [loss_pct] [reorder_pct]\n", argv[0]);
+        return 1;
+    }
+    const size_t packet_count = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 10000;
+    const double loss = argc > 4 ? std::atof(argv[4]) / 100.0 : 0.01;
+    const double reorder = argc > 5 ? std::atof(argv[5]) / 100.0 : 0.01;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<> chance(0.0, 1.0);
+    std::uniform_int_distribution<uint32_t> price(1490, 1510);
+    std::uniform_int_distribution<uint32_t> quantity(1, 1000);
+    std::uniform_int_distribution<size_t> symbol(0, std::size(SYMBOLS) - 1);
+
+    const uint32_t groups[2] = {FeedHandler::parse_ipv4(GROUP_A), FeedHandler::parse_ipv4(GROUP_B)};
+    std::vector<std::pair<uint32_t, std::vector<uint8_t>>> lines[2];
+    uint32_t sequence = 1;
+    uint64_t order_id = 1;
+    size_t lost_both = 0;
+
+    for (size_t p = 0; p < packet_count; ++p) {
+        std::vector<uint8_t> payload(MESSAGES_PER_PACKET * SIMDMessageParser::WIRE_SIZE);
+        for (size_t m = 0; m < MESSAGES_PER_PACKET; ++m) {
+            MarketDataMessage msg{};
+            msg.timestamp = p * 10000;
+            msg.sequence_number = sequence++;
+            std::memset(msg.symbol, ' ', sizeof(msg.symbol));
+            const char* name = SYMBOLS[symbol(rng)];
+            std::memcpy(msg.symbol, name, std::strlen(name));
+            // Mostly adds, every fourth message deletes a recent order so the books stay small
+            if (m % 4 == 3 && order_id > 8) {
+                msg.message_type = 'D';
+                msg.order_id = order_id - 8;
+            } else {
+                msg.message_type = 'A';
+                msg.order_id = order_id++;
+                msg.price = price(rng);
+                msg.quantity = quantity(rng);
+                msg.side = chance(rng) < 0.5 ? 'B' : 'S';
+            }
+            SIMDMessageParser::serialize(msg, reinterpret_cast<char*>(payload.data() + m * SIMDMessageParser::WIRE_SIZE));
+        }
+
+        bool kept[2];
+        for (int line = 0; line < 2; ++line) {
+            kept[line] = chance(rng) >= loss;
+            if (!kept[line]) continue;
+            std::vector<uint8_t> packet(HEADERS_LEN + payload.size());
+            write_headers(packet.data(), groups[line], payload.size());
+            std::memcpy(packet.data() + HEADERS_LEN, payload.data(), payload.size());
+            lines[line].emplace_back(static_cast<uint32_t>(p * 10), std::move(packet));
+            // Reordering: swap with the previous packet on this line, timestamps stay in order
+            size_t n = lines[line].size();
+            if (n > 1 && chance(rng) < reorder) std::swap(lines[line][n - 1].second, lines[line][n - 2].second);
+        }
+        if (!kept[0] && !kept[1]) lost_both += MESSAGES_PER_PACKET;
+    }
+
+    if (!write_pcap(argv[1], lines[0]) || !write_pcap(argv[2], lines[1])) return 1;
+    std::printf("%u messages in %zu packets. A: %zu packets, B: %zu packets. %zu messages lost on both lines (gaps)\n",
+                sequence - 1, packet_count, lines[0].size(), lines[1].size(), lost_both);
+    return 0;
+}
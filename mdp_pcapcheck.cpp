@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <rte_eal.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include "PcapFile.h"
+#include "PcapReplay.h"
+#include "TscClock.h"
+
+/* mdp-pcapcheck: the capture files behind --record and --replay
+ * file, no EAL:
+ * - PcapWriter then PcapReader gives back every frame's bytes, len, wire_len and ns timestamp
+ * - microsecond magic files and files of the other byte order read the same
+ * - a file cut inside a record header or inside frame data ends on the last whole frame, with truncated() set
+ * replay, EAL without hugepages or PCI devices:
+ * - PcapReplay::load preloads every frame that fits an mbuf, in order, and leaves out the ones that don't
+ * - next_burst keeps the recorded gaps (a frame stamped earlier than the one before goes with it), or with MaxSpeed
+ *   hands out full bursts regardless of time, and every mbuf is back in the pool once the caller frees them
+ *
+ *   ./mdp-pcapcheck file
+ *   ./mdp-pcapcheck replay
+ *
+ * Exits 1 on failure, 77 (skipped under ctest) if the EAL can't be initialised for replay
+ */
+
+namespace {
+    constexpr uint64_t BASE_NS = 1700000000123456789ULL;  // Sub-microsecond digits, so ns precision is checked too
+
+    std::string temp_path(const char* name) {
+        return (std::filesystem::temp_directory_path() / ("mdp_pcapcheck." + std::to_string(getpid()) + "." + name)).string();
+    }
+
+    struct Failures {
+        std::vector<std::string> list;
+        void expect(bool condition, const std::string& what) {
+            if (!condition) list.push_back(what);
+        }
+    };
+
+    // Frame i: its index in the first 4 bytes, then a byte pattern, len bytes in all
+    std::vector<uint8_t> frame_bytes(uint32_t i, uint32_t len) {
+        std::vector<uint8_t> bytes(len);
+        for (uint32_t b = 0; b < len; ++b) bytes[b] = static_cast<uint8_t>(i * 7 + b);
+        if (len >= 4) std::memcpy(bytes.data(), &i, sizeof(i));
+        return bytes;
+    }
+
+    struct TestFrame {
+        std::vector<uint8_t> bytes;
+        uint32_t wire_len;
+        uint64_t ts_ns;
+    };
+
+    bool same_frame(const CapturedFrame& frame, const TestFrame& expected) {
+        return frame.len == expected.bytes.size() && frame.wire_len == expected.wire_len && frame.ts_ns == expected.ts_ns &&
+               std::memcmp(frame.data, expected.bytes.data(), frame.len) == 0;
+    }
+
+    bool write_capture(const std::string& path, const std::vector<TestFrame>& frames) {
+        PcapWriter writer;
+        if (!writer.open(path.c_str())) return false;
+        for (const TestFrame& frame : frames) {
+            if (!writer.write(frame.bytes.data(), static_cast<uint32_t>(frame.bytes.size()), frame.wire_len, frame.ts_ns)) return false;
+        }
+        writer.close();
+        return true;
+    }
+
+    // Reads the whole file, every frame must match in order, then the end with truncated() as given
+    void expect_frames(Failures& failures, const char* what, const std::string& path, const std::vector<TestFrame>& frames,
+                       bool truncated) {
+        PcapReader reader;
+        if (!reader.open(path.c_str())) {
+            failures.expect(false, std::string(what) + ": open failed");
+            return;
+        }
+        CapturedFrame frame;
+        size_t count = 0;
+        while (reader.next(frame)) {
+            failures.expect(count < frames.size() && same_frame(frame, frames[count]),
+                            std::string(what) + ": frame " + std::to_string(count) + " differs");
+            ++count;
+        }
+        failures.expect(count == frames.size(), std::string(what) + ": " + std::to_string(count) + " frames, expected " +
+                                                 std::to_string(frames.size()));
+        failures.expect(reader.truncated() == truncated, std::string(what) + (truncated ? ": cut not reported" : ": reported as cut"));
+        reader.rewind();
+        failures.expect(frames.empty() || (reader.next(frame) && same_frame(frame, frames[0])), std::string(what) + ": rewind");
+    }
+
+    // Little endian like this machine, or big endian like the other kind
+    void put32(std::vector<uint8_t>& out, uint32_t v, bool big_endian) {
+        for (int b = 0; b < 4; ++b) out.push_back(static_cast<uint8_t>(v >> (big_endian ? 24 - 8 * b : 8 * b)));
+    }
+
+    // A pcap laid out by hand, the way another tool on a machine of either byte order would have written it
+    std::vector<uint8_t> foreign_capture(const std::vector<TestFrame>& frames, bool nanos, bool big_endian) {
+        std::vector<uint8_t> file;
+        put32(file, nanos ? PCAP_MAGIC_NS : PCAP_MAGIC_US, big_endian);
+        put32(file, 0x00040002, big_endian);
+        put32(file, 0, big_endian);
+        put32(file, 0, big_endian);
+        put32(file, PCAP_SNAPLEN, big_endian);
+        put32(file, PCAP_LINKTYPE_ETHERNET, big_endian);
+        for (const TestFrame& frame : frames) {
+            put32(file, static_cast<uint32_t>(frame.ts_ns / 1000000000ULL), big_endian);
+            uint32_t sub = static_cast<uint32_t>(frame.ts_ns % 1000000000ULL);
+            put32(file, nanos ? sub : sub / 1000, big_endian);
+            put32(file, static_cast<uint32_t>(frame.bytes.size()), big_endian);
+            put32(file, frame.wire_len, big_endian);
+            file.insert(file.end(), frame.bytes.begin(), frame.bytes.end());
+        }
+        return file;
+    }
+
+    bool write_raw(const std::string& path, const uint8_t* data, size_t len) {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+        bool ok = std::fwrite(data, 1, len, file) == len;
+        return std::fclose(file) == 0 && ok;
+    }
+
+    std::vector<TestFrame> test_frames(size_t count, uint64_t gap_ns) {
+        std::vector<TestFrame> frames;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t len = 60 + (i * 37) % 1400;
+            frames.push_back({frame_bytes(i, len), i % 5 == 0 ? len + 100 : len, BASE_NS + i * gap_ns + i});
+        }
+        return frames;
+    }
+
+    bool check_files() {
+        Failures failures;
+        std::vector<TestFrame> frames = test_frames(100, 1000);
+        std::string path = temp_path("written.pcap");
+        failures.expect(write_capture(path, frames), "PcapWriter failed");
+        expect_frames(failures, "round trip", path, frames, false);
+
+        // Cut inside the last record's header, then inside its frame data: the whole frames before it still come out
+        std::vector<uint8_t> whole(std::filesystem::file_size(path));
+        FILE* file = std::fopen(path.c_str(), "rb");
+        bool read_back = file && std::fread(whole.data(), 1, whole.size(), file) == whole.size();
+        if (file) std::fclose(file);
+        failures.expect(read_back, "reading the written file back failed");
+        std::vector<TestFrame> all_but_last(frames.begin(), frames.end() - 1);
+        size_t last_record = whole.size() - PcapReader::RECORD_HEADER_LEN - frames.back().bytes.size();
+        std::string cut = temp_path("cut.pcap");
+        write_raw(cut, whole.data(), last_record + PcapReader::RECORD_HEADER_LEN / 2);
+        expect_frames(failures, "cut in a record header", cut, all_but_last, true);
+        write_raw(cut, whole.data(), whole.size() - 1);
+        expect_frames(failures, "cut in frame data", cut, all_but_last, true);
+        write_raw(cut, whole.data(), PcapReader::FILE_HEADER_LEN);
+        expect_frames(failures, "header only", cut, {}, false);
+
+        // Microsecond files carry no ns digits, the reader scales them
+        std::vector<TestFrame> micro = frames;
+        for (TestFrame& frame : micro) frame.ts_ns -= frame.ts_ns % 1000;
+        for (bool big_endian : {false, true}) {
+            std::string name = big_endian ? "byte-swapped" : "native";
+            std::vector<uint8_t> us = foreign_capture(micro, false, big_endian);
+            write_raw(cut, us.data(), us.size());
+            expect_frames(failures, (name + " microsecond").c_str(), cut, micro, false);
+            std::vector<uint8_t> ns = foreign_capture(frames, true, big_endian);
+            write_raw(cut, ns.data(), ns.size());
+            expect_frames(failures, (name + " nanosecond").c_str(), cut, frames, false);
+        }
+
+        std::vector<uint8_t> not_pcap = foreign_capture(frames, true, false);
+        not_pcap[0] ^= 0xFF;
+        write_raw(cut, not_pcap.data(), not_pcap.size());
+        PcapReader reader;
+        failures.expect(!reader.open(cut.c_str()), "bad magic accepted");
+
+        std::filesystem::remove(path);
+        std::filesystem::remove(cut);
+        std::printf("pcap file  %zu frames written and read back, cut, microsecond and byte-swapped files, %zu failures\n",
+                    frames.size(), failures.list.size());
+        for (const std::string& failure : failures.list) std::fprintf(stderr, "  %s\n", failure.c_str());
+        return failures.list.empty();
+    }
+
+    constexpr size_t REPLAY_FRAMES = 200;
+    constexpr uint64_t REPLAY_GAP_NS = 100000;  // 100 us, 20 ms of capture
+    constexpr size_t OVERSIZE_FRAME = 50;       // Longer than an mbuf's data room, left out
+    constexpr size_t EARLY_FRAME = 120;         // Stamped before the frame ahead of it
+
+    // Every frame handed out must be the next one loaded, in order. Frees them like the handler would
+    void take(Failures& failures, const char* what, rte_mbuf** bufs, uint16_t n, const std::vector<TestFrame>& loaded,
+              size_t& next) {
+        for (uint16_t i = 0; i < n; ++i, ++next) {
+            bool same = next < loaded.size() && rte_pktmbuf_data_len(bufs[i]) == loaded[next].bytes.size() &&
+                        std::memcmp(rte_pktmbuf_mtod(bufs[i], const uint8_t*), loaded[next].bytes.data(), loaded[next].bytes.size()) == 0;
+            failures.expect(same, std::string(what) + ": frame " + std::to_string(next) + " out of order or changed");
+            rte_pktmbuf_free(bufs[i]);
+        }
+    }
+
+    bool check_replay() {
+        Failures failures;
+        std::vector<TestFrame> frames = test_frames(REPLAY_FRAMES, REPLAY_GAP_NS);
+        frames[OVERSIZE_FRAME].bytes = frame_bytes(OVERSIZE_FRAME, RTE_MBUF_DEFAULT_BUF_SIZE);
+        frames[OVERSIZE_FRAME].wire_len = RTE_MBUF_DEFAULT_BUF_SIZE;
+        frames[EARLY_FRAME].ts_ns = frames[EARLY_FRAME - 1].ts_ns - REPLAY_GAP_NS / 2;
+        std::vector<TestFrame> loaded = frames;
+        loaded.erase(loaded.begin() + OVERSIZE_FRAME);
+        std::string path = temp_path("replay.pcap");
+        failures.expect(write_capture(path, frames), "PcapWriter failed");
+
+        PcapReplay replay;
+        rte_mbuf* bufs[32];
+        if (!replay.load(path.c_str(), PcapReplay::Pacing::Recorded)) {
+            failures.expect(false, "recorded pacing: load failed");
+        } else {
+            uint64_t capture_ns = frames.back().ts_ns - frames.front().ts_ns;
+            failures.expect(replay.frame_count() == loaded.size() && replay.skipped_count() == 1, "oversize frame not left out");
+            failures.expect(replay.capture_duration_ns() == capture_ns, "capture duration");
+
+            /* Stepped by hand: each frame is due once its offset from the first is reached, not a cycle before
+             * Offsets never go back, so the early frame is due together with the one ahead of it
+             */
+            uint64_t start = 1000000;
+            replay.start(start);
+            std::vector<uint64_t> due;
+            for (const TestFrame& frame : loaded) {
+                uint64_t at = start + TscClock::to_cycles(frame.ts_ns - loaded[0].ts_ns);
+                due.push_back(due.empty() ? at : std::max(due.back(), at));
+            }
+            size_t next = 0;
+            while (next < loaded.size() && failures.list.empty()) {
+                size_t expected = 1;
+                while (next + expected < loaded.size() && due[next + expected] == due[next]) ++expected;
+                if (next > 0) {
+                    failures.expect(replay.next_burst(bufs, 32, due[next] - 1) == 0, "frame " + std::to_string(next) + " early");
+                }
+                uint16_t n = replay.next_burst(bufs, 32, due[next]);
+                failures.expect(n == expected, "frame " + std::to_string(next) + ": " + std::to_string(n) + " due, expected " +
+                                               std::to_string(expected));
+                take(failures, "recorded pacing", bufs, n, loaded, next);
+            }
+            failures.expect(replay.exhausted() && next == loaded.size(), "recorded pacing: frames left over");
+        }
+
+        // Against the clock, the way lcore_replay runs it: the whole capture takes at least its recorded length
+        if (replay.load(path.c_str(), PcapReplay::Pacing::Recorded)) {
+            failures.expect(replay.frame_count() == loaded.size() && replay.skipped_count() == 1, "reload: counts carried over");
+            uint64_t start = TscClock::now();
+            replay.start(start);
+            size_t next = 0;
+            while (!replay.exhausted()) {
+                uint16_t n = replay.next_burst(bufs, 32, TscClock::now());
+                take(failures, "timed replay", bufs, n, loaded, next);
+            }
+            uint64_t elapsed_ns = TscClock::to_ns(TscClock::now_precise() - start);
+            replay.finish(TscClock::now());
+            failures.expect(replay.done() && elapsed_ns + 1000 >= replay.capture_duration_ns(), "timed replay ran ahead of the capture");
+            std::printf("           timed replay: %zu frames in %.2f ms, capture %.2f ms\n", next, elapsed_ns / 1e6,
+                        replay.capture_duration_ns() / 1e6);
+        }
+
+        // Full bursts regardless of time, and a pool that is full again once every mbuf is freed
+        if (!replay.load(path.c_str(), PcapReplay::Pacing::MaxSpeed)) {
+            failures.expect(false, "max speed: load failed");
+        } else {
+            replay.start(TscClock::now());
+            size_t next = 0;
+            uint16_t n;
+            while ((n = replay.next_burst(bufs, 32, 0)) > 0) {
+                failures.expect(n == 32 || replay.exhausted(), "max speed: short burst before the end");
+                rte_mempool* pool = bufs[0]->pool;
+                take(failures, "max speed", bufs, n, loaded, next);
+                // The pool is sized to every record in the file, the one left out included
+                if (replay.exhausted()) failures.expect(rte_mempool_avail_count(pool) == frames.size(), "max speed: mbufs not returned");
+            }
+            failures.expect(next == loaded.size(), "max speed: frames left over");
+        }
+        size_t frame_count = replay.frame_count();
+        size_t skipped = replay.skipped_count();
+        replay.release();
+
+        std::filesystem::remove(path);
+        std::printf("pcap replay %zu frames loaded (%zu left out), recorded gaps, timed and max speed, %zu failures\n",
+                    frame_count, skipped, failures.list.size());
+        for (const std::string& failure : failures.list) std::fprintf(stderr, "  %s\n", failure.c_str());
+        return failures.list.empty();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || (std::strcmp(argv[1], "file") != 0 && std::strcmp(argv[1], "replay") != 0)) {
+        std::fprintf(stderr, "Usage: %s file|replay\n", argv[0]);
+        return 1;
+    }
+    if (std::strcmp(argv[1], "file") == 0) return check_files() ? 0 : 1;
+
+    char* eal_args[] = {argv[0], const_cast<char*>("--no-huge"), const_cast<char*>("-m"), const_cast<char*>("256"),
+                        const_cast<char*>("--no-pci"), const_cast<char*>("--no-shconf"), const_cast<char*>("--log-level=error")};
+    if (rte_eal_init(static_cast<int>(std::size(eal_args)), eal_args) < 0) {
+        std::printf("EAL init failed, skipped\n");
+        return 77;
+    }
+    TscClock::calibrate();
+    bool ok = check_replay();
+    rte_eal_cleanup();
+    return ok ? 0 : 1;
+}
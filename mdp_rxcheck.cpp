@@ -0,0 +1,207 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include <rte_eal.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include "AllocCounter.h"
+#include "DPDKSetup.h"
+#include "MarketDataHandler.h"
+
+/* mdp-rxcheck: the zero-copy receive path from mbuf to book, MarketDataHandler::receive_burst through processMessages
+ * One TCP order flow is cut into segments at random points, so some carry whole orders (used in place, as views) and
+ * some carry orders split across segments (reassembled and copied). The segments go through receive_burst in NIC
+ * sized bursts and the worker side applies them. After a warm-up:
+ * - every order is applied once
+ * - nothing is allocated on the heap, on the RX side or the worker side
+ * - every mbuf reference a view took is dropped again, the pool is full at the end
+ * And with views and copies interleaved on the flow, the orders are applied in the order they were sent
+ *
+ *   ./mdp-rxcheck            # 200k orders (the order check always sends ORDER_CHECK_ORDERS)
+ *   ./mdp-rxcheck 2000000
+ *
+ * The EAL runs without hugepages or PCI devices, only the mbuf pool is needed. Exits 1 on failure, 77 (skipped under
+ * ctest) if the EAL can't be initialised here
+ */
+
+namespace {
+    constexpr size_t POOL_SIZE = 8191;
+    constexpr size_t WARM_UP_ORDERS = 20000;
+    constexpr size_t ORDER_CHECK_ORDERS = 10000;
+    constexpr size_t FRAME_LEN = FRAME_HEADER_LEN + OrderProtocol::WIRE_SIZE;  // One framed order on the stream
+    constexpr uint32_t SOURCE_IP = 0x0A000002;   // 10.0.0.2
+    constexpr uint32_t LOCAL_IP = 0x0A000001;    // 10.0.0.1
+    constexpr uint16_t SOURCE_PORT = 40000;
+    constexpr uint16_t LOCAL_PORT = 12345;
+    constexpr uint32_t INITIAL_SEQ = 1000;
+    const char SYMBOL[8] = {'T', 'E', 'S', 'T', ' ', ' ', ' ', ' '};
+
+    void put_be16(uint8_t* p, uint16_t v) {
+        p[0] = static_cast<uint8_t>(v >> 8);
+        p[1] = static_cast<uint8_t>(v);
+    }
+
+    void put_be32(uint8_t* p, uint32_t v) {
+        put_be16(p, static_cast<uint16_t>(v >> 16));
+        put_be16(p + 2, static_cast<uint16_t>(v));
+    }
+
+    /* The sender's side of one flow: framed orders back to back, cut into Ethernet/IPv4/TCP segments
+     * Half the cuts land on a frame boundary (plus up to two whole frames), the rest anywhere, so the receiver sees
+     * segments it can use in place and orders split across two or three segments, interleaved
+     */
+    struct Flow {
+        std::vector<uint8_t> stream;
+        size_t sent = 0;
+        std::mt19937_64 rng{11};
+
+        explicit Flow(size_t orders) { stream.reserve(orders * FRAME_LEN); }
+
+        void add(const Order& order) {
+            size_t at = stream.size();
+            stream.resize(at + FRAME_LEN);
+            stream[at] = static_cast<uint8_t>(OrderProtocol::WIRE_SIZE);
+            stream[at + 1] = static_cast<uint8_t>(OrderProtocol::WIRE_SIZE >> 8);
+            OrderProtocol::serialize_order(order, std::span<uint8_t>(stream.data() + at + FRAME_HEADER_LEN, OrderProtocol::WIRE_SIZE));
+        }
+
+        size_t next_cut() {
+            size_t end;
+            if (rng() & 1) end = (sent / FRAME_LEN + 1 + rng() % 3) * FRAME_LEN;
+            else end = sent + 1 + rng() % (3 * FRAME_LEN);
+            return std::min(end, stream.size()) - sent;
+        }
+
+        // Next segment into a fresh mbuf, nullptr if the pool is dry
+        rte_mbuf* segment(rte_mempool* pool) {
+            size_t len = next_cut();
+            size_t frame_len = TCPIPStack::HEADERS_LEN + len;
+            rte_mbuf* mbuf = rte_pktmbuf_alloc(pool);
+            if (!mbuf) return nullptr;
+            uint8_t* frame = reinterpret_cast<uint8_t*>(rte_pktmbuf_append(mbuf, static_cast<uint16_t>(frame_len)));
+            std::memset(frame, 0, TCPIPStack::HEADERS_LEN);
+            put_be16(frame + 12, 0x0800);
+            uint8_t* ip = frame + TCPIPStack::ETHER_HEADER_LEN;
+            ip[0] = 0x45;
+            put_be16(ip + 2, static_cast<uint16_t>(frame_len - TCPIPStack::ETHER_HEADER_LEN));
+            ip[8] = 64;
+            ip[9] = 6;
+            put_be32(ip + 12, SOURCE_IP);
+            put_be32(ip + 16, LOCAL_IP);
+            uint8_t* tcp = ip + TCPIPStack::IPV4_HEADER_LEN;
+            put_be16(tcp, SOURCE_PORT);
+            put_be16(tcp + 2, LOCAL_PORT);
+            put_be32(tcp + 4, INITIAL_SEQ + static_cast<uint32_t>(sent));
+            tcp[12] = (TCPIPStack::TCP_HEADER_LEN / 4) << 4;
+            tcp[13] = TCP_FLAG_PSH | TCP_FLAG_ACK;
+            std::memcpy(frame + TCPIPStack::HEADERS_LEN, stream.data() + sent, len);
+            sent += len;
+            return mbuf;
+        }
+    };
+
+    /* Bursts of segments through receive_burst until the flow has sent up to stream byte end, each burst applied on
+     * the worker side before the next. False if the pool ran dry
+     */
+    bool deliver(MarketDataHandler& handler, Flow& flow, rte_mempool* pool, size_t end) {
+        rte_mbuf* bufs[BURST_SIZE];
+        while (flow.sent < end) {
+            uint16_t n = 0;
+            while (n < BURST_SIZE && flow.sent < end) {
+                if (!(bufs[n] = flow.segment(pool))) return false;
+                ++n;
+            }
+            handler.receive_burst(0, bufs, n, TscClock::now());
+            while (handler.processMessages(0) > 0) {}
+        }
+        return true;
+    }
+
+    Order make_order(uint64_t id, uint32_t price, bool is_buy) {
+        Order order{};
+        order.order_id = id;
+        order.price = price;
+        order.quantity = 100;
+        order.is_buy = is_buy;
+        std::memcpy(order.symbol, SYMBOL, sizeof(order.symbol));
+        return order;
+    }
+
+    /* Buys and sells at one price in matching mode, so every sell fills the buy before it and the book stays small
+     * however long the run. Allocations are counted once the warm-up orders are sent, all orders have to be applied
+     */
+    bool check_allocations(rte_mempool* pool, size_t orders) {
+        MarketDataHandler handler({{"TEST", 1000}}, 1);
+        handler.enable_matching();
+
+        Flow flow(WARM_UP_ORDERS + orders);
+        for (size_t i = 0; i < WARM_UP_ORDERS + orders; ++i) flow.add(make_order(i + 1, 1000, i % 2 == 0));
+        bool ok = deliver(handler, flow, pool, WARM_UP_ORDERS * FRAME_LEN);
+
+        AllocCounter::start();
+        ok = deliver(handler, flow, pool, flow.stream.size()) && ok;
+        AllocCounter::stop();
+        uint64_t applied = handler.processed_messages() - WARM_UP_ORDERS;
+        uint64_t heap = AllocCounter::count();
+        unsigned in_pool = rte_mempool_avail_count(pool);
+
+        uint64_t in_place = handler.zero_copy_message_count();
+        uint64_t copied = handler.copied_message_count();
+
+        std::printf("zero-copy  %zu orders after warm-up, %llu applied (%llu in place, %llu copied), %llu heap allocations, "
+                    "%u/%zu mbufs back in the pool\n", orders, static_cast<unsigned long long>(applied),
+                    static_cast<unsigned long long>(in_place), static_cast<unsigned long long>(copied),
+                    static_cast<unsigned long long>(heap), in_pool, POOL_SIZE);
+        return ok && applied == orders && in_place > 0 && copied > 0 && heap == 0 && in_pool == POOL_SIZE;
+    }
+
+    /* Buys at a price one tick above the one before, resting. Applied in stream order every one is a new best bid and
+     * publishes a top of book. One that overtakes the order before it lands below the best and publishes nothing, so
+     * the update count comes up short of the order count
+     */
+    bool check_order(rte_mempool* pool) {
+        MarketDataHandler handler({{"TEST", 1000}}, 1);
+        Flow flow(ORDER_CHECK_ORDERS);
+        for (size_t i = 0; i < ORDER_CHECK_ORDERS; ++i) flow.add(make_order(i + 1, static_cast<uint32_t>(1000 + i), true));
+        bool ok = deliver(handler, flow, pool, flow.stream.size());
+
+        uint64_t applied = handler.processed_messages();
+        BboQuote quote = handler.book_manager().top_of_book(0);
+        uint64_t in_place = handler.zero_copy_message_count();
+        uint64_t copied = handler.copied_message_count();
+        std::printf("order      %zu orders, %llu applied (%llu in place, %llu copied), %llu new best bids, best bid %u\n",
+                    ORDER_CHECK_ORDERS, static_cast<unsigned long long>(applied), static_cast<unsigned long long>(in_place),
+                    static_cast<unsigned long long>(copied), static_cast<unsigned long long>(quote.sequence), quote.bid_price);
+        return ok && applied == ORDER_CHECK_ORDERS && in_place > 0 && copied > 0 && quote.sequence == ORDER_CHECK_ORDERS &&
+               quote.bid_price == 1000 + ORDER_CHECK_ORDERS - 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t orders = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+    char* eal_args[] = {argv[0], const_cast<char*>("--no-huge"), const_cast<char*>("-m"), const_cast<char*>("256"),
+                        const_cast<char*>("--no-pci"), const_cast<char*>("--no-shconf"), const_cast<char*>("--log-level=error")};
+    if (rte_eal_init(static_cast<int>(std::size(eal_args)), eal_args) < 0) {
+        std::printf("EAL init failed, skipped\n");
+        return 77;
+    }
+    TscClock::calibrate();
+    rte_mempool* pool = rte_pktmbuf_pool_create("rxcheck", POOL_SIZE, 0, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+    if (!pool) {
+        std::printf("mbuf pool creation failed, skipped\n");
+        rte_eal_cleanup();
+        return 77;
+    }
+
+    bool ok = check_allocations(pool, orders);
+    ok = check_order(pool) && ok;
+
+    rte_mempool_free(pool);
+    rte_eal_cleanup();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include "AllocCounter.h"
+#include "DPDKSetup.h"
+#include "OrderSender.h"
+#include "TscClock.h"
+
+/* mdp-sendcheck: the order entry transmit path, OrderSender::send and flush through rte_eth_tx_burst
+ * Orders go out on a net_null port, which takes every frame and frees it. After a warm-up:
+ * - every order is sent, none dropped or failed
+ * - nothing is allocated on the heap
+ * - every mbuf is back in the TX pool
+ * Also prints ns per order for send (serialize in place, seal the frame, stage, a tx_burst per TX_BATCH) and the
+ * sender's own tick-to-trade percentiles, signal to tx_burst return
+ *
+ *   ./mdp-sendcheck            # 200k orders
+ *   ./mdp-sendcheck 2000000
+ *
+ * Exits 1 on failure, 77 (skipped under ctest) if the EAL or the null port can't be brought up here
+ */
+
+namespace {
+    constexpr size_t WARM_UP_ORDERS = 10000;
+    constexpr uint32_t LOCAL_IP = 0x0A000001;    // 10.0.0.1
+    constexpr uint32_t EXCHANGE_IP = 0x0A000002; // 10.0.0.2
+    constexpr uint16_t EXCHANGE_PORT = 9000;
+
+    Order make_order(uint64_t id) {
+        Order order{};
+        order.order_id = id;
+        order.price = 1000 + static_cast<uint32_t>(id % 16);
+        order.quantity = 100;
+        order.is_buy = (id & 1) != 0;
+        std::memcpy(order.symbol, "TEST    ", sizeof(order.symbol));
+        return order;
+    }
+
+    bool check_send(uint16_t port, rte_mempool* tx_pool, size_t orders) {
+        LinkConfig link{{0x02, 0, 0, 0, 0, 0x01}, {0x02, 0, 0, 0, 0, 0x02}, LOCAL_IP, 40000};
+        auto sender = std::make_unique<OrderSender>(tx_pool, port, 0, link, EXCHANGE_IP, EXCHANGE_PORT);
+        for (size_t i = 0; i < WARM_UP_ORDERS; ++i) sender->send(make_order(i + 1), TscClock::now());
+        sender->flush();
+
+        AllocCounter::start();
+        uint64_t start = TscClock::now();
+        for (size_t i = 0; i < orders; ++i) {
+            Order order = make_order(WARM_UP_ORDERS + i + 1);
+            sender->send(order, TscClock::now());
+        }
+        sender->flush();
+        uint64_t cycles = TscClock::now_precise() - start;
+        AllocCounter::stop();
+        uint64_t heap = AllocCounter::count();
+
+        uint64_t sent = sender->sent_count() - WARM_UP_ORDERS;
+        uint64_t dropped = sender->dropped_count();
+        uint64_t failed = sender->failed_count();
+        const LatencyHistogram& tick_to_trade = sender->tick_to_trade_latency();
+        std::printf("send  %zu orders after warm-up, %llu sent, %llu dropped, %llu failed, %llu heap allocations, %s checksums\n",
+                    orders, static_cast<unsigned long long>(sent), static_cast<unsigned long long>(dropped),
+                    static_cast<unsigned long long>(failed), static_cast<unsigned long long>(heap),
+                    sender->checksum_mode() == ChecksumMode::Offload ? "offloaded" : "software");
+        std::printf("      %.1f ns/order, tick-to-trade p50 %llu p99 %llu ns\n",
+                    orders > 0 ? static_cast<double>(TscClock::to_ns(cycles)) / static_cast<double>(orders) : 0.0,
+                    static_cast<unsigned long long>(TscClock::to_ns(tick_to_trade.percentile(50.0))),
+                    static_cast<unsigned long long>(TscClock::to_ns(tick_to_trade.percentile(99.0))));
+        sender.reset();
+
+        unsigned in_pool = rte_mempool_avail_count(tx_pool);
+        std::printf("      %u/%u mbufs back in the TX pool\n", in_pool, static_cast<unsigned>(NUM_TX_MBUFS));
+        return sent == orders && dropped == 0 && failed == 0 && heap == 0 && in_pool == NUM_TX_MBUFS;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t orders = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+    char* eal_args[] = {argv[0], const_cast<char*>("--no-huge"), const_cast<char*>("-m"), const_cast<char*>("256"),
+                        const_cast<char*>("--no-pci"), const_cast<char*>("--no-shconf"), const_cast<char*>("--vdev=net_null0"),
+                        const_cast<char*>("--log-level=error")};
+    if (rte_eal_init(static_cast<int>(std::size(eal_args)), eal_args) < 0) {
+        std::printf("EAL init failed, skipped\n");
+        return 77;
+    }
+    TscClock::calibrate();
+    rte_mempool* rx_pool = rte_pktmbuf_pool_create("sendcheck_rx", NUM_MBUFS, MBUF_CACHE_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
+                                                   rte_socket_id());
+    rte_mempool* tx_pool = rte_pktmbuf_pool_create("sendcheck_tx", NUM_TX_MBUFS, 0, 0, TX_MBUF_DATA_SIZE, rte_socket_id());
+    if (!rx_pool || !tx_pool || port_init(0, rx_pool, 1) != 0) {
+        std::printf("mbuf pools or the null port unavailable, skipped\n");
+        rte_eal_cleanup();
+        return 77;
+    }
+
+    bool ok = check_send(0, tx_pool, orders);
+
+    rte_mempool_free(tx_pool);
+    dpdk_cleanup();  // Closes the port, which still holds rx_pool
+    return ok ? 0 : 1;
+}
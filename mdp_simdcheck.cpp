@@ -0,0 +1,168 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "SIMDMessageParser.h"
+
+/* mdp-simdcheck: fuzzes the batch decode kernels against the scalar decoder
+ * Random wire bytes at random buffer offsets go through every kernel this CPU can run (SSSE3, AVX2, AVX-512 VBMI),
+ * each decoded block has to match the schema's field-by-field decode. Also checks parse_batch with every tail length
+ * and that serialize writes back the exact bytes parse read. A second, big endian schema with an odd wire size
+ * covers the byte swapping shuffles:
+ *
+ *   ./mdp-simdcheck            # 20000 rounds
+ *   ./mdp-simdcheck 1000000
+ *
+ * Kernel throughput is in mdp-bench (./mdp-bench parse)
+ * Exits 1 on any mismatch
+ */
+
+namespace {
+    constexpr size_t MAX_REPORTED = 10;
+
+    size_t reported = 0;
+
+    void report(const char* what, const char* kernel, size_t round, size_t message) {
+        if (reported++ < MAX_REPORTED) std::fprintf(stderr, "%s: %s mismatch, round %zu message %zu\n", what, kernel, round, message);
+    }
+
+    bool same(const MarketDataMessage& a, const MarketDataMessage& b) {
+        return a.timestamp == b.timestamp && a.sequence_number == b.sequence_number && a.message_type == b.message_type &&
+               std::memcmp(a.symbol, b.symbol, sizeof(a.symbol)) == 0 && a.side == b.side && a.order_id == b.order_id &&
+               a.price == b.price && a.quantity == b.quantity && a.rx_tsc == b.rx_tsc;
+    }
+
+    // Mixed widths, big endian fields and a 17-byte wire size, so no field sits where the little endian schema's would
+    struct SwappedMessage {
+        uint32_t a;
+        uint16_t b;
+        uint64_t c;
+        char s[3];
+    };
+    using SwappedSchema = WireSchema<SwappedMessage, 17,
+            WIRE_FIELD(SwappedMessage, a, 0,  Endian::Big),
+            WIRE_FIELD(SwappedMessage, b, 4,  Endian::Big),
+            WIRE_FIELD(SwappedMessage, c, 6,  Endian::Little),
+            WIRE_FIELD(SwappedMessage, s, 14, Endian::Little)>;
+
+    bool same(const SwappedMessage& x, const SwappedMessage& y) {
+        return x.a == y.a && x.b == y.b && x.c == y.c && std::memcmp(x.s, y.s, sizeof(x.s)) == 0;
+    }
+
+    template<typename Schema>
+    struct Kernels {
+        using Simd = WireSchemaSimd<Schema>;
+        struct Kernel {
+            const char* name;
+            typename Simd::DecodeBlockFn fn;
+        };
+        static constexpr Kernel ALL[] = {
+            {"scalar", Simd::decode_block_scalar},
+            {"SSSE3", Simd::decode_block_ssse3},
+            {"AVX2", Simd::decode_block_avx2},
+            {"AVX-512 VBMI", Simd::decode_block_avx512},
+        };
+    };
+
+    /* One schema's worth of fuzzing. Each round fills a buffer with random bytes and decodes a few blocks starting at a
+     * random offset, so kernels see every input alignment
+     */
+    template<typename Schema>
+    bool check_kernels(const char* what, size_t rounds, std::mt19937_64& rng) {
+        using Simd = WireSchemaSimd<Schema>;
+        using Struct = typename Schema::struct_type;
+        constexpr size_t BLOCKS = 4;
+        constexpr size_t MESSAGES = BLOCKS * Simd::BLOCK;
+
+        std::vector<char> buf(MESSAGES * Schema::wire_size + 64);
+        std::vector<Struct> expected(MESSAGES);
+        std::vector<Struct> out(MESSAGES);
+        bool ok = true;
+
+        for (const auto& kernel : Kernels<Schema>::ALL) {
+            if (!Simd::supported(kernel.fn)) {
+                std::printf("%-8s %-12s skipped, not supported here\n", what, kernel.name);
+                continue;
+            }
+            size_t mismatches = 0;
+            for (size_t round = 0; round < rounds; ++round) {
+                for (auto& b : buf) b = static_cast<char>(rng());
+                const char* in = buf.data() + rng() % 64;
+                for (size_t m = 0; m < MESSAGES; ++m) expected[m] = Schema::decode(in + m * Schema::wire_size);
+                for (size_t blk = 0; blk < BLOCKS; ++blk) {
+                    kernel.fn(in + blk * Simd::BLOCK * Schema::wire_size, out.data() + blk * Simd::BLOCK);
+                }
+                for (size_t m = 0; m < MESSAGES; ++m) {
+                    if (!same(out[m], expected[m])) {
+                        ++mismatches;
+                        report(what, kernel.name, round, m);
+                    }
+                }
+            }
+            std::printf("%-8s %-12s %zu messages, %zu mismatches\n", what, kernel.name, rounds * MESSAGES, mismatches);
+            ok = ok && mismatches == 0;
+        }
+        return ok;
+    }
+
+    // parse_batch with every count up to a few blocks, so whole blocks plus every tail length go through the dispatch
+    bool check_batch(std::mt19937_64& rng) {
+        constexpr size_t MAX_COUNT = 3 * WireSchemaSimd<MarketDataWireSchema>::BLOCK + 7;
+        std::vector<char> buf(MAX_COUNT * SIMDMessageParser::WIRE_SIZE);
+        std::vector<MarketDataMessage> out(MAX_COUNT + 1);
+        size_t mismatches = 0;
+
+        for (size_t n = 0; n <= MAX_COUNT; ++n) {
+            for (auto& b : buf) b = static_cast<char>(rng());
+            std::memset(static_cast<void*>(out.data()), 0xab, out.size() * sizeof(MarketDataMessage));
+            MarketDataMessage guard = out[n];
+            SIMDMessageParser::parse_batch(buf.data(), n, out.data());
+            for (size_t m = 0; m < n; ++m) {
+                if (!same(out[m], SIMDMessageParser::parse(buf.data() + m * SIMDMessageParser::WIRE_SIZE))) {
+                    ++mismatches;
+                    report("batch", SIMDMessageParser::active_kernel(), n, m);
+                }
+            }
+            // Nothing written past the n-th message
+            if (std::memcmp(&out[n], &guard, sizeof(guard)) != 0) {
+                ++mismatches;
+                report("batch overrun", SIMDMessageParser::active_kernel(), n, n);
+            }
+        }
+        std::printf("batch    %-12s counts 0..%zu, %zu mismatches\n", SIMDMessageParser::active_kernel(), MAX_COUNT, mismatches);
+        return mismatches == 0;
+    }
+
+    // Every wire byte belongs to exactly one field, so serialize(parse(bytes)) has to give the bytes back
+    bool check_round_trip(size_t rounds, std::mt19937_64& rng) {
+        char wire[SIMDMessageParser::WIRE_SIZE];
+        char back[SIMDMessageParser::WIRE_SIZE];
+        size_t mismatches = 0;
+
+        for (size_t round = 0; round < rounds; ++round) {
+            for (auto& b : wire) b = static_cast<char>(rng());
+            std::memset(back, 0, sizeof(back));
+            SIMDMessageParser::serialize(SIMDMessageParser::parse(wire), back);
+            if (std::memcmp(wire, back, sizeof(wire)) != 0) {
+                ++mismatches;
+                report("round trip", "scalar", round, 0);
+            }
+        }
+        std::printf("encode   %-12s %zu messages, %zu mismatches\n", "scalar", rounds, mismatches);
+        return mismatches == 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    std::mt19937_64 rng(11);
+
+    std::printf("parse_batch uses %s\n", SIMDMessageParser::active_kernel());
+    bool ok = check_kernels<MarketDataWireSchema>("market", rounds, rng);
+    ok = check_kernels<SwappedSchema>("swapped", rounds, rng) && ok;
+    ok = check_batch(rng) && ok;
+    ok = check_round_trip(rounds, rng) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include "LatencyHistogram.h"
+#include "StatsBlock.h"
+
+/* mdp-stat: live view of a running handler, like top
+ * Attaches to the handler's shared memory stats block read-only and redraws every interval
+ * Rates and latency percentiles are over the last interval, totals since the handler started
+ *
+ * Usage: mdp-stat [interval_ms] [--once]
+ */
+
+static double cycles_to_ns(uint64_t cycles, uint64_t tsc_hz) {
+    return tsc_hz ? static_cast<double>(cycles) * 1e9 / static_cast<double>(tsc_hz) : 0.0;
+}
+
+static double per_second(uint64_t now, uint64_t before, double seconds) {
+    return seconds > 0 && now >= before ? static_cast<double>(now - before) / seconds : 0.0;
+}
+
+static void print_stats(const StatsData& cur, const StatsData* prev) {
+    double seconds = prev && cur.tsc_hz ? static_cast<double>(cur.publish_tsc - prev->publish_tsc) / static_cast<double>(cur.tsc_hz) : 0.0;
+    bool have_rates = prev && seconds > 0;
+
+    std::printf("Processed %llu", static_cast<unsigned long long>(cur.processed_messages));
+    if (have_rates) std::printf("  (%.0f msg/s)", per_second(cur.processed_messages, prev->processed_messages, seconds));
+    std::printf("\nZero-copy %llu  copied %llu  unknown symbol %llu\n\n",
+                static_cast<unsigned long long>(cur.zero_copy_messages),
+                static_cast<unsigned long long>(cur.copied_messages),
+                static_cast<unsigned long long>(cur.unknown_symbol_messages));
+
+    for (uint32_t q = 0; q < cur.rx_queue_count && q < STATS_MAX_RX_QUEUES; ++q) {
+        std::printf("RX queue %-3u %14llu pkts %12.0f pkt/s\n", q, static_cast<unsigned long long>(cur.rx_queue_packets[q]),
+                    have_rates ? per_second(cur.rx_queue_packets[q], prev->rx_queue_packets[q], seconds) : 0.0);
+    }
+    if (cur.rx_queue_count > 0) std::printf("\n");
+
+    std::printf("%-12s %14s %12s\n", "TYPE", "TOTAL", "RATE/s");
+    for (uint32_t k = 0; k < cur.message_kind_count && k < STATS_MAX_MESSAGE_KINDS; ++k) {
+        std::printf("%-12s %14llu %12.0f\n", cur.message_kind_names[k],
+                    static_cast<unsigned long long>(cur.message_kind_counts[k]),
+                    have_rates ? per_second(cur.message_kind_counts[k], prev->message_kind_counts[k], seconds) : 0.0);
+    }
+
+    std::printf("\n%-16s %8s %8s %10s %12s %12s %12s\n", "QUEUE", "DEPTH", "CAP", "HIGHWATER", "DROPPED", "SPILLED", "SPINS");
+    for (uint32_t q = 0; q < cur.queue_count && q < STATS_MAX_QUEUES; ++q) {
+        const StatsQueue& queue = cur.queues[q];
+        std::printf("%-16s %8llu %8llu %10llu %12llu %12llu %12llu\n", queue.name,
+                    static_cast<unsigned long long>(queue.depth), static_cast<unsigned long long>(queue.capacity),
+                    static_cast<unsigned long long>(queue.high_water), static_cast<unsigned long long>(queue.dropped),
+                    static_cast<unsigned long long>(queue.spilled), static_cast<unsigned long long>(queue.spin_retries));
+    }
+
+    // Percentiles over the interval, from the bucket deltas. Cumulative on the first screen
+    std::printf("\n%-16s %10s %10s %10s %10s %10s %10s  (ns)\n", "LATENCY", "SAMPLES", "P50", "P90", "P99", "P99.9", "P99.99");
+    auto interval = std::make_unique<uint64_t[]>(LatencyHistogram::BUCKET_COUNT);
+    for (uint32_t s = 0; s < cur.latency_series_count && s < STATS_MAX_LATENCY_SERIES; ++s) {
+        uint64_t samples = 0;
+        for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; ++b) {
+            uint64_t before = prev ? prev->latency_buckets[s][b] : 0;
+            interval[b] = cur.latency_buckets[s][b] >= before ? cur.latency_buckets[s][b] - before : 0;
+            samples += interval[b];
+        }
+        std::printf("%-16s %10llu", cur.latency_names[s], static_cast<unsigned long long>(samples));
+        for (double pct : {50.0, 90.0, 99.0, 99.9, 99.99}) {
+            std::printf(" %10.0f", cycles_to_ns(LatencyHistogram::percentile_of(interval.get(), pct), cur.tsc_hz));
+        }
+        std::printf("\n");
+    }
+
+    std::printf("\n%-8s %10s %10s\n", "SYMBOL", "BID", "ASK");
+    for (uint32_t i = 0; i < cur.instrument_count && i < STATS_MAX_INSTRUMENTS; ++i) {
+        const StatsInstrument& inst = cur.instruments[i];
+        if (inst.best_bid == 0 && inst.best_ask == UINT32_MAX) continue;
+        std::printf("%-8.8s %10u %10u\n", inst.symbol, inst.best_bid, inst.best_ask);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int interval_ms = 1000;
+    bool once = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--once") == 0) {
+            once = true;
+        } else {
+            interval_ms = std::atoi(argv[i]);
+            if (interval_ms <= 0) {
+                std::fprintf(stderr, "Usage: %s [interval_ms] [--once]\n", argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    StatsReader reader;
+    if (!reader.open()) return 1;
+
+    // ~125KB each, keep them off the stack
+    auto cur = std::make_unique<StatsData>();
+    auto prev = std::make_unique<StatsData>();
+    bool have_prev = false;
+
+    while (true) {
+        if (!reader.read(*cur)) {
+            std::fprintf(stderr, "No stats published yet\n");
+        } else {
+            bool stale = have_prev && cur->publish_tsc == prev->publish_tsc;
+            if (!once) std::printf("\033[H\033[2J");  // Home and clear, like top
+            print_stats(*cur, have_prev && !stale ? prev.get() : nullptr);
+            if (stale) std::printf("\n(no update since last refresh, handler stopped?)\n");
+            std::fflush(stdout);
+            std::swap(cur, prev);
+            have_prev = true;
+        }
+        if (once) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+    return 0;
+}
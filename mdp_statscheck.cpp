@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "StatsBlock.h"
+
+/* mdp-statscheck: the stats segment's seqlock under contention, StatsPublisher publishing in bursts into its own
+ * segment and readers attached through StatsReader::read, the retrying read mdp-stat uses
+ * Every field of publish k is derived from k, spread from the first counter to the last instrument, so a snapshot
+ * copied while a publish was half done breaks the relation:
+ * - a snapshot read() returns is one whole publish
+ * - a reader's snapshots never go backwards
+ *
+ *   ./mdp-statscheck           # 2 readers, 1 s
+ *   ./mdp-statscheck 4 2000
+ *
+ * Exits 1 on any torn or backwards snapshot, 77 (skipped under ctest) if no shared memory segment can be created here
+ */
+
+namespace {
+    void fill(StatsData& data, uint64_t k) {
+        data.publish_tsc = k;
+        data.tsc_hz = k;
+        data.processed_messages = k;
+        data.zero_copy_messages = k;
+        data.copied_messages = k;
+        data.unknown_symbol_messages = k;
+        data.message_kind_count = STATS_MAX_MESSAGE_KINDS;
+        for (size_t i = 0; i < STATS_MAX_MESSAGE_KINDS; ++i) data.message_kind_counts[i] = k + i;
+        data.queue_count = STATS_MAX_QUEUES;
+        for (StatsQueue& queue : data.queues) {
+            queue.depth = queue.capacity = queue.high_water = k;
+            queue.dropped = queue.spilled = queue.spin_retries = k;
+        }
+        data.rx_queue_count = STATS_MAX_RX_QUEUES;
+        for (uint64_t& packets : data.rx_queue_packets) packets = k;
+        data.latency_series_count = STATS_MAX_LATENCY_SERIES;
+        for (auto& buckets : data.latency_buckets) std::fill(std::begin(buckets), std::end(buckets), k);
+        data.instrument_count = STATS_MAX_INSTRUMENTS;
+        for (StatsInstrument& instrument : data.instruments) {
+            instrument.best_bid = static_cast<uint32_t>(k);
+            instrument.best_ask = static_cast<uint32_t>(k + 1);
+        }
+    }
+
+    // Every field is what fill(publish_tsc) stored
+    bool whole(const StatsData& data) {
+        uint64_t k = data.publish_tsc;
+        bool same = data.tsc_hz == k && data.processed_messages == k && data.zero_copy_messages == k &&
+                    data.copied_messages == k && data.unknown_symbol_messages == k;
+        for (size_t i = 0; i < STATS_MAX_MESSAGE_KINDS; ++i) same = same && data.message_kind_counts[i] == k + i;
+        for (const StatsQueue& queue : data.queues) {
+            same = same && queue.depth == k && queue.capacity == k && queue.high_water == k && queue.dropped == k &&
+                   queue.spilled == k && queue.spin_retries == k;
+        }
+        for (uint64_t packets : data.rx_queue_packets) same = same && packets == k;
+        for (const auto& buckets : data.latency_buckets) {
+            same = same && std::all_of(std::begin(buckets), std::end(buckets), [k](uint64_t count) { return count == k; });
+        }
+        for (const StatsInstrument& instrument : data.instruments) {
+            same = same && instrument.best_bid == static_cast<uint32_t>(k) && instrument.best_ask == static_cast<uint32_t>(k + 1);
+        }
+        return same;
+    }
+
+    struct ReaderResult {
+        uint64_t reads = 0;
+        uint64_t busy = 0;  // read() gave up, nothing published yet or the writer kept the block busy
+        uint64_t torn = 0;
+        uint64_t backwards = 0;
+        uint64_t last = 0;
+        bool attached = false;
+    };
+
+    void reader(const char* name, const std::atomic<bool>& done, ReaderResult& result) {
+        StatsReader stats;
+        if (!stats.open(name)) return;
+        result.attached = true;
+        auto snapshot = std::make_unique<StatsData>();
+        while (!done.load(std::memory_order_relaxed)) {
+            if (!stats.read(*snapshot)) {
+                ++result.busy;
+                continue;
+            }
+            result.torn += !whole(*snapshot);
+            result.backwards += snapshot->publish_tsc < result.last;
+            result.last = std::max(result.last, snapshot->publish_tsc);
+            ++result.reads;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t readers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2;
+    long run_ms = argc > 2 ? std::strtol(argv[2], nullptr, 10) : 1000;
+
+    std::string name = "/mdp_statscheck." + std::to_string(getpid());
+    auto publisher = std::make_unique<StatsPublisher>();
+    if (!publisher->open(name.c_str())) {
+        std::printf("no shared memory segment, skipped\n");
+        return 77;
+    }
+
+    std::atomic<bool> done{false};
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+    for (size_t r = 0; r < readers; ++r) {
+        threads.emplace_back(reader, name.c_str(), std::cref(done), std::ref(results[r]));
+    }
+
+    /* Bursts of back to back publishes, where a reader racing the writer (or, on one CPU, running while the writer is
+     * preempted mid-publish) has to see the block busy, and idle gaps like the real writer's, where reads go through
+     */
+    constexpr auto BURST = std::chrono::milliseconds(2);
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(run_ms);
+    uint64_t published = 0;
+    for (auto now = std::chrono::steady_clock::now(); now < end; now = std::chrono::steady_clock::now()) {
+        auto burst_end = now + BURST;
+        do {
+            fill(publisher->begin(), ++published);
+            publisher->commit();
+        } while (std::chrono::steady_clock::now() < burst_end);
+        std::this_thread::sleep_for(BURST);
+    }
+    done.store(true, std::memory_order_relaxed);
+    for (std::thread& thread : threads) thread.join();
+    publisher.reset();
+    shm_unlink(name.c_str());
+
+    bool ok = true;
+    uint64_t reads = 0;
+    uint64_t busy = 0;
+    for (size_t r = 0; r < readers; ++r) {
+        const ReaderResult& result = results[r];
+        reads += result.reads;
+        busy += result.busy;
+        if (!result.attached || result.torn || result.backwards || result.last > published) {
+            std::fprintf(stderr, "  reader %zu: %s%llu torn, %llu backwards, last publish %llu of %llu\n", r,
+                         result.attached ? "" : "not attached, ", static_cast<unsigned long long>(result.torn),
+                         static_cast<unsigned long long>(result.backwards), static_cast<unsigned long long>(result.last),
+                         static_cast<unsigned long long>(published));
+            ok = false;
+        }
+    }
+
+    std::printf("stats seqlock: %llu publishes, %zu readers, %llu snapshots, %llu reads gave up, %s\n",
+                static_cast<unsigned long long>(published), readers, static_cast<unsigned long long>(reads),
+                static_cast<unsigned long long>(busy), ok ? "no torn or backwards snapshots" : "FAILED");
+    return ok ? 0 : 1;
+}
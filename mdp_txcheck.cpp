@@ -0,0 +1,135 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+#include "OrderProtocol.h"
+#include "TCPIPStack.h"
+
+/* mdp-txcheck: validates an order entry capture written by a net_pcap vdev
+ * Every frame has to parse as Ethernet/IPv4/TCP, carry correct IPv4 and TCP checksums, continue its flow's sequence
+ * numbers exactly, and hold whole length-prefixed orders:
+ *
+ *   sudo ./Low_latency_DPDK --vdev=net_pcap0,rx_pcap=in.pcap,tx_pcap=orders.pcap -- --tx-orders 10000
+ *   ./mdp-txcheck orders.pcap
+ *
+ * net_pcap has no checksum offload, so the software checksums are what ends up in the file
+ * Exits 1 if any frame is bad
+ */
+
+constexpr uint32_t PCAP_MAGIC_US = 0xa1b2c3d4;
+constexpr uint32_t PCAP_MAGIC_NS = 0xa1b23c4d;
+constexpr size_t MAX_REPORTED = 10;
+
+static uint32_t swap32(uint32_t v) { return __builtin_bswap32(v); }
+
+struct CheckStats {
+    size_t frames = 0;
+    size_t orders = 0;
+    size_t not_tcp = 0;
+    size_t bad_ip_checksum = 0;
+    size_t bad_tcp_checksum = 0;
+    size_t sequence_breaks = 0;
+    size_t bad_framing = 0;
+
+    size_t errors() const { return not_tcp + bad_ip_checksum + bad_tcp_checksum + sequence_breaks + bad_framing; }
+};
+
+static void report(size_t& reported, size_t frame, const char* what) {
+    if (reported++ < MAX_REPORTED) std::fprintf(stderr, "frame %zu: %s\n", frame, what);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s capture.pcap\n", argv[0]);
+        return 1;
+    }
+    FILE* file = std::fopen(argv[1], "rb");
+    if (!file) {
+        std::perror(argv[1]);
+        return 1;
+    }
+    uint32_t header[6];
+    if (std::fread(header, sizeof(header), 1, file) != 1) {
+        std::fprintf(stderr, "%s: too short for a pcap header\n", argv[1]);
+        return 1;
+    }
+    // Either timestamp precision, written on a machine of either byte order
+    bool swapped = header[0] == swap32(PCAP_MAGIC_US) || header[0] == swap32(PCAP_MAGIC_NS);
+    if (header[0] != PCAP_MAGIC_US && header[0] != PCAP_MAGIC_NS && !swapped) {
+        std::fprintf(stderr, "%s: not a pcap file\n", argv[1]);
+        return 1;
+    }
+    if ((swapped ? swap32(header[5]) : header[5]) != 1) {
+        std::fprintf(stderr, "%s: not an Ethernet capture\n", argv[1]);
+        return 1;
+    }
+
+    TCPIPStack stack(1);
+    CheckStats stats;
+    size_t reported = 0;
+    // Next expected sequence number per flow (source, destination)
+    std::map<std::tuple<uint32_t, uint16_t, uint32_t, uint16_t>, uint32_t> next_seq;
+    std::vector<uint8_t> frame;
+    uint32_t record[4];
+
+    while (std::fread(record, sizeof(record), 1, file) == 1) {
+        uint32_t captured = swapped ? swap32(record[2]) : record[2];
+        uint32_t original = swapped ? swap32(record[3]) : record[3];
+        frame.resize(captured);
+        if (captured > 0 && std::fread(frame.data(), captured, 1, file) != 1) {
+            std::fprintf(stderr, "%s: truncated record\n", argv[1]);
+            break;
+        }
+        size_t n = ++stats.frames;
+        TCPSegment segment;
+        if (captured != original || !stack.parse_frame(frame.data(), frame.size(), segment)) {
+            ++stats.not_tcp;
+            report(reported, n, "not a whole Ethernet/IPv4/TCP frame");
+            continue;
+        }
+
+        // parse_frame has checked the lengths, the headers are where these say
+        const uint8_t* ip = frame.data() + TCPIPStack::ETHER_HEADER_LEN + (frame[12] == 0x81 && frame[13] == 0x00 ? 4 : 0);
+        size_t ip_header_len = static_cast<size_t>(ip[0] & 0x0F) * 4;
+        const uint8_t* tcp = ip + ip_header_len;
+        size_t tcp_len = static_cast<size_t>(segment.payload + segment.payload_len - tcp);
+        if (TCPIPStack::internet_checksum(ip, ip_header_len) != 0) {
+            ++stats.bad_ip_checksum;
+            report(reported, n, "bad IPv4 header checksum");
+        }
+        uint32_t pseudo = TCPIPStack::pseudo_header_sum(segment.src_ip, segment.dest_ip, ip[9], tcp_len);
+        if (TCPIPStack::internet_checksum(tcp, tcp_len, pseudo) != 0) {
+            ++stats.bad_tcp_checksum;
+            report(reported, n, "bad TCP checksum");
+        }
+
+        auto flow = std::make_tuple(segment.src_ip, segment.src_port, segment.dest_ip, segment.dest_port);
+        auto it = next_seq.find(flow);
+        if (it != next_seq.end() && it->second != segment.seq_num) {
+            ++stats.sequence_breaks;
+            report(reported, n, "sequence number doesn't continue the flow");
+        }
+        next_seq[flow] = segment.seq_num + static_cast<uint32_t>(segment.payload_len);
+
+        // Order entry sends whole orders only, never a partial frame
+        size_t offset = 0;
+        while (offset + FRAME_HEADER_LEN <= segment.payload_len) {
+            size_t len = frame_payload_length(segment.payload + offset);
+            if (len != sizeof(Order) || offset + FRAME_HEADER_LEN + len > segment.payload_len) break;
+            ++stats.orders;
+            offset += FRAME_HEADER_LEN + len;
+        }
+        if (offset != segment.payload_len) {
+            ++stats.bad_framing;
+            report(reported, n, "payload isn't whole length-prefixed orders");
+        }
+    }
+    std::fclose(file);
+
+    std::printf("%zu frames, %zu flows, %zu orders\n", stats.frames, next_seq.size(), stats.orders);
+    std::printf("%zu not TCP, %zu bad IPv4 checksums, %zu bad TCP checksums, %zu sequence breaks, %zu framing errors\n",
+                stats.not_tcp, stats.bad_ip_checksum, stats.bad_tcp_checksum, stats.sequence_breaks, stats.bad_framing);
+    return stats.errors() == 0 ? 0 : 1;
+}